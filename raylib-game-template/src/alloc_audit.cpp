@@ -0,0 +1,135 @@
+// Allocation audit, see alloc_audit.h
+
+#include "alloc_audit.h"
+
+#ifdef NETWORK_ALLOCATION_AUDIT
+
+#include <stdlib.h>
+#include <atomic>
+#include <new>
+
+static std::atomic<bool> s_bAuditing(false);
+static std::atomic<int> s_nAllocations(0);
+
+//plain thread_locals with no constructors, operator new can be called before anything is set up
+static thread_local bool t_bAuditThread = false;
+static thread_local int t_nPauseDepth = 0;
+
+static void CountAllocation()
+{
+	if (t_bAuditThread && t_nPauseDepth == 0 && s_bAuditing.load(std::memory_order_relaxed))
+	{
+		s_nAllocations.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+extern "C" void BeginAllocationAudit(void)
+{
+	t_bAuditThread = true;
+	s_nAllocations.store(0, std::memory_order_relaxed);
+	s_bAuditing.store(true, std::memory_order_release);
+}
+
+extern "C" int EndAllocationAudit(void)
+{
+	s_bAuditing.store(false, std::memory_order_release);
+	return s_nAllocations.load(std::memory_order_relaxed);
+}
+
+extern "C" void AddAllocationAuditThread(void)
+{
+	t_bAuditThread = true;
+}
+
+extern "C" void PauseAllocationAudit(void)
+{
+	t_nPauseDepth++;
+}
+
+extern "C" void ResumeAllocationAudit(void)
+{
+	t_nPauseDepth--;
+}
+
+extern "C" void* AuditMalloc(size_t size)
+{
+	CountAllocation();
+	return malloc(size);
+}
+
+extern "C" void* AuditCalloc(size_t count, size_t size)
+{
+	CountAllocation();
+	return calloc(count, size);
+}
+
+extern "C" void* AuditRealloc(void* ptr, size_t size)
+{
+	CountAllocation();
+	return realloc(ptr, size);
+}
+
+extern "C" void AuditFree(void* ptr)
+{
+	free(ptr);
+}
+
+//replacing the global operators catches every new in the process, the standard library's included
+void* operator new(size_t size)
+{
+	CountAllocation();
+	void* ptr = malloc(size ? size : 1);
+	if (ptr == nullptr)
+	{
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	CountAllocation();
+	return malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return operator new(size, std::nothrow);
+}
+
+void operator delete(void* ptr) noexcept
+{
+	free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+	free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+	free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept
+{
+	free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept
+{
+	free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept
+{
+	free(ptr);
+}
+
+#endif // NETWORK_ALLOCATION_AUDIT
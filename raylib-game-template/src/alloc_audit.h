@@ -0,0 +1,71 @@
+// Allocation audit
+// Once a session has settled the network tick shouldn't touch the heap: buffers are kept between
+// ticks, node containers draw from pools (node_pool.h) and messages come from the networking
+// library's own allocator. Building with NETWORK_ALLOCATION_AUDIT defined checks that holds:
+//
+//     cmake -S . -B build -DNETWORK_ALLOCATION_AUDIT=ON
+//
+// counts every operator new, and every RL_MALLOC, RL_CALLOC and RL_REALLOC inside raylib, made by
+// the network thread or a snapshot worker during a tick, and asserts when a tick that should be
+// steady made any. A tick is steady once ALLOCATION_AUDIT_SETTLE_TICKS have gone by without a
+// connection coming or going. Allocations the networking library makes for itself aren't ours
+// to fix, so calls into it are wrapped in PauseAllocationAudit.
+//
+// Without the define it all compiles away.
+
+#ifndef ALLOC_AUDIT_H
+#define ALLOC_AUDIT_H
+
+#include <stddef.h>
+
+#define ALLOCATION_AUDIT_SETTLE_TICKS 300
+
+#ifdef NETWORK_ALLOCATION_AUDIT
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	//start and end of a tick on the network thread, End returns the allocations counted in between
+	void BeginAllocationAudit(void);
+	int EndAllocationAudit(void);
+
+	//counts this thread's allocations as part of the tick as well, for worker threads
+	void AddAllocationAuditThread(void);
+
+	//nests, allocations on this thread aren't counted until every pause is resumed
+	void PauseAllocationAudit(void);
+	void ResumeAllocationAudit(void);
+
+	//raylib is built with its RL_MALLOC family pointed at these
+	void* AuditMalloc(size_t size);
+	void* AuditCalloc(size_t count, size_t size);
+	void* AuditRealloc(void* ptr, size_t size);
+	void AuditFree(void* ptr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#else
+
+#define BeginAllocationAudit() ((void)0)
+#define EndAllocationAudit() 0
+#define AddAllocationAuditThread() ((void)0)
+#define PauseAllocationAudit() ((void)0)
+#define ResumeAllocationAudit() ((void)0)
+
+#endif // NETWORK_ALLOCATION_AUDIT
+
+#ifdef __cplusplus
+//pauses the audit for the rest of the scope
+struct AllocationAuditPause
+{
+	AllocationAuditPause() { PauseAllocationAudit(); }
+	~AllocationAuditPause() { ResumeAllocationAudit(); }
+	AllocationAuditPause(const AllocationAuditPause&) = delete;
+	AllocationAuditPause& operator=(const AllocationAuditPause&) = delete;
+};
+#endif
+
+#endif // ALLOC_AUDIT_H
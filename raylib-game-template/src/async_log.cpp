@@ -0,0 +1,388 @@
+// Asynchronous logger, see async_log.h
+
+#define _CRT_SECURE_NO_WARNINGS
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "async_log.h"
+
+static_assert((ASYNC_LOG_RING_SIZE & (ASYNC_LOG_RING_SIZE - 1)) == 0, "ASYNC_LOG_RING_SIZE must be a power of two");
+
+//one queued message, the text is as the caller gave it, the timestamp and level are turned
+//into text by the writer
+struct LogRecord
+{
+	std::atomic<uint64_t> sequence; //which lap of the ring this slot is ready for, see ClaimRecord
+	int64_t time; //microseconds since the logger started
+	int level;
+	int length;
+	char text[ASYNC_LOG_TEXT_SIZE];
+};
+
+//a one second window of messages for each level
+struct LevelLimit
+{
+	std::atomic<int> perSecond;
+	std::atomic<int64_t> window;
+	std::atomic<int> count;
+	std::atomic<int> suppressed;
+};
+
+enum WriterState
+{
+	WRITER_NOT_STARTED,
+	WRITER_RUNNING,
+	WRITER_STOPPED //at exit, messages are written straight out
+};
+
+static LogRecord s_Ring[ASYNC_LOG_RING_SIZE];
+static std::atomic<uint64_t> s_WritePos(0); //next slot a producer claims
+static uint64_t s_ReadPos = 0; //next slot to write out, only touched with s_ConsumerMutex held
+static std::mutex s_ConsumerMutex; //held by whoever is draining, producers never take it
+
+static LevelLimit s_Limits[ASYNC_LOG_LEVEL_COUNT];
+static std::atomic<int> s_RingFullDrops(0);
+
+static std::once_flag s_InitOnce;
+static std::mutex s_StartMutex;
+static std::atomic<int> s_WriterState(WRITER_NOT_STARTED);
+static std::atomic<bool> s_bStopWriter(false);
+static std::thread* s_pWriterThread = nullptr; //never destroyed, so exit doesn't trip over a joinable thread
+static std::chrono::steady_clock::time_point s_TimeZero;
+static int64_t s_LastReportTime = 0;
+
+static const char* s_LevelNames[ASYNC_LOG_LEVEL_COUNT] = { "", "TRACE: ", "DEBUG: ", "", "WARNING: ", "ERROR: ", "FATAL: " };
+
+static int64_t LogTime()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - s_TimeZero).count();
+}
+
+static void InitLog()
+{
+	s_TimeZero = std::chrono::steady_clock::now();
+	for (int i = 0; i < ASYNC_LOG_RING_SIZE; i++)
+	{
+		s_Ring[i].sequence.store(i, std::memory_order_relaxed);
+	}
+
+	//chatty levels get less room than the ones that matter, fatal is never limited
+	int defaultLimits[ASYNC_LOG_LEVEL_COUNT] = { 0, 50, 50, 200, 500, 500, 0 };
+	for (int level = 0; level < ASYNC_LOG_LEVEL_COUNT; level++)
+	{
+		s_Limits[level].perSecond.store(defaultLimits[level], std::memory_order_relaxed);
+		s_Limits[level].window.store(-1, std::memory_order_relaxed);
+	}
+}
+
+static int ClampLevel(int level)
+{
+	return (level < ASYNC_LOG_TRACE) ? ASYNC_LOG_TRACE : (level > ASYNC_LOG_FATAL) ? ASYNC_LOG_FATAL : level;
+}
+
+//counts a message against its level's limit, returns false if it's over
+static bool AllowMessage(int level, int64_t time)
+{
+	LevelLimit& limit = s_Limits[level];
+	int perSecond = limit.perSecond.load(std::memory_order_relaxed);
+	if (perSecond <= 0)
+	{
+		return true;
+	}
+
+	//whoever moves the window on resets the count, a few racing messages may slip into either second
+	int64_t second = time / 1000000;
+	int64_t window = limit.window.load(std::memory_order_relaxed);
+	if (window != second && limit.window.compare_exchange_strong(window, second, std::memory_order_relaxed))
+	{
+		limit.count.store(0, std::memory_order_relaxed);
+	}
+
+	if (limit.count.fetch_add(1, std::memory_order_relaxed) >= perSecond)
+	{
+		limit.suppressed.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+	return true;
+}
+
+//bounded multi producer ring, each slot's sequence says whether it's free for this lap (== pos),
+//holds a message (== pos + 1), or is still waiting on the writer from the last lap (< pos)
+//returns nullptr when the ring is full
+static LogRecord* ClaimRecord(uint64_t& outPos)
+{
+	uint64_t pos = s_WritePos.load(std::memory_order_relaxed);
+	for (;;)
+	{
+		LogRecord& record = s_Ring[pos & (ASYNC_LOG_RING_SIZE - 1)];
+		int64_t lap = (int64_t)(record.sequence.load(std::memory_order_acquire) - pos);
+		if (lap == 0)
+		{
+			if (s_WritePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+			{
+				outPos = pos;
+				return &record;
+			}
+		}
+		else if (lap < 0)
+		{
+			return nullptr;
+		}
+		else
+		{
+			pos = s_WritePos.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+static void PublishRecord(LogRecord& record, uint64_t pos)
+{
+	record.sequence.store(pos + 1, std::memory_order_release);
+}
+
+//trims a trailing newline and marks messages that didn't fit
+static int FinishText(char* text, int length)
+{
+	if (length < 0)
+	{
+		length = 0;
+		text[0] = '\0';
+	}
+	else if (length >= ASYNC_LOG_TEXT_SIZE)
+	{
+		length = ASYNC_LOG_TEXT_SIZE - 1;
+		memcpy(text + length - 3, "...", 3);
+	}
+
+	if (length > 0 && text[length - 1] == '\n')
+	{
+		text[--length] = '\0';
+	}
+	return length;
+}
+
+static void AppendLine(std::string& out, int64_t time, int level, const char* text, int length)
+{
+	char prefix[48];
+	int prefixLength = snprintf(prefix, sizeof(prefix), "%10.6f %s", time * 1e-6, s_LevelNames[level]);
+	out.append(prefix, prefixLength);
+	out.append(text, length);
+	out.push_back('\n');
+}
+
+//says how many messages were thrown away since the last report, at most once per interval
+static void AppendDropReports(std::string& out, bool bForce)
+{
+	int64_t now = LogTime();
+	if (!bForce && now - s_LastReportTime < ASYNC_LOG_REPORT_INTERVAL)
+	{
+		return;
+	}
+	s_LastReportTime = now;
+
+	char text[128];
+	for (int level = ASYNC_LOG_TRACE; level < ASYNC_LOG_LEVEL_COUNT; level++)
+	{
+		int suppressed = s_Limits[level].suppressed.exchange(0, std::memory_order_relaxed);
+		if (suppressed > 0)
+		{
+			int length = snprintf(text, sizeof(text), "(%d messages over the rate limit dropped)", suppressed);
+			AppendLine(out, now, level, text, length);
+		}
+	}
+
+	int ringFullDrops = s_RingFullDrops.exchange(0, std::memory_order_relaxed);
+	if (ringFullDrops > 0)
+	{
+		int length = snprintf(text, sizeof(text), "(%d messages dropped, the log couldn't keep up)", ringFullDrops);
+		AppendLine(out, now, ASYNC_LOG_WARNING, text, length);
+	}
+}
+
+//writes out every published record, s_ConsumerMutex must be held
+//stops at a slot a producer has claimed but not filled yet, it'll be picked up next time
+static bool DrainRing(bool bForceReports)
+{
+	static std::string batch;
+	batch.clear();
+
+	for (;;)
+	{
+		LogRecord& record = s_Ring[s_ReadPos & (ASYNC_LOG_RING_SIZE - 1)];
+		if (record.sequence.load(std::memory_order_acquire) != s_ReadPos + 1)
+		{
+			break;
+		}
+
+		AppendLine(batch, record.time, record.level, record.text, record.length);
+		record.sequence.store(s_ReadPos + ASYNC_LOG_RING_SIZE, std::memory_order_release);
+		s_ReadPos++;
+	}
+	AppendDropReports(batch, bForceReports);
+
+	if (batch.empty())
+	{
+		return false;
+	}
+	fwrite(batch.data(), 1, batch.size(), stdout);
+	fflush(stdout);
+	return true;
+}
+
+static void WriterThread()
+{
+	while (!s_bStopWriter.load(std::memory_order_acquire))
+	{
+		bool bWrote;
+		{
+			std::lock_guard<std::mutex> lock(s_ConsumerMutex);
+			bWrote = DrainRing(false);
+		}
+		if (!bWrote)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(ASYNC_LOG_IDLE_SLEEP));
+		}
+	}
+}
+
+static void StopAtExit()
+{
+	StopAsyncLog();
+}
+
+static void StartWriter()
+{
+	std::call_once(s_InitOnce, InitLog);
+	if (s_WriterState.load(std::memory_order_acquire) != WRITER_NOT_STARTED)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(s_StartMutex);
+	if (s_WriterState.load(std::memory_order_relaxed) == WRITER_NOT_STARTED)
+	{
+		s_pWriterThread = new std::thread(WriterThread);
+		atexit(StopAtExit);
+		s_WriterState.store(WRITER_RUNNING, std::memory_order_release);
+	}
+}
+
+//once the writer has stopped there's nobody to hand messages to, so write them ourselves
+static void WriteDirect(int level, int64_t time, const char* text, int length)
+{
+	std::string line;
+	AppendLine(line, time, level, text, length);
+
+	std::lock_guard<std::mutex> lock(s_ConsumerMutex);
+	DrainRing(true);
+	fwrite(line.data(), 1, line.size(), stdout);
+	fflush(stdout);
+}
+
+//finds a slot for a message, or nullptr if it's been dropped
+static LogRecord* BeginMessage(int& level, int64_t& time, uint64_t& pos)
+{
+	StartWriter();
+	level = ClampLevel(level);
+	time = LogTime();
+	if (!AllowMessage(level, time))
+	{
+		return nullptr;
+	}
+
+	LogRecord* pRecord = ClaimRecord(pos);
+	while (pRecord == nullptr && level == ASYNC_LOG_FATAL)
+	{
+		//a fatal message is worth waiting for, make room by writing out what's there
+		FlushAsyncLog();
+		pRecord = ClaimRecord(pos);
+	}
+	if (pRecord == nullptr)
+	{
+		s_RingFullDrops.fetch_add(1, std::memory_order_relaxed);
+	}
+	return pRecord;
+}
+
+extern "C" void AsyncLogV(int level, const char* fmt, va_list args)
+{
+	int64_t time;
+	if (s_WriterState.load(std::memory_order_acquire) == WRITER_STOPPED)
+	{
+		char text[ASYNC_LOG_TEXT_SIZE];
+		int length = FinishText(text, vsnprintf(text, sizeof(text), fmt, args));
+		WriteDirect(ClampLevel(level), LogTime(), text, length);
+		return;
+	}
+
+	uint64_t pos;
+	LogRecord* pRecord = BeginMessage(level, time, pos);
+	if (pRecord == nullptr)
+	{
+		return;
+	}
+
+	//formatted straight into the slot, there's no other copy
+	pRecord->time = time;
+	pRecord->level = level;
+	pRecord->length = FinishText(pRecord->text, vsnprintf(pRecord->text, sizeof(pRecord->text), fmt, args));
+	PublishRecord(*pRecord, pos);
+}
+
+extern "C" void AsyncLog(int level, const char* fmt, ...)
+{
+	va_list args;
+	va_start(args, fmt);
+	AsyncLogV(level, fmt, args);
+	va_end(args);
+}
+
+extern "C" void AsyncLogText(int level, const char* text)
+{
+	AsyncLog(level, "%s", text);
+}
+
+extern "C" void FlushAsyncLog()
+{
+	std::lock_guard<std::mutex> lock(s_ConsumerMutex);
+	DrainRing(true);
+	fflush(stderr);
+}
+
+extern "C" void StopAsyncLog()
+{
+	std::lock_guard<std::mutex> startLock(s_StartMutex);
+	if (s_WriterState.load(std::memory_order_relaxed) != WRITER_RUNNING)
+	{
+		return;
+	}
+
+	s_bStopWriter.store(true, std::memory_order_release);
+	s_pWriterThread->join();
+	s_WriterState.store(WRITER_STOPPED, std::memory_order_release);
+	FlushAsyncLog();
+}
+
+extern "C" void SetAsyncLogRateLimit(int level, int perSecond)
+{
+	std::call_once(s_InitOnce, InitLog);
+	s_Limits[ClampLevel(level)].perSecond.store(perSecond, std::memory_order_relaxed);
+}
+
+extern "C" void AsyncLogTraceCallback(int logType, const char* text, va_list args)
+{
+	AsyncLogV(logType, text, args);
+
+	//raylib leaves exiting to us when there's a callback
+	if (logType >= ASYNC_LOG_FATAL)
+	{
+		FlushAsyncLog();
+		exit(EXIT_FAILURE);
+	}
+}
@@ -0,0 +1,61 @@
+// Asynchronous logger
+// Everything the game prints, from networking's Printf, GameNetworkingSockets' debug output and
+// raylib's TraceLog, goes through one lock-free ring. Callers on any thread copy their message
+// and a timestamp into a slot and carry on; a background thread formats the lines and writes
+// them out in batches, so a burst of log spam costs the network tick a memcpy per line rather
+// than a flushed write to the console.
+//
+// Each level is rate limited, anything over the limit is counted and reported instead of printed.
+// Fatal messages are never dropped and are flushed before the process goes down.
+
+#ifndef ASYNC_LOG_H
+#define ASYNC_LOG_H
+
+#include <stdarg.h>
+
+#define ASYNC_LOG_RING_SIZE 1024 //slots, a power of two
+#define ASYNC_LOG_TEXT_SIZE 512 //longest message, longer ones are cut short
+#define ASYNC_LOG_IDLE_SLEEP 2 //milliseconds the writer sleeps when there's nothing to write
+#define ASYNC_LOG_REPORT_INTERVAL 1000000 //microseconds between reports of dropped messages
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//the same numbers as raylib's TraceLogLevel, so TraceLog levels pass straight through
+enum AsyncLogLevel
+{
+	ASYNC_LOG_TRACE = 1,
+	ASYNC_LOG_DEBUG,
+	ASYNC_LOG_INFO,
+	ASYNC_LOG_WARNING,
+	ASYNC_LOG_ERROR,
+	ASYNC_LOG_FATAL,
+
+	ASYNC_LOG_LEVEL_COUNT
+};
+
+	//queues a message, safe from any thread, never blocks unless the message is fatal
+	//the writer thread is started by the first message and stopped at exit
+	void AsyncLog(int level, const char* fmt, ...);
+	void AsyncLogV(int level, const char* fmt, va_list args);
+	void AsyncLogText(int level, const char* text);
+
+	//writes out everything queued so far before returning
+	void FlushAsyncLog();
+
+	//flushes and stops the writer thread, called at exit, anything logged after is written straight out
+	void StopAsyncLog();
+
+	//messages per second a level may log before the rest are dropped, 0 for no limit
+	void SetAsyncLogRateLimit(int level, int perSecond);
+
+	//a raylib TraceLogCallback, pass to SetTraceLogCallback
+	//LOG_FATAL flushes and exits the way TraceLog would have
+	void AsyncLogTraceCallback(int logType, const char* text, va_list args);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ASYNC_LOG_H
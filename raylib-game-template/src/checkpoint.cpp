@@ -0,0 +1,186 @@
+// World checkpoint, see checkpoint.h
+
+#include <string.h>
+#include <algorithm>
+
+#include "checkpoint.h"
+
+#ifdef _WIN32
+#define NOMINMAX // we want std::min/std::max, not the windows.h macros
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// WorldCheckpoint
+//
+/////////////////////////////////////////////////////////////////////////////
+
+bool WorldCheckpoint::Open(const char* path)
+{
+	Close();
+
+	m_nMappedSize = sizeof(CheckpointHeader) + CHECKPOINT_MAX_SLOTS * sizeof(CheckpointSlot);
+	void* pMapped = nullptr;
+
+#ifdef _WIN32
+	m_hFile = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (m_hFile == INVALID_HANDLE_VALUE)
+	{
+		m_hFile = nullptr;
+		return false;
+	}
+
+	//the mapping grows the file to its full size if it's shorter
+	m_hMapping = CreateFileMappingA(m_hFile, nullptr, PAGE_READWRITE, 0, (DWORD)m_nMappedSize, nullptr);
+	if (m_hMapping != nullptr)
+	{
+		pMapped = MapViewOfFile(m_hMapping, FILE_MAP_ALL_ACCESS, 0, 0, m_nMappedSize);
+	}
+#else
+	m_nFile = open(path, O_RDWR | O_CREAT, 0644);
+	if (m_nFile < 0)
+	{
+		return false;
+	}
+
+	//a new file reads back as zeros once it's stretched, so its magic won't match
+	if (ftruncate(m_nFile, (off_t)m_nMappedSize) == 0)
+	{
+		pMapped = mmap(nullptr, m_nMappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, m_nFile, 0);
+		if (pMapped == MAP_FAILED)
+		{
+			pMapped = nullptr;
+		}
+	}
+#endif
+
+	if (pMapped == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	m_pHeader = (CheckpointHeader*)pMapped;
+	m_pSlots = (CheckpointSlot*)((char*)pMapped + sizeof(CheckpointHeader));
+
+	//anything we can't read is just a fresh start
+	if (m_pHeader->magic != CHECKPOINT_MAGIC || m_pHeader->version != CHECKPOINT_VERSION
+		|| m_pHeader->slotCount != CHECKPOINT_MAX_SLOTS || m_pHeader->slotSize != sizeof(CheckpointSlot))
+	{
+		memset(pMapped, 0, m_nMappedSize);
+		m_pHeader->magic = CHECKPOINT_MAGIC;
+		m_pHeader->version = CHECKPOINT_VERSION;
+		m_pHeader->slotCount = CHECKPOINT_MAX_SLOTS;
+		m_pHeader->slotSize = sizeof(CheckpointSlot);
+		m_nFirstDirty = 0;
+		m_nLastDirty = CHECKPOINT_MAX_SLOTS - 1;
+		Flush();
+	}
+
+	return true;
+}
+
+void WorldCheckpoint::Close()
+{
+#ifdef _WIN32
+	if (m_pHeader != nullptr)
+	{
+		FlushViewOfFile(m_pHeader, 0);
+		UnmapViewOfFile(m_pHeader);
+	}
+	if (m_hMapping != nullptr)
+	{
+		CloseHandle(m_hMapping);
+		m_hMapping = nullptr;
+	}
+	if (m_hFile != nullptr)
+	{
+		CloseHandle(m_hFile);
+		m_hFile = nullptr;
+	}
+#else
+	if (m_pHeader != nullptr)
+	{
+		msync(m_pHeader, m_nMappedSize, MS_SYNC);
+		munmap(m_pHeader, m_nMappedSize);
+	}
+	if (m_nFile >= 0)
+	{
+		close(m_nFile);
+		m_nFile = -1;
+	}
+#endif
+
+	m_pHeader = nullptr;
+	m_pSlots = nullptr;
+	m_nFirstDirty = CHECKPOINT_MAX_SLOTS;
+	m_nLastDirty = -1;
+}
+
+const CheckpointSlot* WorldCheckpoint::GetSlot(int id) const
+{
+	if (m_pSlots == nullptr || id < 0 || id >= CHECKPOINT_MAX_SLOTS || !m_pSlots[id].bUsed)
+	{
+		return nullptr;
+	}
+	return &m_pSlots[id];
+}
+
+void WorldCheckpoint::WriteSlot(int id, const CheckpointSlot& slot)
+{
+	if (m_pSlots == nullptr || id < 0 || id >= CHECKPOINT_MAX_SLOTS)
+	{
+		return;
+	}
+
+	//an unchanged slot leaves its page clean, so there's nothing to write back
+	if (memcmp(&m_pSlots[id], &slot, sizeof(CheckpointSlot)) == 0)
+	{
+		return;
+	}
+
+	m_pSlots[id] = slot;
+	m_nFirstDirty = std::min(m_nFirstDirty, id);
+	m_nLastDirty = std::max(m_nLastDirty, id);
+}
+
+void WorldCheckpoint::ClearSlot(int id)
+{
+	CheckpointSlot emptySlot = {};
+	WriteSlot(id, emptySlot);
+}
+
+void WorldCheckpoint::ClearAll()
+{
+	for (int id = 0; id < CHECKPOINT_MAX_SLOTS; id++)
+	{
+		ClearSlot(id);
+	}
+	Flush();
+}
+
+void WorldCheckpoint::Flush()
+{
+	if (m_pHeader == nullptr || m_nFirstDirty > m_nLastDirty)
+	{
+		return;
+	}
+	m_pHeader->flushCount++;
+
+	//the header changed too, so write back from the start of the file to the last dirty slot
+	//it's small enough that this is only ever a page or two
+	size_t flushSize = sizeof(CheckpointHeader) + (m_nLastDirty + 1) * sizeof(CheckpointSlot);
+#ifdef _WIN32
+	FlushViewOfFile(m_pHeader, flushSize);
+#else
+	msync(m_pHeader, flushSize, MS_ASYNC);
+#endif
+
+	m_nFirstDirty = CHECKPOINT_MAX_SLOTS;
+	m_nLastDirty = -1;
+}
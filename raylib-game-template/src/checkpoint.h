@@ -0,0 +1,77 @@
+// World checkpoint
+// The server keeps its entity slots in a memory-mapped file. Slots are written in place as
+// they change, so if the process dies the OS still has everything up to the last write and
+// a restarted server maps the same file and carries on from it.
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdint.h>
+
+#define CHECKPOINT_MAGIC 0x4B504357 //"WCPK"
+#define CHECKPOINT_VERSION 1 //bump whenever CheckpointHeader or CheckpointSlot change
+#define CHECKPOINT_MAX_SLOTS 128 //entity IDs are a char on the wire
+
+//start of the file
+struct CheckpointHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t slotCount;
+	uint32_t slotSize;
+	uint64_t flushCount; //goes up on every flush, handy for telling two checkpoints apart
+	uint64_t reserved;
+};
+
+//one entity, the slot index is its ID
+struct CheckpointSlot
+{
+	uint32_t bUsed;
+	int32_t posX;
+	int32_t posY;
+	int32_t velX;
+	int32_t velY;
+	uint32_t reserved;
+	uint64_t sessionToken; //what its player presents to reclaim it
+};
+
+class WorldCheckpoint
+{
+public:
+	~WorldCheckpoint() { Close(); }
+
+	//maps the file, creating it or starting it over if it's missing or from another version
+	//returns false if it can't be mapped, checkpointing is then just off
+	bool Open(const char* path);
+	void Close();
+	bool IsOpen() const { return m_pHeader != nullptr; }
+
+	//the slot for an ID, or nullptr if it's free
+	const CheckpointSlot* GetSlot(int id) const;
+
+	//only touches the mapping if the slot actually changed
+	void WriteSlot(int id, const CheckpointSlot& slot);
+	void ClearSlot(int id);
+	void ClearAll();
+
+	//asks the OS to start writing the changed pages back to disk, without waiting for it
+	void Flush();
+
+private:
+	CheckpointHeader* m_pHeader = nullptr;
+	CheckpointSlot* m_pSlots = nullptr;
+	size_t m_nMappedSize = 0;
+
+	//range of slots written since the last flush, empty when first > last
+	int m_nFirstDirty = CHECKPOINT_MAX_SLOTS;
+	int m_nLastDirty = -1;
+
+#ifdef _WIN32
+	void* m_hFile = nullptr;
+	void* m_hMapping = nullptr;
+#else
+	int m_nFile = -1;
+#endif
+};
+
+#endif // CHECKPOINT_H
@@ -0,0 +1,371 @@
+// Batch decoder for blocks of packed DataPackets, see entity_decode.h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <random>
+
+#include "entity_decode.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define ENTITY_DECODE_X64 //SSE2 is part of x64, AVX2 has to be checked for
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define ENTITY_DECODE_NEON //NEON is part of AArch64
+#include <arm_neon.h>
+#endif
+
+//the vector paths read the ints straight out of the records, which only works on a little endian CPU
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#undef ENTITY_DECODE_X64
+#undef ENTITY_DECODE_NEON
+#endif
+
+//GCC and Clang only let us use AVX2 intrinsics in functions built for it, MSVC doesn't mind
+#if defined(ENTITY_DECODE_X64) && (defined(__GNUC__) || defined(__clang__))
+#define ENTITY_DECODE_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define ENTITY_DECODE_TARGET_AVX2
+#endif
+
+//widest vector path, the arrays are padded to a multiple of it
+#define ENTITY_DECODE_MAX_BATCH 8
+
+void EntityBlock::Resize(int newCount)
+{
+	count = newCount;
+
+	size_t padded = (size_t)(newCount + ENTITY_DECODE_MAX_BATCH - 1) / ENTITY_DECODE_MAX_BATCH * ENTITY_DECODE_MAX_BATCH;
+	if (posX.size() < padded)
+	{
+		ids.resize(padded);
+		posX.resize(padded);
+		posY.resize(padded);
+		velX.resize(padded);
+		velY.resize(padded);
+	}
+}
+
+//one record at a time, the same shifting as DeserializeDataPacket
+//also finishes off whatever the vector paths leave over
+static void DecodeEntitiesScalar(const char* records, int begin, int end, EntityBlock& outBlock)
+{
+	for (int i = begin; i < end; i++)
+	{
+		const char* record = records + i * NETWORK_PACKET_SIZE;
+		outBlock.ids[i] = (signed char)record[0];
+		outBlock.posX[i] = DeserializeInt(record, 1);
+		outBlock.posY[i] = DeserializeInt(record, 5);
+		outBlock.velX[i] = DeserializeInt(record, 9);
+		outBlock.velY[i] = DeserializeInt(record, 13);
+	}
+}
+
+#ifdef ENTITY_DECODE_X64
+
+//4 records per step, each one a single load, then a 4x4 transpose into the field arrays
+static int DecodeEntitiesSSE2(const char* records, int count, EntityBlock& outBlock)
+{
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		const char* record = records + i * NETWORK_PACKET_SIZE;
+
+		//posX posY velX velY of each record
+		__m128i r0 = _mm_loadu_si128((const __m128i*)(record + 1));
+		__m128i r1 = _mm_loadu_si128((const __m128i*)(record + NETWORK_PACKET_SIZE + 1));
+		__m128i r2 = _mm_loadu_si128((const __m128i*)(record + 2 * NETWORK_PACKET_SIZE + 1));
+		__m128i r3 = _mm_loadu_si128((const __m128i*)(record + 3 * NETWORK_PACKET_SIZE + 1));
+
+		__m128i pos01 = _mm_unpacklo_epi32(r0, r1); //posX0 posX1 posY0 posY1
+		__m128i pos23 = _mm_unpacklo_epi32(r2, r3);
+		__m128i vel01 = _mm_unpackhi_epi32(r0, r1); //velX0 velX1 velY0 velY1
+		__m128i vel23 = _mm_unpackhi_epi32(r2, r3);
+
+		_mm_storeu_si128((__m128i*)&outBlock.posX[i], _mm_unpacklo_epi64(pos01, pos23));
+		_mm_storeu_si128((__m128i*)&outBlock.posY[i], _mm_unpackhi_epi64(pos01, pos23));
+		_mm_storeu_si128((__m128i*)&outBlock.velX[i], _mm_unpacklo_epi64(vel01, vel23));
+		_mm_storeu_si128((__m128i*)&outBlock.velY[i], _mm_unpackhi_epi64(vel01, vel23));
+
+		outBlock.ids[i] = (signed char)record[0];
+		outBlock.ids[i + 1] = (signed char)record[NETWORK_PACKET_SIZE];
+		outBlock.ids[i + 2] = (signed char)record[2 * NETWORK_PACKET_SIZE];
+		outBlock.ids[i + 3] = (signed char)record[3 * NETWORK_PACKET_SIZE];
+	}
+	return i;
+}
+
+//the same as SSE2 but 8 records per step, records i and i + 4 share a register so the
+//in-lane unpacks give both halves in order
+ENTITY_DECODE_TARGET_AVX2
+static int DecodeEntitiesAVX2(const char* records, int count, EntityBlock& outBlock)
+{
+	int i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		const char* record = records + i * NETWORK_PACKET_SIZE;
+
+		__m256i r[4];
+		for (int k = 0; k < 4; k++)
+		{
+			__m128i low = _mm_loadu_si128((const __m128i*)(record + k * NETWORK_PACKET_SIZE + 1));
+			__m128i high = _mm_loadu_si128((const __m128i*)(record + (k + 4) * NETWORK_PACKET_SIZE + 1));
+			r[k] = _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+		}
+
+		__m256i pos01 = _mm256_unpacklo_epi32(r[0], r[1]);
+		__m256i pos23 = _mm256_unpacklo_epi32(r[2], r[3]);
+		__m256i vel01 = _mm256_unpackhi_epi32(r[0], r[1]);
+		__m256i vel23 = _mm256_unpackhi_epi32(r[2], r[3]);
+
+		_mm256_storeu_si256((__m256i*)&outBlock.posX[i], _mm256_unpacklo_epi64(pos01, pos23));
+		_mm256_storeu_si256((__m256i*)&outBlock.posY[i], _mm256_unpackhi_epi64(pos01, pos23));
+		_mm256_storeu_si256((__m256i*)&outBlock.velX[i], _mm256_unpacklo_epi64(vel01, vel23));
+		_mm256_storeu_si256((__m256i*)&outBlock.velY[i], _mm256_unpackhi_epi64(vel01, vel23));
+
+		for (int k = 0; k < 8; k++)
+		{
+			outBlock.ids[i + k] = (signed char)record[k * NETWORK_PACKET_SIZE];
+		}
+	}
+	return i;
+}
+
+static bool CPUHasAVX2()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+	{
+		return false;
+	}
+
+	//the OS has to be saving the YMM registers too
+	__cpuid(info, 1);
+	bool bOSXSave = (info[2] & (1 << 27)) != 0;
+	if (!bOSXSave || (_xgetbv(0) & 6) != 6)
+	{
+		return false;
+	}
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif // ENTITY_DECODE_X64
+
+#ifdef ENTITY_DECODE_NEON
+
+//4 records per step like SSE2, the transpose is two trn and some recombining
+static int DecodeEntitiesNEON(const char* records, int count, EntityBlock& outBlock)
+{
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		const char* record = records + i * NETWORK_PACKET_SIZE;
+
+		int32x4_t r0 = vreinterpretq_s32_u8(vld1q_u8((const uint8_t*)(record + 1)));
+		int32x4_t r1 = vreinterpretq_s32_u8(vld1q_u8((const uint8_t*)(record + NETWORK_PACKET_SIZE + 1)));
+		int32x4_t r2 = vreinterpretq_s32_u8(vld1q_u8((const uint8_t*)(record + 2 * NETWORK_PACKET_SIZE + 1)));
+		int32x4_t r3 = vreinterpretq_s32_u8(vld1q_u8((const uint8_t*)(record + 3 * NETWORK_PACKET_SIZE + 1)));
+
+		int32x4x2_t t01 = vtrnq_s32(r0, r1); //[posX0 posX1 velX0 velX1] [posY0 posY1 velY0 velY1]
+		int32x4x2_t t23 = vtrnq_s32(r2, r3);
+
+		vst1q_s32(&outBlock.posX[i], vcombine_s32(vget_low_s32(t01.val[0]), vget_low_s32(t23.val[0])));
+		vst1q_s32(&outBlock.velX[i], vcombine_s32(vget_high_s32(t01.val[0]), vget_high_s32(t23.val[0])));
+		vst1q_s32(&outBlock.posY[i], vcombine_s32(vget_low_s32(t01.val[1]), vget_low_s32(t23.val[1])));
+		vst1q_s32(&outBlock.velY[i], vcombine_s32(vget_high_s32(t01.val[1]), vget_high_s32(t23.val[1])));
+
+		outBlock.ids[i] = (signed char)record[0];
+		outBlock.ids[i + 1] = (signed char)record[NETWORK_PACKET_SIZE];
+		outBlock.ids[i + 2] = (signed char)record[2 * NETWORK_PACKET_SIZE];
+		outBlock.ids[i + 3] = (signed char)record[3 * NETWORK_PACKET_SIZE];
+	}
+	return i;
+}
+
+#endif // ENTITY_DECODE_NEON
+
+bool IsEntityDecoderSupported(EntityDecoder decoder)
+{
+	switch (decoder)
+	{
+	case ENTITY_DECODER_SCALAR:
+		return true;
+#ifdef ENTITY_DECODE_X64
+	case ENTITY_DECODER_SSE2:
+		return true;
+	case ENTITY_DECODER_AVX2:
+	{
+		static const bool bHasAVX2 = CPUHasAVX2();
+		return bHasAVX2;
+	}
+#endif
+#ifdef ENTITY_DECODE_NEON
+	case ENTITY_DECODER_NEON:
+		return true;
+#endif
+	default:
+		return false;
+	}
+}
+
+const char* GetEntityDecoderName(EntityDecoder decoder)
+{
+	static const char* names[ENTITY_DECODER_COUNT] = { "scalar", "SSE2", "AVX2", "NEON" };
+	return (decoder >= 0 && decoder < ENTITY_DECODER_COUNT) ? names[decoder] : "unknown";
+}
+
+EntityDecoder GetBestEntityDecoder()
+{
+	static const EntityDecoder best = []() {
+		const EntityDecoder fastestFirst[] = { ENTITY_DECODER_AVX2, ENTITY_DECODER_NEON, ENTITY_DECODER_SSE2 };
+		for (EntityDecoder decoder : fastestFirst)
+		{
+			if (IsEntityDecoderSupported(decoder))
+			{
+				return decoder;
+			}
+		}
+		return ENTITY_DECODER_SCALAR;
+	}();
+	return best;
+}
+
+void DecodeEntityBlockWith(EntityDecoder decoder, const char* records, int count, EntityBlock& outBlock)
+{
+	outBlock.Resize(count);
+
+	int decoded = 0;
+	switch (decoder)
+	{
+#ifdef ENTITY_DECODE_X64
+	case ENTITY_DECODER_SSE2:
+		decoded = DecodeEntitiesSSE2(records, count, outBlock);
+		break;
+	case ENTITY_DECODER_AVX2:
+		decoded = DecodeEntitiesAVX2(records, count, outBlock);
+		break;
+#endif
+#ifdef ENTITY_DECODE_NEON
+	case ENTITY_DECODER_NEON:
+		decoded = DecodeEntitiesNEON(records, count, outBlock);
+		break;
+#endif
+	default:
+		break;
+	}
+
+	DecodeEntitiesScalar(records, decoded, count, outBlock);
+}
+
+void DecodeEntityBlock(const char* records, int count, EntityBlock& outBlock)
+{
+	DecodeEntityBlockWith(GetBestEntityDecoder(), records, count, outBlock);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// Benchmark
+//
+/////////////////////////////////////////////////////////////////////////////
+
+//times one decoder, returns millions of entities per second
+static double TimeDecoder(EntityDecoder decoder, const std::vector<char>& records, int count, int iterations, EntityBlock& outBlock)
+{
+	//a warm up pass so the arrays are allocated and the cache is in the same state for everyone
+	DecodeEntityBlockWith(decoder, records.data(), count, outBlock);
+
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; i++)
+	{
+		DecodeEntityBlockWith(decoder, records.data(), count, outBlock);
+	}
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+	return (double)count * iterations / elapsed.count() / 1000000.0;
+}
+
+int RunDecodeBenchmark(int argc, char** argv)
+{
+	int firstArg = -1;
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "--bench-decode"))
+		{
+			firstArg = i + 1;
+			break;
+		}
+	}
+	if (firstArg < 0)
+	{
+		return -1;
+	}
+
+	int count = (firstArg < argc) ? atoi(argv[firstArg]) : 512;
+	int iterations = (firstArg + 1 < argc) ? atoi(argv[firstArg + 1]) : 20000;
+	if (count <= 0 || iterations <= 0)
+	{
+		printf("Usage:\n    raylib_game --bench-decode [ENTITIES] [ITERATIONS]\n");
+		return 1;
+	}
+
+	//a snapshot's worth of records, seeded so every run decodes the same thing
+	std::mt19937 random(1);
+	std::uniform_int_distribution<int> anyInt(-100000, 100000);
+	std::vector<char> records(count * NETWORK_PACKET_SIZE);
+	for (int i = 0; i < count; i++)
+	{
+		DataPacket packet;
+		packet.id = (char)(i % 128);
+		packet.posX = anyInt(random);
+		packet.posY = anyInt(random);
+		packet.velX = anyInt(random);
+		packet.velY = anyInt(random);
+		SerializeDataPacket(packet, records.data() + i * NETWORK_PACKET_SIZE);
+	}
+
+	EntityBlock scalarBlock;
+	double scalarRate = TimeDecoder(ENTITY_DECODER_SCALAR, records, count, iterations, scalarBlock);
+
+	printf("Decoding %d entities x %d, best decoder here is %s\n", count, iterations, GetEntityDecoderName(GetBestEntityDecoder()));
+	printf("%-8s %8.1f M entities/s\n", GetEntityDecoderName(ENTITY_DECODER_SCALAR), scalarRate);
+
+	int rc = 0;
+	for (int decoder = ENTITY_DECODER_SCALAR + 1; decoder < ENTITY_DECODER_COUNT; decoder++)
+	{
+		if (!IsEntityDecoderSupported((EntityDecoder)decoder))
+		{
+			continue;
+		}
+
+		EntityBlock block;
+		double rate = TimeDecoder((EntityDecoder)decoder, records, count, iterations, block);
+
+		//a fast wrong answer is no use
+		bool bMatches = memcmp(block.ids.data(), scalarBlock.ids.data(), count) == 0
+			&& memcmp(block.posX.data(), scalarBlock.posX.data(), count * sizeof(int)) == 0
+			&& memcmp(block.posY.data(), scalarBlock.posY.data(), count * sizeof(int)) == 0
+			&& memcmp(block.velX.data(), scalarBlock.velX.data(), count * sizeof(int)) == 0
+			&& memcmp(block.velY.data(), scalarBlock.velY.data(), count * sizeof(int)) == 0;
+
+		printf("%-8s %8.1f M entities/s  %.2fx scalar%s\n", GetEntityDecoderName((EntityDecoder)decoder),
+			rate, rate / scalarRate, bMatches ? "" : "  MISMATCH");
+		if (!bMatches)
+		{
+			rc = 1;
+		}
+	}
+
+	fflush(stdout);
+	return rc;
+}
@@ -0,0 +1,53 @@
+// Batch decoder for blocks of packed DataPackets
+// Snapshots carry their entities as back to back 17 byte records, [id:1][posX:4][posY:4][velX:4][velY:4].
+// The four ints in a record are exactly one 16 byte vector, so the SIMD paths load a record per
+// instruction and transpose groups of them straight into one array per field.
+// The best path for the CPU is picked the first time it's used:
+//
+//     raylib_game --bench-decode [ENTITIES] [ITERATIONS]
+//
+// times every path this machine can run against the scalar one
+
+#ifndef ENTITY_DECODE_H
+#define ENTITY_DECODE_H
+
+#include <vector>
+
+#include "net_protocol.h"
+
+enum EntityDecoder
+{
+	ENTITY_DECODER_SCALAR,
+	ENTITY_DECODER_SSE2,
+	ENTITY_DECODER_AVX2,
+	ENTITY_DECODER_NEON,
+
+	ENTITY_DECODER_COUNT
+};
+
+//decoded entities, one array per field
+//the arrays are padded past count so the vector paths can always store whole vectors
+struct EntityBlock
+{
+	int count = 0;
+	std::vector<signed char> ids;
+	std::vector<int> posX;
+	std::vector<int> posY;
+	std::vector<int> velX;
+	std::vector<int> velY;
+
+	void Resize(int newCount);
+};
+
+//whether this build and CPU can run a decoder
+bool IsEntityDecoderSupported(EntityDecoder decoder);
+const char* GetEntityDecoderName(EntityDecoder decoder);
+
+//the fastest supported decoder, worked out once
+EntityDecoder GetBestEntityDecoder();
+
+//decodes count records into outBlock
+void DecodeEntityBlock(const char* records, int count, EntityBlock& outBlock);
+void DecodeEntityBlockWith(EntityDecoder decoder, const char* records, int count, EntityBlock& outBlock);
+
+#endif // ENTITY_DECODE_H
@@ -0,0 +1,156 @@
+// Gameplay events, see game_events.h
+
+#include <string.h>
+#include <algorithm>
+
+#include "alloc_audit.h"
+#include "game_events.h"
+
+static void SerializeShort(int value, char* outChars)
+{
+	value = std::max(-32768, std::min(value, 32767));
+	outChars[0] = (char)(value & 0xFF);
+	outChars[1] = (char)((value >> 8) & 0xFF);
+}
+
+static int DeserializeShort(const char* inChars)
+{
+	return (int16)((unsigned char)inChars[0] | ((unsigned char)inChars[1] << 8));
+}
+
+int EncodeGameEvent(const GameEvent& event, char* outData)
+{
+	outData[0] = (char)event.type;
+	outData[1] = (char)event.player;
+
+	switch (event.type)
+	{
+	case GAME_EVENT_SPAWN:
+		SerializeShort(event.x, outData + 2);
+		SerializeShort(event.y, outData + 4);
+		return 6;
+	case GAME_EVENT_PICKUP:
+	{
+		int item = std::max(0, std::min(event.item, 65535));
+		outData[2] = (char)(item & 0xFF);
+		outData[3] = (char)(item >> 8);
+		SerializeShort(event.x, outData + 4);
+		SerializeShort(event.y, outData + 6);
+		return 8;
+	}
+	case GAME_EVENT_CHAT:
+	{
+		int length = (int)strnlen(event.text, GAME_EVENT_MAX_TEXT);
+		outData[2] = (char)length;
+		memcpy(outData + 3, event.text, length);
+		return 3 + length;
+	}
+	default:
+		return 0;
+	}
+}
+
+int DecodeGameEvent(const char* data, int dataSize, GameEvent& outEvent)
+{
+	if (dataSize < 2)
+	{
+		return -1;
+	}
+
+	outEvent.type = (GameEventType)(unsigned char)data[0];
+	outEvent.player = (signed char)data[1];
+	outEvent.x = 0;
+	outEvent.y = 0;
+	outEvent.item = 0;
+	outEvent.text[0] = '\0';
+
+	switch (outEvent.type)
+	{
+	case GAME_EVENT_SPAWN:
+		if (dataSize < 6)
+			return -1;
+		outEvent.x = DeserializeShort(data + 2);
+		outEvent.y = DeserializeShort(data + 4);
+		return 6;
+	case GAME_EVENT_PICKUP:
+		if (dataSize < 8)
+			return -1;
+		outEvent.item = (unsigned char)data[2] | ((unsigned char)data[3] << 8);
+		outEvent.x = DeserializeShort(data + 4);
+		outEvent.y = DeserializeShort(data + 6);
+		return 8;
+	case GAME_EVENT_CHAT:
+	{
+		int length = (dataSize >= 3) ? (unsigned char)data[2] : -1;
+		if (length < 0 || length > GAME_EVENT_MAX_TEXT || dataSize < 3 + length)
+			return -1;
+		memcpy(outEvent.text, data + 3, length);
+		outEvent.text[length] = '\0';
+		return 3 + length;
+	}
+	default:
+		return -1;
+	}
+}
+
+bool GameEventBatch::Append(const char* encoded, int size)
+{
+	if (m_nSize + size > GAME_EVENT_BATCH_SIZE)
+	{
+		return false;
+	}
+	memcpy(m_Data + m_nSize, encoded, size);
+	m_nSize += size;
+	return true;
+}
+
+//on the wire: [header][events back to back], the receiver reads events until the message ends
+SteamNetworkingMessage_t* GameEventBatch::Flush(HSteamNetConnection conn)
+{
+	if (m_nSize == 0)
+	{
+		return nullptr;
+	}
+
+	PauseAllocationAudit(); //message buffers are the library's business
+	SteamNetworkingMessage_t* pMsg = SteamNetworkingUtils()->AllocateMessage(NETWORK_HEADER_SIZE + m_nSize);
+	ResumeAllocationAudit();
+	WriteMessageHeader(MESSAGE_GAME_EVENTS, (char*)pMsg->m_pData);
+	memcpy((char*)pMsg->m_pData + NETWORK_HEADER_SIZE, m_Data, m_nSize);
+	pMsg->m_conn = conn;
+	pMsg->m_nFlags = k_nSteamNetworkingSend_Reliable;
+	pMsg->m_idxLane = NETWORK_LANE_UPDATES;
+
+	m_nSize = 0;
+	return pMsg;
+}
+
+void GameEventQueue::Push(const GameEvent& event)
+{
+	if (m_nCount == GAME_EVENT_QUEUE_SIZE)
+	{
+		//nobody's polling, keep the newest
+		m_nHead = (m_nHead + 1) % GAME_EVENT_QUEUE_SIZE;
+		m_nCount--;
+		if (m_nDropped++ == 0)
+		{
+			Printf("Game event queue is full, dropping the oldest events");
+		}
+	}
+
+	m_Events[(m_nHead + m_nCount) % GAME_EVENT_QUEUE_SIZE] = event;
+	m_nCount++;
+}
+
+bool GameEventQueue::Pop(GameEvent& outEvent)
+{
+	if (m_nCount == 0)
+	{
+		return false;
+	}
+
+	outEvent = m_Events[m_nHead];
+	m_nHead = (m_nHead + 1) % GAME_EVENT_QUEUE_SIZE;
+	m_nCount--;
+	return true;
+}
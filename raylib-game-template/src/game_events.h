@@ -0,0 +1,62 @@
+// Gameplay events
+// Pickups, chat, spawns, anything that has to arrive, unlike positions which are sent again anyway.
+// An event raised during a tick is encoded once and copied into the batch of every connection it's
+// for, and each batch goes out as one reliable MESSAGE_GAME_EVENTS when the tick ends, so an event
+// fanned out to every player costs a copy per player rather than a message per player, and
+// nothing is allocated per event.
+//
+// Each event is [type:1] followed by:
+//
+//     GAME_EVENT_SPAWN     [player:1][x:2][y:2]
+//     GAME_EVENT_PICKUP    [player:1][item:2][x:2][y:2]
+//     GAME_EVENT_CHAT      [player:1][length:1][length * char]
+
+#ifndef GAME_EVENTS_H
+#define GAME_EVENTS_H
+
+#include "net_protocol.h"
+
+#define GAME_EVENT_MAX_ENCODED_SIZE (3 + GAME_EVENT_MAX_TEXT)
+#define GAME_EVENT_BATCH_SIZE 4096 //bytes of events per message, a batch that fills up is sent early
+#define GAME_EVENT_QUEUE_SIZE 256 //received events waiting for PollGameEvent
+
+//returns the encoded size, outData needs room for GAME_EVENT_MAX_ENCODED_SIZE
+//positions and items are clamped to 16 bits and text to GAME_EVENT_MAX_TEXT
+int EncodeGameEvent(const GameEvent& event, char* outData);
+
+//returns how many bytes the event took up, or -1 if it's malformed
+int DecodeGameEvent(const char* data, int dataSize, GameEvent& outEvent);
+
+//one connection's events for this tick
+class GameEventBatch
+{
+public:
+	//returns false if it won't fit, flush and append again
+	bool Append(const char* encoded, int size);
+	bool IsEmpty() const { return m_nSize == 0; }
+
+	//builds the whole message for conn and empties the batch, nullptr if there was nothing in it
+	SteamNetworkingMessage_t* Flush(HSteamNetConnection conn);
+	void Clear() { m_nSize = 0; }
+
+private:
+	char m_Data[GAME_EVENT_BATCH_SIZE];
+	int m_nSize = 0;
+};
+
+//events received but not yet polled, the oldest are dropped if the game stops polling
+class GameEventQueue
+{
+public:
+	void Push(const GameEvent& event);
+	bool Pop(GameEvent& outEvent);
+	void Clear() { m_nHead = m_nCount = 0; }
+
+private:
+	GameEvent m_Events[GAME_EVENT_QUEUE_SIZE];
+	int m_nHead = 0;
+	int m_nCount = 0;
+	int m_nDropped = 0;
+};
+
+#endif // GAME_EVENTS_H
@@ -0,0 +1,366 @@
+// Metrics, see metrics.h
+
+#define _CRT_SECURE_NO_WARNINGS
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "async_log.h"
+#include "metrics.h"
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+enum MetricType
+{
+	METRIC_COUNTER,
+	METRIC_GAUGE,
+	METRIC_HISTOGRAM
+};
+
+struct Metric
+{
+	std::string name;
+	std::string help;
+	MetricType type;
+
+	std::atomic<unsigned long long> counter;
+	std::atomic<double> gauge;
+
+	int bucketCount;
+	double bucketBounds[METRICS_MAX_BUCKETS];
+	std::atomic<unsigned long long> bucketHits[METRICS_MAX_BUCKETS + 1]; //per bucket, the last is +Inf
+	std::atomic<double> sum;
+};
+
+//only registration and exporting take the lock, updates never do
+//a deque so metrics never move once they've been handed out
+static std::mutex s_RegistryMutex;
+static std::deque<Metric> s_Metrics;
+
+static std::string s_Target;
+static int s_IntervalMs = METRICS_DEFAULT_INTERVAL;
+static std::thread* s_pExportThread = nullptr; //never destroyed, so exit doesn't trip over a joinable thread
+static std::mutex s_ExportMutex;
+static std::condition_variable s_ExportWake;
+static bool s_bStopExport = false;
+#ifndef _WIN32
+static int s_nSocket = -1;
+#endif
+
+static Metric* RegisterMetric(MetricType type, const char* name, const char* help)
+{
+	std::lock_guard<std::mutex> lock(s_RegistryMutex);
+	for (Metric& metric : s_Metrics)
+	{
+		if (metric.name == name)
+		{
+			if (metric.type != type)
+			{
+				AsyncLog(ASYNC_LOG_WARNING, "Metric %s is already registered as another type", name);
+				return nullptr;
+			}
+			return &metric;
+		}
+	}
+
+	s_Metrics.emplace_back();
+	Metric& metric = s_Metrics.back();
+	metric.name = name;
+	metric.help = help;
+	metric.type = type;
+	metric.counter.store(0, std::memory_order_relaxed);
+	metric.gauge.store(0.0, std::memory_order_relaxed);
+	metric.bucketCount = 0;
+	metric.sum.store(0.0, std::memory_order_relaxed);
+	for (auto& hits : metric.bucketHits)
+	{
+		hits.store(0, std::memory_order_relaxed);
+	}
+	return &metric;
+}
+
+extern "C" Metric* RegisterCounter(const char* name, const char* help)
+{
+	return RegisterMetric(METRIC_COUNTER, name, help);
+}
+
+extern "C" Metric* RegisterGauge(const char* name, const char* help)
+{
+	return RegisterMetric(METRIC_GAUGE, name, help);
+}
+
+extern "C" Metric* RegisterHistogram(const char* name, const char* help, const double* bucketBounds, int bucketCount)
+{
+	Metric* pMetric = RegisterMetric(METRIC_HISTOGRAM, name, help);
+	if (pMetric != nullptr && pMetric->bucketCount == 0)
+	{
+		//only the first registration sets the buckets, they're read without the lock afterwards
+		std::lock_guard<std::mutex> lock(s_RegistryMutex);
+		pMetric->bucketCount = (bucketCount < METRICS_MAX_BUCKETS) ? bucketCount : METRICS_MAX_BUCKETS;
+		memcpy(pMetric->bucketBounds, bucketBounds, pMetric->bucketCount * sizeof(double));
+	}
+	return pMetric;
+}
+
+extern "C" void AddCounter(Metric* metric, unsigned long long amount)
+{
+	if (metric != nullptr)
+	{
+		metric->counter.fetch_add(amount, std::memory_order_relaxed);
+	}
+}
+
+extern "C" void SetGauge(Metric* metric, double value)
+{
+	if (metric != nullptr)
+	{
+		metric->gauge.store(value, std::memory_order_relaxed);
+	}
+}
+
+extern "C" void ObserveHistogram(Metric* metric, double value)
+{
+	if (metric == nullptr)
+	{
+		return;
+	}
+
+	//few enough buckets that a linear search beats anything cleverer
+	int bucket = 0;
+	while (bucket < metric->bucketCount && value > metric->bucketBounds[bucket])
+	{
+		bucket++;
+	}
+	metric->bucketHits[bucket].fetch_add(1, std::memory_order_relaxed);
+
+	double sum = metric->sum.load(std::memory_order_relaxed);
+	while (!metric->sum.compare_exchange_weak(sum, sum + value, std::memory_order_relaxed))
+	{
+	}
+}
+
+//values are read one at a time, so a snapshot taken mid-update can be off by that update
+void WriteMetricsText(std::string& out)
+{
+	std::lock_guard<std::mutex> lock(s_RegistryMutex);
+	char line[256];
+	static const char* typeNames[] = { "counter", "gauge", "histogram" };
+
+	for (const Metric& metric : s_Metrics)
+	{
+		snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s %s\n", metric.name.c_str(), metric.help.c_str(),
+			metric.name.c_str(), typeNames[metric.type]);
+		out += line;
+
+		switch (metric.type)
+		{
+		case METRIC_COUNTER:
+			snprintf(line, sizeof(line), "%s %llu\n", metric.name.c_str(), metric.counter.load(std::memory_order_relaxed));
+			out += line;
+			break;
+		case METRIC_GAUGE:
+			snprintf(line, sizeof(line), "%s %.17g\n", metric.name.c_str(), metric.gauge.load(std::memory_order_relaxed));
+			out += line;
+			break;
+		case METRIC_HISTOGRAM:
+		{
+			//Prometheus buckets count everything at or below their bound
+			unsigned long long cumulative = 0;
+			for (int bucket = 0; bucket <= metric.bucketCount; bucket++)
+			{
+				cumulative += metric.bucketHits[bucket].load(std::memory_order_relaxed);
+				if (bucket < metric.bucketCount)
+					snprintf(line, sizeof(line), "%s_bucket{le=\"%.17g\"} %llu\n", metric.name.c_str(), metric.bucketBounds[bucket], cumulative);
+				else
+					snprintf(line, sizeof(line), "%s_bucket{le=\"+Inf\"} %llu\n", metric.name.c_str(), cumulative);
+				out += line;
+			}
+			snprintf(line, sizeof(line), "%s_sum %.17g\n%s_count %llu\n", metric.name.c_str(),
+				metric.sum.load(std::memory_order_relaxed), metric.name.c_str(), cumulative);
+			out += line;
+			break;
+		}
+		}
+	}
+}
+
+//writes the whole snapshot beside the target then renames it over, so readers never see half of one
+static void ExportToFile(const std::string& text)
+{
+	std::string tempPath = s_Target + ".tmp";
+	FILE* pFile = fopen(tempPath.c_str(), "wb");
+	if (pFile == nullptr)
+	{
+		AsyncLog(ASYNC_LOG_WARNING, "Can't write metrics to %s", tempPath.c_str());
+		return;
+	}
+	bool bWritten = fwrite(text.data(), 1, text.size(), pFile) == text.size();
+	bWritten = (fclose(pFile) == 0) && bWritten;
+
+#ifdef _WIN32
+	remove(s_Target.c_str()); //rename won't replace a file on windows
+#endif
+	if (!bWritten || rename(tempPath.c_str(), s_Target.c_str()) != 0)
+	{
+		AsyncLog(ASYNC_LOG_WARNING, "Can't write metrics to %s", s_Target.c_str());
+	}
+}
+
+//pushes the snapshot to whatever is listening on the socket, reconnecting if it went away
+static void ExportToSocket(const std::string& path, const std::string& text)
+{
+#ifdef _WIN32
+	(void)path;
+	(void)text;
+#else
+	if (s_nSocket < 0)
+	{
+		sockaddr_un addr = {};
+		addr.sun_family = AF_UNIX;
+		strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+		s_nSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (s_nSocket < 0 || connect(s_nSocket, (const sockaddr*)&addr, sizeof(addr)) != 0)
+		{
+			if (s_nSocket >= 0)
+				close(s_nSocket);
+			s_nSocket = -1;
+			return; //try again next time
+		}
+	}
+
+#ifdef MSG_NOSIGNAL
+	int flags = MSG_NOSIGNAL; //a reader hanging up shouldn't kill us with SIGPIPE
+#else
+	int flags = 0;
+#endif
+	size_t sent = 0;
+	while (sent < text.size())
+	{
+		ssize_t result = send(s_nSocket, text.data() + sent, text.size() - sent, flags);
+		if (result <= 0)
+		{
+			close(s_nSocket);
+			s_nSocket = -1;
+			return;
+		}
+		sent += (size_t)result;
+	}
+#endif
+}
+
+static void ExportSnapshot()
+{
+	std::string text;
+	WriteMetricsText(text);
+
+	if (s_Target.compare(0, 5, "unix:") == 0)
+		ExportToSocket(s_Target.substr(5), text);
+	else
+		ExportToFile(text);
+}
+
+static void ExportThread()
+{
+	std::unique_lock<std::mutex> lock(s_ExportMutex);
+	while (!s_bStopExport)
+	{
+		lock.unlock();
+		ExportSnapshot();
+		lock.lock();
+		s_ExportWake.wait_for(lock, std::chrono::milliseconds(s_IntervalMs), [] { return s_bStopExport; });
+	}
+}
+
+extern "C" void StartMetricsExport(const char* target, int intervalMs)
+{
+	StopMetricsExport();
+
+#ifdef _WIN32
+	if (!strncmp(target, "unix:", 5))
+	{
+		AsyncLog(ASYNC_LOG_WARNING, "Metrics can only be exported to a file on Windows");
+		return;
+	}
+#endif
+
+	s_Target = target;
+	s_IntervalMs = (intervalMs > 0) ? intervalMs : METRICS_DEFAULT_INTERVAL;
+	s_bStopExport = false;
+
+	static bool bAtExitRegistered = false;
+	if (!bAtExitRegistered)
+	{
+		atexit(StopMetricsExport);
+		bAtExitRegistered = true;
+	}
+
+	s_pExportThread = new std::thread(ExportThread);
+	AsyncLog(ASYNC_LOG_INFO, "Exporting metrics to %s every %dms", target, s_IntervalMs);
+}
+
+extern "C" void StopMetricsExport()
+{
+	if (s_pExportThread == nullptr)
+	{
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(s_ExportMutex);
+		s_bStopExport = true;
+	}
+	s_ExportWake.notify_one();
+	s_pExportThread->join();
+	delete s_pExportThread;
+	s_pExportThread = nullptr;
+
+	//the last few seconds would be lost otherwise
+	ExportSnapshot();
+#ifndef _WIN32
+	if (s_nSocket >= 0)
+	{
+		close(s_nSocket);
+		s_nSocket = -1;
+	}
+#endif
+}
+
+const std::string& GetMetricsTarget()
+{
+	return s_Target;
+}
+
+int GetMetricsInterval()
+{
+	return s_IntervalMs;
+}
+
+extern "C" void ConfigureMetrics(int argc, char** argv)
+{
+	const char* target = nullptr;
+	int intervalMs = METRICS_DEFAULT_INTERVAL;
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (!strcmp(argv[i], "--metrics"))
+			target = argv[++i];
+		else if (!strcmp(argv[i], "--metrics-interval"))
+			intervalMs = atoi(argv[++i]);
+	}
+
+	if (target != nullptr)
+	{
+		StartMetricsExport(target, intervalMs);
+	}
+}
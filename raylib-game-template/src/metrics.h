@@ -0,0 +1,52 @@
+// Metrics
+// Counters, gauges and histograms any thread can update with a relaxed atomic, no locks.
+// A background thread snapshots them every so often in Prometheus text format, to a file
+// (replaced whole, for a textfile collector) or pushed down a Unix socket:
+//
+//     raylib_game [--metrics FILE | --metrics unix:SOCKET] [--metrics-interval MS]
+//
+// Metrics are registered by name, registering the same name again gives back the same metric,
+// so callers can look theirs up once and keep the pointer.
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#define METRICS_DEFAULT_INTERVAL 5000 //milliseconds between snapshots
+#define METRICS_MAX_BUCKETS 16 //histogram buckets, not counting +Inf
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct Metric Metric;
+
+	//called once at startup, picks up --metrics and starts exporting if it's there
+	void ConfigureMetrics(int argc, char** argv);
+
+	//bucketBounds are the upper bounds of the buckets, in increasing order
+	Metric* RegisterCounter(const char* name, const char* help);
+	Metric* RegisterGauge(const char* name, const char* help);
+	Metric* RegisterHistogram(const char* name, const char* help, const double* bucketBounds, int bucketCount);
+
+	void AddCounter(Metric* metric, unsigned long long amount);
+	void SetGauge(Metric* metric, double value);
+	void ObserveHistogram(Metric* metric, double value);
+
+	//exports every interval until StopMetricsExport, a target starting with unix: is a socket path
+	void StartMetricsExport(const char* target, int intervalMs);
+	void StopMetricsExport(); //writes a last snapshot, called at exit
+
+#ifdef __cplusplus
+}
+
+#include <string>
+
+//appends every metric in Prometheus text format
+void WriteMetricsText(std::string& out);
+
+//where and how often we're exporting, empty if we aren't, so the cluster coordinator can pass it on
+const std::string& GetMetricsTarget();
+int GetMetricsInterval();
+#endif
+
+#endif // METRICS_H
@@ -0,0 +1,266 @@
+// Server-authoritative movement, see movement.h
+
+#include "movement.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+//the solid parts of the world, a pillar either side of where players start
+static const WorldBox s_Obstacles[] =
+{
+	{ 200, 150, 40, 150 },
+	{ 560, 150, 40, 150 },
+};
+
+int GetWorldObstacles(const WorldBox** outBoxes)
+{
+	*outBoxes = s_Obstacles;
+	return (int)(sizeof(s_Obstacles) / sizeof(s_Obstacles[0]));
+}
+
+Vector2Int LimitMove(Vector2Int from, Vector2Int to, SteamNetworkingMicroseconds elapsed)
+{
+	//no further than across the world, however long they've been quiet
+	int64 maxStep = (int64)NETWORK_PLAYER_SPEED * std::max(elapsed, (SteamNetworkingMicroseconds)0) / 1000000;
+	int step = (int)std::min(maxStep, (int64)NETWORK_WORLD_WIDTH) + MOVEMENT_SPEED_TOLERANCE;
+
+	Vector2Int limited;
+	limited.x = from.x + std::min(std::max(to.x - from.x, -step), step);
+	limited.y = from.y + std::min(std::max(to.y - from.y, -step), step);
+	return limited;
+}
+
+Vector2Int LimitVelocity(Vector2Int velocity)
+{
+	Vector2Int limited;
+	limited.x = std::min(std::max(velocity.x, -NETWORK_PLAYER_SPEED), NETWORK_PLAYER_SPEED);
+	limited.y = std::min(std::max(velocity.y, -NETWORK_PLAYER_SPEED), NETWORK_PLAYER_SPEED);
+	return limited;
+}
+
+//pushes two overlapping players apart along whichever axis they overlap least, half each
+static void SeparateBodies(MovementBody& a, MovementBody& b)
+{
+	int dx = b.position.x - a.position.x;
+	int dy = b.position.y - a.position.y;
+	if (abs(dx) >= NETWORK_PLAYER_SIZE || abs(dy) >= NETWORK_PLAYER_SIZE)
+	{
+		return;
+	}
+
+	int overlapX = NETWORK_PLAYER_SIZE - abs(dx);
+	int overlapY = NETWORK_PLAYER_SIZE - abs(dy);
+	if (overlapX <= overlapY)
+	{
+		//right on top of each other, the lower ID goes left so it's the same every time
+		int direction = (dx > 0 || (dx == 0 && a.id < b.id)) ? 1 : -1;
+		a.position.x -= direction * (overlapX / 2);
+		b.position.x += direction * (overlapX - overlapX / 2);
+		a.bBlockedX = b.bBlockedX = true;
+	}
+	else
+	{
+		int direction = (dy > 0 || (dy == 0 && a.id < b.id)) ? 1 : -1;
+		a.position.y -= direction * (overlapY / 2);
+		b.position.y += direction * (overlapY - overlapY / 2);
+		a.bBlockedY = b.bBlockedY = true;
+	}
+	a.bMoved = b.bMoved = true;
+}
+
+//pushes a player out of an obstacle the shortest way
+static void PushOutOfBox(MovementBody& body, const WorldBox& box)
+{
+	int pushLeft = body.position.x + NETWORK_PLAYER_SIZE - box.x;
+	int pushRight = box.x + box.width - body.position.x;
+	int pushUp = body.position.y + NETWORK_PLAYER_SIZE - box.y;
+	int pushDown = box.y + box.height - body.position.y;
+	if (pushLeft <= 0 || pushRight <= 0 || pushUp <= 0 || pushDown <= 0)
+	{
+		return;
+	}
+
+	int shortest = std::min(std::min(pushLeft, pushRight), std::min(pushUp, pushDown));
+	if (shortest == pushLeft)
+		body.position.x -= pushLeft;
+	else if (shortest == pushRight)
+		body.position.x += pushRight;
+	else if (shortest == pushUp)
+		body.position.y -= pushUp;
+	else
+		body.position.y += pushDown;
+
+	if (shortest == pushLeft || shortest == pushRight)
+		body.bBlockedX = true;
+	else
+		body.bBlockedY = true;
+	body.bMoved = true;
+}
+
+static void ClampToWorld(MovementBody& body)
+{
+	int x = std::min(std::max(body.position.x, 0), NETWORK_WORLD_WIDTH - NETWORK_PLAYER_SIZE);
+	int y = std::min(std::max(body.position.y, 0), NETWORK_WORLD_HEIGHT - NETWORK_PLAYER_SIZE);
+	if (x != body.position.x)
+	{
+		body.position.x = x;
+		body.bBlockedX = true;
+		body.bMoved = true;
+	}
+	if (y != body.position.y)
+	{
+		body.position.y = y;
+		body.bBlockedY = true;
+		body.bMoved = true;
+	}
+}
+
+void MovementStep::Reserve(int count)
+{
+	m_CellBodies.reserve(count);
+	m_BodyCells.reserve(count);
+}
+
+void MovementStep::Resolve(std::vector<MovementBody>& bodies)
+{
+	int count = (int)bodies.size();
+	BuildGrid(bodies);
+
+	//a cell is twice a player wide, so anyone touching a player is in one of the nine cells around theirs
+	for (int i = 0; i < count; i++)
+	{
+		int column = m_BodyCells[i] % MOVEMENT_GRID_COLUMNS;
+		int row = m_BodyCells[i] / MOVEMENT_GRID_COLUMNS;
+		for (int y = std::max(row - 1, 0); y <= std::min(row + 1, MOVEMENT_GRID_ROWS - 1); y++)
+		{
+			for (int x = std::max(column - 1, 0); x <= std::min(column + 1, MOVEMENT_GRID_COLUMNS - 1); x++)
+			{
+				int cell = y * MOVEMENT_GRID_COLUMNS + x;
+				for (int entry = m_CellStart[cell]; entry < m_CellStart[cell + 1]; entry++)
+				{
+					//each pair only once
+					int other = m_CellBodies[entry];
+					if (other > i)
+					{
+						SeparateBodies(bodies[i], bodies[other]);
+					}
+				}
+			}
+		}
+	}
+
+	const WorldBox* obstacles = nullptr;
+	int obstacleCount = GetWorldObstacles(&obstacles);
+	for (MovementBody& body : bodies)
+	{
+		for (int i = 0; i < obstacleCount; i++)
+		{
+			PushOutOfBox(body, obstacles[i]);
+		}
+		ClampToWorld(body);
+	}
+}
+
+//counting sort of the bodies by cell, anyone outside the world goes in the nearest edge cell
+void MovementStep::BuildGrid(const std::vector<MovementBody>& bodies)
+{
+	const int cellCount = MOVEMENT_GRID_COLUMNS * MOVEMENT_GRID_ROWS;
+	int count = (int)bodies.size();
+	m_CellBodies.resize(count);
+	m_BodyCells.resize(count);
+	std::fill(m_CellStart, m_CellStart + cellCount + 1, 0);
+
+	for (int i = 0; i < count; i++)
+	{
+		int column = std::min(std::max(bodies[i].position.x / MOVEMENT_CELL_SIZE, 0), MOVEMENT_GRID_COLUMNS - 1);
+		int row = std::min(std::max(bodies[i].position.y / MOVEMENT_CELL_SIZE, 0), MOVEMENT_GRID_ROWS - 1);
+		m_BodyCells[i] = row * MOVEMENT_GRID_COLUMNS + column;
+		m_CellStart[m_BodyCells[i] + 1]++;
+	}
+
+	for (int cell = 1; cell <= cellCount; cell++)
+	{
+		m_CellStart[cell] += m_CellStart[cell - 1];
+	}
+
+	//placing each body moves its cell's start on to the next cell's, so put them back after
+	for (int i = 0; i < count; i++)
+	{
+		m_CellBodies[m_CellStart[m_BodyCells[i]]++] = i;
+	}
+	for (int cell = cellCount; cell > 0; cell--)
+	{
+		m_CellStart[cell] = m_CellStart[cell - 1];
+	}
+	m_CellStart[0] = 0;
+}
+
+int RunMovementBenchmark(int argc, char** argv)
+{
+	int firstArg = -1;
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "--bench-movement"))
+		{
+			firstArg = i + 1;
+			break;
+		}
+	}
+	if (firstArg < 0)
+	{
+		return -1;
+	}
+
+	int count = (firstArg < argc) ? atoi(argv[firstArg]) : 1000;
+	int steps = (firstArg + 1 < argc) ? atoi(argv[firstArg + 1]) : 1000;
+	if (count <= 0 || steps <= 0)
+	{
+		printf("Usage:\n    raylib_game --bench-movement [BODIES] [STEPS]\n");
+		return 1;
+	}
+
+	//bodies scattered over the world heading every which way, seeded so every run is the same
+	//more of them than a real world holds (IDs are a char), the step itself has no such limit
+	std::mt19937 random(1);
+	std::uniform_int_distribution<int> anyX(0, NETWORK_WORLD_WIDTH - NETWORK_PLAYER_SIZE);
+	std::uniform_int_distribution<int> anyY(0, NETWORK_WORLD_HEIGHT - NETWORK_PLAYER_SIZE);
+	std::uniform_int_distribution<int> anyVelocity(-NETWORK_PLAYER_SPEED, NETWORK_PLAYER_SPEED);
+	std::vector<MovementBody> bodies(count);
+	for (int i = 0; i < count; i++)
+	{
+		bodies[i] = { i, { anyX(random), anyY(random) }, { anyVelocity(random), anyVelocity(random) }, false, false, false };
+	}
+
+	MovementStep step;
+	step.Reserve(count);
+
+	//a 60Hz tick's worth of movement, then the step, which is all that's timed
+	double total = 0.0;
+	double slowest = 0.0;
+	for (int i = 0; i < steps; i++)
+	{
+		for (MovementBody& body : bodies)
+		{
+			if (body.bBlockedX)
+				body.velocity.x = -body.velocity.x;
+			if (body.bBlockedY)
+				body.velocity.y = -body.velocity.y;
+			body.position.x += body.velocity.x / 60;
+			body.position.y += body.velocity.y / 60;
+			body.bMoved = body.bBlockedX = body.bBlockedY = false;
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		step.Resolve(bodies);
+		double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		total += elapsed;
+		slowest = std::max(slowest, elapsed);
+	}
+
+	printf("Movement step, %d bodies x %d steps: mean %.3f ms, max %.3f ms\n", count, steps, total * 1000.0 / steps, slowest * 1000.0);
+	return 0;
+}
@@ -0,0 +1,64 @@
+// Server-authoritative movement
+// Clients say where they are and the server decides where they're allowed to be. A claimed move
+// is held to NETWORK_PLAYER_SPEED on each axis, the same rule the gameplay screen moves by, and
+// every tick the movement step pushes apart players that overlap, pushes players out of the
+// world's obstacles and keeps everyone inside the world. Anyone it moves is told where they are.
+//
+// Overlapping players are found with a uniform grid of cells twice a player wide, rebuilt every
+// step with a counting sort into arrays that are kept between steps. A player is only tested
+// against the players in the nine cells around it, so the step grows with the number of players
+// rather than its square. There are only a handful of obstacles, every player is tested against
+// each of them. To time the step on its own:
+//
+//     raylib_game --bench-movement [BODIES] [STEPS]
+//
+// Only state sync servers run it, rollback players move by rollback's own deterministic step.
+
+#ifndef MOVEMENT_H
+#define MOVEMENT_H
+
+#include <vector>
+
+#include "net_protocol.h"
+
+#define MOVEMENT_CELL_SIZE (NETWORK_PLAYER_SIZE * 2)
+#define MOVEMENT_GRID_COLUMNS ((NETWORK_WORLD_WIDTH + MOVEMENT_CELL_SIZE - 1) / MOVEMENT_CELL_SIZE)
+#define MOVEMENT_GRID_ROWS ((NETWORK_WORLD_HEIGHT + MOVEMENT_CELL_SIZE - 1) / MOVEMENT_CELL_SIZE)
+//slack on the speed limit in pixels, packets don't arrive spaced exactly as far apart as they were sent
+#define MOVEMENT_SPEED_TOLERANCE 20
+
+//a player as the movement step sees them
+struct MovementBody
+{
+	int id;
+	Vector2Int position;
+	Vector2Int velocity;
+	bool bMoved; //the step moved them, so they need telling
+	bool bBlockedX; //they were stopped along this axis, so they shouldn't keep being extrapolated into it
+	bool bBlockedY;
+};
+
+//where a player claiming to have gone from from to to over elapsed could actually have got to
+Vector2Int LimitMove(Vector2Int from, Vector2Int to, SteamNetworkingMicroseconds elapsed);
+//a claimed velocity no faster than a player can go
+Vector2Int LimitVelocity(Vector2Int velocity);
+
+class MovementStep
+{
+public:
+	//sized for count bodies, so stepping that many never allocates
+	void Reserve(int count);
+
+	//moves bodies so that none overlap each other or an obstacle and all are inside the world
+	//one pass, a crowd pushed into a corner can still overlap a little until the next step
+	void Resolve(std::vector<MovementBody>& bodies);
+
+private:
+	void BuildGrid(const std::vector<MovementBody>& bodies);
+
+	int m_CellStart[MOVEMENT_GRID_COLUMNS * MOVEMENT_GRID_ROWS + 1]; //first entry in m_CellBodies for each cell
+	std::vector<int> m_CellBodies; //body indices, sorted by cell
+	std::vector<int> m_BodyCells; //the cell each body is in
+};
+
+#endif // MOVEMENT_H
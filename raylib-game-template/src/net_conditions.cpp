@@ -0,0 +1,262 @@
+// Network condition simulator, see net_conditions.h
+
+#define _CRT_SECURE_NO_WARNINGS
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <fstream>
+#include <random>
+#include <sstream>
+
+#include "net_conditions.h"
+
+//one line of a profile, the settings it names change at that time and the rest carry on
+struct ProfileStep
+{
+	SteamNetworkingMicroseconds time;
+	std::vector<std::pair<std::string, float>> settings;
+};
+
+static NetworkConditions s_BaseConditions = {};
+static NetworkConditions s_AppliedConditions = {};
+static int s_AppliedLagMs = 0; //the base lag with the jitter added
+static std::vector<std::string> s_Arguments;
+static std::string s_ProfilePath;
+static std::vector<ProfileStep> s_Profile;
+static SteamNetworkingMicroseconds s_ProfileRepeat = 0; //0 plays the profile once
+static SteamNetworkingMicroseconds s_StartTime = 0;
+static SteamNetworkingMicroseconds s_LastJitterTime = 0;
+static bool s_bEnabled = false;
+static std::mt19937 s_JitterRandom(1); //seeded so a run can be repeated
+
+//sets one field by its option name, returns false for a name we don't know
+static bool SetCondition(NetworkConditions& conditions, const char* name, float value)
+{
+	if (!strcmp(name, "lag"))
+		conditions.lagMs = (int)value;
+	else if (!strcmp(name, "jitter"))
+		conditions.jitterMs = (int)value;
+	else if (!strcmp(name, "loss"))
+		conditions.lossPercent = value;
+	else if (!strcmp(name, "reorder"))
+		conditions.reorderPercent = value;
+	else if (!strcmp(name, "reorder-time"))
+		conditions.reorderMs = (int)value;
+	else if (!strcmp(name, "dup"))
+		conditions.duplicatePercent = value;
+	else if (!strcmp(name, "dup-time"))
+		conditions.duplicateMs = (int)value;
+	else if (!strcmp(name, "rate"))
+		conditions.rateLimit = (int)value;
+	else
+		return false;
+	return true;
+}
+
+bool ParseNetworkConditionOption(int argc, const char* const* argv, int& i)
+{
+	if (strncmp(argv[i], "--sim-", 6) != 0 || i + 1 >= argc)
+	{
+		return false;
+	}
+
+	const char* name = argv[i] + 6;
+	const char* value = argv[i + 1];
+	if (!strcmp(name, "profile"))
+	{
+		s_ProfilePath = value;
+	}
+	else if (!strcmp(name, "seed"))
+	{
+		s_JitterRandom.seed((unsigned int)atoi(value));
+	}
+	else if (!SetCondition(s_BaseConditions, name, (float)atof(value)))
+	{
+		return false;
+	}
+
+	s_Arguments.push_back(argv[i]);
+	s_Arguments.push_back(value);
+	s_bEnabled = true;
+	i++;
+	return true;
+}
+
+const std::vector<std::string>& GetNetworkConditionArguments()
+{
+	return s_Arguments;
+}
+
+extern "C" void ConfigureNetworkConditions(int argc, char** argv)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		ParseNetworkConditionOption(argc, argv, i);
+	}
+}
+
+//reads a profile file, one "seconds name value ..." per line
+static void LoadProfile(const char* path)
+{
+	std::ifstream file(path);
+	if (!file)
+	{
+		FatalError("Can't open network condition profile %s", path);
+	}
+
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(file, line))
+	{
+		lineNumber++;
+		line = line.substr(0, line.find('#'));
+
+		std::istringstream words(line);
+		std::string first;
+		if (!(words >> first))
+		{
+			continue;
+		}
+
+		if (first == "repeat")
+		{
+			float seconds = 0.0f;
+			if (!(words >> seconds) || seconds <= 0.0f)
+			{
+				FatalError("%s:%d: repeat needs a period in seconds", path, lineNumber);
+			}
+			s_ProfileRepeat = (SteamNetworkingMicroseconds)(seconds * 1000000);
+			continue;
+		}
+
+		ProfileStep step;
+		step.time = (SteamNetworkingMicroseconds)(atof(first.c_str()) * 1000000);
+
+		std::string name;
+		float value;
+		while (words >> name >> value)
+		{
+			NetworkConditions scratch = {};
+			if (!SetCondition(scratch, name.c_str(), value))
+			{
+				FatalError("%s:%d: unknown setting '%s'", path, lineNumber, name.c_str());
+			}
+			step.settings.emplace_back(name, value);
+		}
+		s_Profile.push_back(step);
+	}
+
+	//steps are applied in order, so let the file list them however it likes
+	std::stable_sort(s_Profile.begin(), s_Profile.end(), [](const ProfileStep& a, const ProfileStep& b) {
+		return a.time < b.time;
+		});
+
+	Printf("Loaded %d network condition changes from %s", (int)s_Profile.size(), path);
+}
+
+//hands the settings to GNS, only the ones that changed
+static void ApplyConditions(const NetworkConditions& conditions, int lagMs)
+{
+	ISteamNetworkingUtils* pUtils = SteamNetworkingUtils();
+
+	if (lagMs != s_AppliedLagMs)
+		pUtils->SetGlobalConfigValueInt32(k_ESteamNetworkingConfig_FakePacketLag_Send, lagMs);
+	if (conditions.lossPercent != s_AppliedConditions.lossPercent)
+		pUtils->SetGlobalConfigValueFloat(k_ESteamNetworkingConfig_FakePacketLoss_Send, conditions.lossPercent);
+	if (conditions.reorderPercent != s_AppliedConditions.reorderPercent)
+		pUtils->SetGlobalConfigValueFloat(k_ESteamNetworkingConfig_FakePacketReorder_Send, conditions.reorderPercent);
+	if (conditions.reorderMs != s_AppliedConditions.reorderMs)
+		pUtils->SetGlobalConfigValueInt32(k_ESteamNetworkingConfig_FakePacketReorder_Time, conditions.reorderMs);
+	if (conditions.duplicatePercent != s_AppliedConditions.duplicatePercent)
+		pUtils->SetGlobalConfigValueFloat(k_ESteamNetworkingConfig_FakePacketDup_Send, conditions.duplicatePercent);
+	if (conditions.duplicateMs != s_AppliedConditions.duplicateMs)
+		pUtils->SetGlobalConfigValueInt32(k_ESteamNetworkingConfig_FakePacketDup_TimeMax, conditions.duplicateMs);
+	if (conditions.rateLimit != s_AppliedConditions.rateLimit)
+		pUtils->SetGlobalConfigValueInt32(k_ESteamNetworkingConfig_FakeRateLimit_Send_Rate, conditions.rateLimit);
+
+	//only the base lag is logged, or every jitter reroll would spam the console
+	if (conditions.lagMs != s_AppliedConditions.lagMs || conditions.jitterMs != s_AppliedConditions.jitterMs
+		|| conditions.lossPercent != s_AppliedConditions.lossPercent || conditions.reorderPercent != s_AppliedConditions.reorderPercent
+		|| conditions.duplicatePercent != s_AppliedConditions.duplicatePercent || conditions.rateLimit != s_AppliedConditions.rateLimit)
+	{
+		Printf("Simulating lag %dms +-%dms, loss %.1f%%, reorder %.1f%%, duplicate %.1f%%, rate limit %d B/s",
+			conditions.lagMs, conditions.jitterMs, conditions.lossPercent, conditions.reorderPercent,
+			conditions.duplicatePercent, conditions.rateLimit);
+	}
+
+	s_AppliedConditions = conditions;
+	s_AppliedLagMs = lagMs;
+}
+
+void StartNetworkConditions()
+{
+	if (!s_bEnabled)
+	{
+		return;
+	}
+
+	if (!s_ProfilePath.empty() && s_Profile.empty())
+	{
+		LoadProfile(s_ProfilePath.c_str());
+	}
+
+	//forces every setting out on the first update
+	s_AppliedLagMs = -1;
+	s_AppliedConditions = {};
+	s_AppliedConditions.lagMs = -1;
+	s_AppliedConditions.lossPercent = -1.0f;
+	s_AppliedConditions.reorderPercent = -1.0f;
+	s_AppliedConditions.reorderMs = -1;
+	s_AppliedConditions.duplicatePercent = -1.0f;
+	s_AppliedConditions.duplicateMs = -1;
+	s_AppliedConditions.rateLimit = -1;
+
+	s_StartTime = SteamNetworkingUtils()->GetLocalTimestamp();
+	s_LastJitterTime = 0;
+	UpdateNetworkConditions();
+}
+
+void UpdateNetworkConditions()
+{
+	if (!s_bEnabled)
+	{
+		return;
+	}
+
+	SteamNetworkingMicroseconds now = SteamNetworkingUtils()->GetLocalTimestamp();
+	SteamNetworkingMicroseconds profileTime = now - s_StartTime;
+	if (s_ProfileRepeat > 0)
+	{
+		profileTime %= s_ProfileRepeat;
+	}
+
+	//replay the profile up to now on top of the command line settings
+	NetworkConditions conditions = s_BaseConditions;
+	for (const ProfileStep& step : s_Profile)
+	{
+		if (step.time > profileTime)
+		{
+			break;
+		}
+		for (auto& setting : step.settings)
+		{
+			SetCondition(conditions, setting.first.c_str(), setting.second);
+		}
+	}
+
+	//packets take the lag in force when they're sent, so moving it around spreads them out like jitter would
+	int lagMs = conditions.lagMs;
+	if (conditions.jitterMs > 0)
+	{
+		lagMs = s_AppliedLagMs;
+		if (now - s_LastJitterTime >= NETWORK_SIM_JITTER_INTERVAL)
+		{
+			std::uniform_int_distribution<int> jitter(-conditions.jitterMs, conditions.jitterMs);
+			lagMs = std::max(conditions.lagMs + jitter(s_JitterRandom), 0);
+			s_LastJitterTime = now;
+		}
+	}
+
+	ApplyConditions(conditions, lagMs);
+}
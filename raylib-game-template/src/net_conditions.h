@@ -0,0 +1,55 @@
+// Network condition simulator
+// Turns on GameNetworkingSockets' fake lag, loss, reordering, duplication and rate limiting so
+// bad connections can be reproduced on one machine. Every process takes the same options, the
+// game, the cluster processes and the relay alike, and the cluster coordinator passes them on:
+//
+//     raylib_game [--sim-lag MS] [--sim-jitter MS] [--sim-loss PCT] [--sim-reorder PCT] [--sim-reorder-time MS]
+//                 [--sim-dup PCT] [--sim-dup-time MS] [--sim-rate BYTES_PER_SEC] [--sim-profile FILE] [--sim-seed N]
+//
+// The settings apply to what this process sends, so two processes on --sim-lag 50 see a 100ms round trip.
+// A profile changes the settings over time, one line per change, "repeat" loops it:
+//
+//     # seconds  setting value ...
+//     0   lag 40 jitter 10
+//     10  loss 2
+//     11  loss 0
+//     repeat 10
+
+#ifndef NET_CONDITIONS_H
+#define NET_CONDITIONS_H
+
+#include <string>
+#include <vector>
+
+#include "net_protocol.h"
+
+//how often the jittered lag is rerolled
+#define NETWORK_SIM_JITTER_INTERVAL 20000 //microseconds
+
+//everything the simulator can fake, all off when zeroed
+struct NetworkConditions
+{
+	int lagMs;
+	int jitterMs; //lag wanders this far either side, GNS has no jitter of its own
+	float lossPercent;
+	float reorderPercent;
+	int reorderMs; //extra delay on a reordered packet
+	float duplicatePercent;
+	int duplicateMs; //duplicates arrive up to this much later
+	int rateLimit; //bytes per second, 0 for no limit
+};
+
+//takes one --sim-* option (and its value) out of a command line, advancing i past it
+//returns false if argv[i] isn't one, so the caller can carry on with its own options
+bool ParseNetworkConditionOption(int argc, const char* const* argv, int& i);
+
+//the options as given, so the cluster coordinator can hand them to its children
+const std::vector<std::string>& GetNetworkConditionArguments();
+
+//called once the networking library is up, applies the starting conditions
+void StartNetworkConditions();
+
+//steps the profile and the jitter, called every tick by anything that has a network loop
+void UpdateNetworkConditions();
+
+#endif // NET_CONDITIONS_H
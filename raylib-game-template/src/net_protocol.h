@@ -0,0 +1,123 @@
+// Wire format and helpers shared by everything that speaks the game protocol:
+// the game's own client/server (networking.cpp) and the zone cluster processes (zone_cluster.cpp)
+
+#ifndef NET_PROTOCOL_H
+#define NET_PROTOCOL_H
+
+#include <GameNetworkingSockets/steam/steamnetworkingsockets.h>
+#include <GameNetworkingSockets/steam/isteamnetworkingutils.h>
+#ifndef STEAMNETWORKINGSOCKETS_OPENSOURCE
+#include <GameNetworkingSockets/steam/steam_api.h>
+#endif
+
+#include <map>
+#include <vector>
+
+#include "networking.h"
+#include "node_pool.h"
+
+#define NETWORK_PACKET_SIZE 17
+
+//every message starts with a small header: [message type:1][protocol version:1]
+//bump the version whenever a message layout changes
+#define NETWORK_HEADER_SIZE 2
+#define NETWORK_PROTOCOL_VERSION 6
+
+//snapshot payload before the entities:
+//[sequence:4][server time:8][echoed client time:8][server hold time:4][count:4]
+#define NETWORK_SNAPSHOT_HEADER_SIZE 28
+
+//connection lanes
+//lane 0 carries the per-frame position updates, the bulk lane carries
+//large one-off transfers (the join baseline) so they don't hold up updates
+#define NETWORK_LANE_UPDATES 0
+#define NETWORK_LANE_BULK 1
+#define NETWORK_LANE_COUNT 2
+
+//message types, the first byte of every message
+//these index straight into the handler tables, so only ever append to this list
+enum MessageType : unsigned char
+{
+	MESSAGE_ASSIGN_ID,		//server -> client, [id:1][session token:8]
+	MESSAGE_BASELINE,		//server -> client, compressed world baseline
+	MESSAGE_PLAYER_STATE,	//client -> server, [DataPacket][client send time:8][acked snapshot:4]
+	MESSAGE_SNAPSHOT,		//server -> client, [snapshot header][count * DataPacket]
+	MESSAGE_ROLLBACK_INPUT,	//both ways, [player:1][frame:4][input:1]
+	MESSAGE_ROLLBACK_SYNC,	//server -> client, [RollbackState as ints]
+	MESSAGE_ZONE_HELLO,		//front/zone -> zone, [role:1][zone:1]
+	MESSAGE_ZONE_ROUTE,		//front/zone -> zone, [DataPacket][owner epoch:4]
+	MESSAGE_ZONE_HANDOFF,	//zone -> zone, [DataPacket][owner epoch:4]
+	MESSAGE_ZONE_MIRROR,	//zone -> zone, [count:4][count * DataPacket]
+	MESSAGE_ZONE_STATE,		//zone -> front, [count:4][count * (DataPacket, owner epoch:4)]
+	MESSAGE_ZONE_REMOVE,	//front -> zone, [id:1]
+	MESSAGE_SUBSCRIBE,		//relay -> server, no payload
+	MESSAGE_RESUME,			//client -> server, [session token:8]
+	MESSAGE_BASELINE_DELTA,	//server -> client, compressed changes since their last acked snapshot
+	MESSAGE_JOIN_QUEUE,		//server -> client, [position in the join queue:4]
+	MESSAGE_CODEC_OFFER,	//both ways, [dictionary id:4], the server answers with the id it'll pack with, or 0
+	MESSAGE_SNAPSHOT_PACKED,	//server -> client, [raw size:4][record offset:1][rANS stream], see snapshot_codec.h
+	MESSAGE_GAME_EVENTS,	//both ways, game events back to back, see game_events.h
+	MESSAGE_POSITION_CORRECTION,	//server -> client, [posX:4][posY:4], where the server has put them
+
+	MESSAGE_TYPE_COUNT
+};
+
+//serialization helpers, all little endian
+void SerializeInt(const int inInt, char* outChars);
+const int DeserializeInt(const char* inChars, const int startIndex);
+const int DeserializeInt(const char* inChars);
+void SerializeInt64(const int64 inInt, char* outChars);
+int64 DeserializeInt64(const char* inChars);
+void SerializeDataPacket(const DataPacket& inPacket, char* outPacket);
+DataPacket DeserializeDataPacket(const char* inPacket);
+void WriteMessageHeader(MessageType type, char* outMessage);
+
+//last known state of a networked player
+//positions are extrapolated from this using its velocity until the next update arrives
+struct RemoteEntity
+{
+	Vector2Int position;
+	Vector2Int velocity;
+	SteamNetworkingMicroseconds updateTime;
+};
+
+//every networked entity, by ID
+//the nodes come from a pool reserved for NETWORK_MAX_ENTITIES, so adding one never allocates
+struct EntityMapPoolTag {};
+typedef std::map<int, RemoteEntity, std::less<int>, NodePoolAllocator<std::pair<const int, RemoteEntity>, EntityMapPoolTag>> EntityMap;
+
+//where an entity should be now, going by its last update
+Vector2Int ExtrapolatePosition(const RemoteEntity& entity, SteamNetworkingMicroseconds now);
+
+//a whole world as one compressed MESSAGE_BASELINE, header included
+//bUseDictionary packs it with the snapshot dictionary, only for clients that agreed to it
+std::vector<char> BuildWorldBaseline(const std::vector<DataPacket>& entities, bool bUseDictionary = false);
+
+//handles the payload of one message, after the header has been checked
+typedef void (*MessageHandler)(const ISteamNetworkingMessage* pMsg, const char* payload, int payloadSize);
+
+struct MessageHandlerEntry
+{
+	int minPayloadSize; //anything shorter is rejected before the handler sees it
+	MessageHandler handler; //nullptr if this side never expects the message
+};
+
+//checks the header and size of a message then hands it to its handler
+//returns false if the message was rejected
+bool DispatchNetworkMessage(const MessageHandlerEntry* handlers, const ISteamNetworkingMessage* pMsg);
+
+//send through these rather than m_pInterface directly, so the traffic shows up in the metrics
+EResult SendNetworkMessage(HSteamNetConnection conn, const void* data, uint32 size, int sendFlags);
+void SendNetworkMessages(int count, SteamNetworkingMessage_t* const* messages, int64* outResults);
+
+//brings up the networking library and routes its logging to the console
+void InitNetworkLibrary();
+
+//starts a client or server from a command line style string, see PrintUsageAndExit
+void startSession(const char* argument);
+
+//console output, FatalError also kills the process
+void Printf(const char* fmt, ...);
+void FatalError(const char* fmt, ...);
+
+#endif // NET_PROTOCOL_H
@@ -12,25 +12,110 @@
 #include <chrono>
 #include <thread>
 #include <mutex>
+#include <atomic>
+#include <vector>
 #include <queue>
+#include <deque>
 #include <map>
 #include <cctype>
 
-#include <GameNetworkingSockets/steam/steamnetworkingsockets.h>
-#include <GameNetworkingSockets/steam/isteamnetworkingutils.h>
-#ifndef STEAMNETWORKINGSOCKETS_OPENSOURCE
-#include <GameNetworkingSockets/steam/steam_api.h>
-#endif
-
 #ifdef _WIN32
+#define NOMINMAX // we want std::min/std::max, not the windows.h macros
 #include <windows.h> // Ug, for NukeProcess -- see below
 #else
 #include <unistd.h>
 #include <signal.h>
 #endif
 
-#define NETWORK_PACKET_SIZE 9
-#include "networking.h"
+//dead reckoning
+//a packet is only sent when the position drifts this far (in pixels) from
+//where the others would have extrapolated it, or when the heartbeat is due
+#define NETWORK_DEAD_RECKON_THRESHOLD 3
+#define NETWORK_HEARTBEAT_INTERVAL 500000 //microseconds
+//stop extrapolating a position that hasn't been updated in this long
+#define NETWORK_MAX_EXTRAPOLATION 1500000 //microseconds
+
+//snapshots are built on the job system (rjobs.h) once there are this many clients,
+//below that the hand-off costs more than it saves
+#define NETWORK_PARALLEL_SNAPSHOT_MIN_CLIENTS 64
+
+//backpressure
+//a client's snapshot is skipped while its update lane has more than this queued,
+//rather than piling fresh snapshots up behind stale ones
+#define NETWORK_MAX_PENDING_SNAPSHOT_BYTES 16384
+#define NETWORK_MAX_SNAPSHOT_QUEUE_TIME 50000 //microseconds
+
+//clock sync
+//each new round trip sample moves the estimates 1/NETWORK_CLOCK_SMOOTHING of the way
+#define NETWORK_CLOCK_SMOOTHING 8
+//samples whose round trip is this many times the average are ignored for the offset
+#define NETWORK_CLOCK_MAX_RTT_RATIO 2
+
+//rollback mode
+//how often the host sends its newest fully confirmed state, to catch up
+//late joiners and repair any peer that has drifted
+#define NETWORK_ROLLBACK_SYNC_INTERVAL 250000 //microseconds
+
+//checkpoint
+//the server writes its players to this file so a restarted server carries on with them
+#define NETWORK_CHECKPOINT_PATH "server_checkpoint.bin"
+#define NETWORK_CHECKPOINT_INTERVAL 100000 //microseconds
+//how long a restored player's slot is held for them to reclaim before it's let go
+#define NETWORK_CHECKPOINT_RECLAIM_TIME 30000000 //microseconds
+//how often a client that lost the server tries to reach it again
+#define NETWORK_RECONNECT_INTERVAL 1000000 //microseconds
+
+//admission control
+//new connections wait in a queue and are let in by a token bucket, so a join storm
+//(say a restart with everyone waiting) is spread over many ticks instead of stalling one
+#define NETWORK_JOIN_RATE 20.0f //joins per second, --join-rate
+#define NETWORK_JOIN_BURST 10 //joins let in at once after a quiet spell, --join-burst
+#define NETWORK_MAX_JOINS_PER_TICK 4 //--joins-per-tick
+//waiting connections are accepted so they don't time out and can be told their place,
+//accepting is cheap but still capped
+#define NETWORK_MAX_ACCEPTS_PER_TICK 32
+#define NETWORK_JOIN_QUEUE_UPDATE_INTERVAL 1000000 //microseconds between queue position updates
+
+//session resume
+//a player whose connection drops keeps their slot this long, so a brief outage costs a resume instead of a rejoin
+#define NETWORK_RESUME_GRACE_TIME 10000000 //microseconds
+//ticks of world history kept to work out what a resuming player has already seen
+//needs to cover the heartbeat plus a round trip, as that's how stale their ack can be
+#define NETWORK_WORLD_HISTORY 128
+
+//server-authoritative movement, see movement.h
+//a player the server moves is told at most this often, so one pressed up against something isn't sent a stream of them
+#define NETWORK_CORRECTION_INTERVAL 100000 //microseconds
+
+#include "alloc_audit.h"
+#include "async_log.h"
+#include "checkpoint.h"
+#include "entity_decode.h"
+#include "game_events.h"
+#include "metrics.h"
+#include "movement.h"
+#include "net_conditions.h"
+#include "net_protocol.h"
+#include "rjobs.h"
+#include "rollback.h"
+#include "snapshot_codec.h"
+#include "timer_wheel.h"
+#include "zone_cluster.h"
+
+static_assert(NETWORK_INPUT_RIGHT == ROLLBACK_INPUT_RIGHT && NETWORK_INPUT_LEFT == ROLLBACK_INPUT_LEFT
+	&& NETWORK_INPUT_UP == ROLLBACK_INPUT_UP && NETWORK_INPUT_DOWN == ROLLBACK_INPUT_DOWN,
+	"networking.h input bits must match rollback.h");
+
+//DEFLATE helpers from raylib (rcore.c)
+//raylib.h can't be included here as it clashes with windows.h, so just declare what we use
+extern "C"
+{
+	unsigned char* CompressData(const unsigned char* data, int dataSize, int* compDataSize);
+	void MemFree(void* ptr);
+	//the inflater behind DecompressData (external/sinfl.h), which allocates MAX_DECOMPRESSION_SIZE and logs every call
+	//so we inflate straight into a buffer of the size the message claims instead
+	int sinflate(void* out, int cap, const void* in, int size);
+}
 
 /////////////////////////////////////////////////////////////////////////////
 //
@@ -65,6 +150,21 @@ const int DeserializeInt(const char* inChars)
 	return DeserializeInt(inChars, 0);
 }
 
+//takes in a 64 bit int and returns it in 8 chars
+void SerializeInt64(const int64 inInt, char* outChars)
+{
+	SerializeInt((int)(inInt & 0xFFFFFFFF), outChars);
+	SerializeInt((int)(inInt >> 32), outChars + 4);
+}
+
+//takes in 8 chars and returns the 64 bit int
+int64 DeserializeInt64(const char* inChars)
+{
+	uint64 low = (uint32)DeserializeInt(inChars, 0);
+	uint64 high = (uint32)DeserializeInt(inChars, 4);
+	return (int64)(low | (high << 32));
+}
+
 
 
 //takes in the data packet struct and returns a collection of chars
@@ -89,6 +189,27 @@ void SerializeDataPacket(const DataPacket& inPacket, char* outPacket)
 	outPacket[7] = tempChars[2];
 	outPacket[8] = tempChars[3];
 
+	//set velX
+	SerializeInt(inPacket.velX, tempChars);
+	outPacket[9] = tempChars[0];
+	outPacket[10] = tempChars[1];
+	outPacket[11] = tempChars[2];
+	outPacket[12] = tempChars[3];
+
+	//set velY
+	SerializeInt(inPacket.velY, tempChars);
+	outPacket[13] = tempChars[0];
+	outPacket[14] = tempChars[1];
+	outPacket[15] = tempChars[2];
+	outPacket[16] = tempChars[3];
+
+}
+
+//writes the message header to the start of a message buffer
+void WriteMessageHeader(MessageType type, char* outMessage)
+{
+	outMessage[0] = (char)type;
+	outMessage[1] = (char)NETWORK_PROTOCOL_VERSION;
 }
 
 DataPacket DeserializeDataPacket(const char* inPacket)
@@ -104,6 +225,12 @@ DataPacket DeserializeDataPacket(const char* inPacket)
 	//set posY
 	outPacket.posY = DeserializeInt(inPacket, 5);
 
+	//set velX
+	outPacket.velX = DeserializeInt(inPacket, 9);
+
+	//set velY
+	outPacket.velY = DeserializeInt(inPacket, 13);
+
 	return outPacket;
 }
 
@@ -117,6 +244,15 @@ DataPacket DeserializeDataPacket(const char* inPacket)
 //network packet data
 int myID = -1;
 DataPacket myPacket;
+
+//session token the server gave us with our ID, presented to take our slot back after losing the server
+uint64 sessionToken = 0;
+uint64 resumeToken = 0; //the token from the connection we lost, 0 once it's been sent
+bool bServerConnected = false; //nothing is sent until the connection is up, so a resume always goes first
+int joinQueuePosition = 0; //where we are in the server's join queue, 0 once we're in
+//where the server last put us, waiting for PollPositionCorrection
+Vector2Int correctedPosition = { 0, 0 };
+bool bPositionCorrected = false;
 //sends data to the server regarding player ID and position
 void UpdatePacketPosition(int posX, int posY)
 {
@@ -126,7 +262,305 @@ void UpdatePacketPosition(int posX, int posY)
 	myPacket.posX = posX;
 	myPacket.posY = posY;
 }
-std::map<int, Vector2Int> clientPositions;
+
+//dead reckoning state of the local player
+Vector2Int lastFramePosition = { 0, 0 };
+SteamNetworkingMicroseconds lastFrameTime = 0;
+DataPacket lastSentPacket;
+SteamNetworkingMicroseconds lastSentTime = 0;
+
+EntityMap clientPositions;
+
+//scratch for unpacking snapshots, kept around so its arrays are only allocated once
+EntityBlock decodedEntities;
+
+//sequence number of the newest snapshot we've applied
+uint32 lastSnapshotSequence = 0;
+
+//clock sync
+//clients estimate the server's clock from the timestamps echoed back in each snapshot
+bool clockSynced = false;
+SteamNetworkingMicroseconds serverClockOffset = 0; //server time - local time
+SteamNetworkingMicroseconds smoothedRoundTrip = 0;
+
+//NTP style update from one round trip
+//clientSendTime and receivedTime are local, serverTime is when the server sent its reply
+//and serverHoldTime is how long the server sat on our message before replying
+void AddClockSample(SteamNetworkingMicroseconds clientSendTime, SteamNetworkingMicroseconds serverTime,
+	SteamNetworkingMicroseconds serverHoldTime, SteamNetworkingMicroseconds receivedTime)
+{
+	SteamNetworkingMicroseconds roundTrip = (receivedTime - clientSendTime) - serverHoldTime;
+	if (roundTrip < 0)
+	{
+		return;
+	}
+
+	//assume the trip back took half the round trip
+	SteamNetworkingMicroseconds offset = serverTime + roundTrip / 2 - receivedTime;
+
+	if (!clockSynced)
+	{
+		serverClockOffset = offset;
+		smoothedRoundTrip = roundTrip;
+		clockSynced = true;
+		return;
+	}
+
+	smoothedRoundTrip += (roundTrip - smoothedRoundTrip) / NETWORK_CLOCK_SMOOTHING;
+
+	//a slow trip was probably queued somewhere, so its halfway guess is off
+	if (roundTrip <= smoothedRoundTrip * NETWORK_CLOCK_MAX_RTT_RATIO)
+	{
+		serverClockOffset += (offset - serverClockOffset) / NETWORK_CLOCK_SMOOTHING;
+	}
+}
+
+Vector2Int ExtrapolatePosition(const RemoteEntity& entity, SteamNetworkingMicroseconds now)
+{
+	SteamNetworkingMicroseconds elapsed = now - entity.updateTime;
+	elapsed = std::max(elapsed, (SteamNetworkingMicroseconds)0);
+	elapsed = std::min(elapsed, (SteamNetworkingMicroseconds)NETWORK_MAX_EXTRAPOLATION);
+
+	Vector2Int position;
+	position.x = entity.position.x + (int)(entity.velocity.x * elapsed / 1000000);
+	position.y = entity.position.y + (int)(entity.velocity.y * elapsed / 1000000);
+	return position;
+}
+
+//works out the local player's velocity from how far it moved since last frame
+void UpdatePacketVelocity(SteamNetworkingMicroseconds now)
+{
+	SteamNetworkingMicroseconds frameTime = now - lastFrameTime;
+	if (lastFrameTime != 0 && frameTime > 0)
+	{
+		myPacket.velX = (int)((int64)(myPacket.posX - lastFramePosition.x) * 1000000 / frameTime);
+		myPacket.velY = (int)((int64)(myPacket.posY - lastFramePosition.y) * 1000000 / frameTime);
+	}
+
+	lastFramePosition = { myPacket.posX, myPacket.posY };
+	lastFrameTime = now;
+}
+
+//only worth sending if the others would now be extrapolating us to the wrong place,
+//or if we've been quiet for longer than the heartbeat
+bool ShouldSendPacket(SteamNetworkingMicroseconds now)
+{
+	if (lastSentTime == 0 || now - lastSentTime >= NETWORK_HEARTBEAT_INTERVAL || lastSentPacket.id != myPacket.id)
+	{
+		return true;
+	}
+
+	RemoteEntity sentState = { { lastSentPacket.posX, lastSentPacket.posY }, { lastSentPacket.velX, lastSentPacket.velY }, lastSentTime };
+	Vector2Int predicted = ExtrapolatePosition(sentState, now);
+
+	return abs(predicted.x - myPacket.posX) > NETWORK_DEAD_RECKON_THRESHOLD
+		|| abs(predicted.y - myPacket.posY) > NETWORK_DEAD_RECKON_THRESHOLD;
+}
+
+//every known position as it should be by now
+//clients only send when they change course, so this is where the others should see them
+void GatherWorldEntities(SteamNetworkingMicroseconds now, std::vector<DataPacket>& outEntities)
+{
+	for (auto& clientPos : clientPositions)
+	{
+		Vector2Int position = ExtrapolatePosition(clientPos.second, now);
+
+		DataPacket curClientPacket;
+		curClientPacket.id = clientPos.first;
+		curClientPacket.posX = position.x;
+		curClientPacket.posY = position.y;
+		curClientPacket.velX = clientPos.second.velocity.x;
+		curClientPacket.velY = clientPos.second.velocity.y;
+		outEntities.push_back(curClientPacket);
+	}
+}
+
+//appends [count:4][count * DataPacket]
+static void SerializeEntityList(const std::vector<DataPacket>& entities, std::vector<char>& outData)
+{
+	size_t offset = outData.size();
+	outData.resize(offset + 4 + entities.size() * NETWORK_PACKET_SIZE);
+	SerializeInt((int)entities.size(), outData.data() + offset);
+
+	offset += 4;
+	for (const DataPacket& entity : entities)
+	{
+		SerializeDataPacket(entity, outData.data() + offset);
+		offset += NETWORK_PACKET_SIZE;
+	}
+}
+
+//wraps raw data up as a compressed message
+//on the wire: [header][uncompressed size:4][method:1][compressed data]
+//raw data must start with an entity list to be packed with the dictionary, deflate is used if it can't be
+static std::vector<char> BuildCompressedMessage(MessageType type, const std::vector<char>& rawData, bool bUseDictionary)
+{
+	std::vector<char> message(NETWORK_HEADER_SIZE + 5);
+	WriteMessageHeader(type, message.data());
+	SerializeInt((int)rawData.size(), message.data() + NETWORK_HEADER_SIZE);
+
+	if (bUseDictionary && snapshotCodec.Encode(rawData.data(), (int)rawData.size(), 4, message))
+	{
+		message[NETWORK_HEADER_SIZE + 4] = NETWORK_COMPRESSION_DICTIONARY;
+		return message;
+	}
+
+	message[NETWORK_HEADER_SIZE + 4] = NETWORK_COMPRESSION_DEFLATE;
+	int compressedSize = 0;
+	unsigned char* compressed = CompressData((const unsigned char*)rawData.data(), (int)rawData.size(), &compressedSize);
+	if (compressed != nullptr)
+	{
+		message.insert(message.end(), (char*)compressed, (char*)compressed + compressedSize);
+		MemFree(compressed);
+	}
+
+	return message;
+}
+
+//unpacks a compressed message (without its header) into outRaw
+//returns false if it doesn't decompress to the size it claims
+static bool DecompressMessage(const char* payload, int payloadSize, std::vector<char>& outRaw)
+{
+	if (payloadSize < 5)
+	{
+		return false;
+	}
+
+	//nothing we send unpacks to more than a full entity list plus as many removed ids,
+	//and the size comes off the wire, so don't let it ask for more than that
+	int expectedSize = DeserializeInt(payload);
+	if (expectedSize < 0 || expectedSize > 8 + NETWORK_MAX_ENTITIES * (NETWORK_PACKET_SIZE + 1))
+	{
+		return false;
+	}
+	const char* data = payload + 5;
+	int dataSize = payloadSize - 5;
+	switch (payload[4])
+	{
+	case NETWORK_COMPRESSION_DICTIONARY:
+		return snapshotCodec.Decode(data, dataSize, expectedSize, outRaw);
+	case NETWORK_COMPRESSION_DEFLATE:
+	{
+		//one byte over, so a message that inflates to more than it claims doesn't pass as the right size
+		outRaw.resize(expectedSize + 1);
+		int rawSize = sinflate(outRaw.data(), (int)outRaw.size(), data, dataSize);
+		if (rawSize != expectedSize)
+		{
+			outRaw.clear();
+			return false;
+		}
+		outRaw.resize(rawSize);
+		return true;
+	}
+	default:
+		return false;
+	}
+}
+
+//packs a whole world into one compressed world baseline message
+//before compression: [count:4][count * DataPacket]
+std::vector<char> BuildWorldBaseline(const std::vector<DataPacket>& entities, bool bUseDictionary)
+{
+	std::vector<char> rawBaseline;
+	SerializeEntityList(entities, rawBaseline);
+	return BuildCompressedMessage(MESSAGE_BASELINE, rawBaseline, bUseDictionary);
+}
+
+//packs only what a resuming player needs to catch up from the world they last acked
+//anything moving is sent as their copy of it has been extrapolating out of date, as is anything new
+//before compression: [count:4][count * DataPacket][removed count:4][removed count * id:1]
+std::vector<char> BuildWorldDelta(const std::vector<DataPacket>& ackedWorld, const std::vector<DataPacket>& world, bool bUseDictionary)
+{
+	auto findEntity = [](const std::vector<DataPacket>& entities, char id) {
+		return std::find_if(entities.begin(), entities.end(), [id](const DataPacket& entity) {
+			return entity.id == id;
+			});
+	};
+
+	std::vector<DataPacket> changed;
+	for (const DataPacket& entity : world)
+	{
+		auto itAcked = findEntity(ackedWorld, entity.id);
+		if (itAcked == ackedWorld.end() || entity.velX != 0 || entity.velY != 0
+			|| itAcked->posX != entity.posX || itAcked->posY != entity.posY
+			|| itAcked->velX != entity.velX || itAcked->velY != entity.velY)
+		{
+			changed.push_back(entity);
+		}
+	}
+
+	std::vector<char> removed;
+	for (const DataPacket& entity : ackedWorld)
+	{
+		if (findEntity(world, entity.id) == world.end())
+		{
+			removed.push_back(entity.id);
+		}
+	}
+
+	std::vector<char> rawDelta;
+	SerializeEntityList(changed, rawDelta);
+	rawDelta.resize(rawDelta.size() + 4);
+	SerializeInt((int)removed.size(), rawDelta.data() + rawDelta.size() - 4);
+	rawDelta.insert(rawDelta.end(), removed.begin(), removed.end());
+
+	return BuildCompressedMessage(MESSAGE_BASELINE_DELTA, rawDelta, bUseDictionary);
+}
+
+//reads [count:4][count * DataPacket] into clientPositions
+//returns how many bytes it took up, or -1 if there isn't room for what it claims
+static int ApplyEntityList(const char* data, int dataSize)
+{
+	int count = (dataSize >= 4) ? DeserializeInt(data) : -1;
+	//bounded by division, a hostile count would overflow the multiplication
+	if (count < 0 || count > (dataSize - 4) / NETWORK_PACKET_SIZE)
+	{
+		return -1;
+	}
+
+	DecodeEntityBlock(data + 4, count, decodedEntities);
+
+	SteamNetworkingMicroseconds now = SteamNetworkingUtils()->GetLocalTimestamp();
+	for (int i = 0; i < count; i++)
+	{
+		clientPositions[decodedEntities.ids[i]] = { { decodedEntities.posX[i], decodedEntities.posY[i] },
+			{ decodedEntities.velX[i], decodedEntities.velY[i] }, now };
+	}
+	return 4 + count * NETWORK_PACKET_SIZE;
+}
+
+//unpacks a world baseline (without its header) into clientPositions
+//returns false if the message is malformed
+bool ApplyWorldBaseline(const char* baseline, int baselineSize)
+{
+	std::vector<char> raw;
+	return DecompressMessage(baseline, baselineSize, raw) && ApplyEntityList(raw.data(), (int)raw.size()) == (int)raw.size();
+}
+
+//unpacks a world delta (without its header) on top of clientPositions
+//returns false if the message is malformed
+bool ApplyWorldDelta(const char* delta, int deltaSize)
+{
+	std::vector<char> raw;
+	if (!DecompressMessage(delta, deltaSize, raw))
+	{
+		return false;
+	}
+
+	int rawSize = (int)raw.size();
+	int offset = ApplyEntityList(raw.data(), rawSize);
+	int removedCount = (offset >= 0 && rawSize >= offset + 4) ? DeserializeInt(raw.data(), offset) : -1;
+	if (removedCount < 0 || rawSize != offset + 4 + removedCount)
+	{
+		return false;
+	}
+
+	for (int i = 0; i < removedCount; i++)
+	{
+		clientPositions.erase(raw[offset + 4 + i]);
+	}
+	return true;
+}
 
 
 //forward decl
@@ -139,150 +573,907 @@ NetworkServer* myServer = nullptr;
 NetworkServer* s_pCallbackInstance;
 NetworkClient* s_pClientCallbackInstance;
 
+//a client connected to the server
+struct ClientConnection
+{
+	HSteamNetConnection conn;
+	char id;
+	uint64 sessionToken; //lets them reclaim this ID if the server restarts
+	uint32 snapshotSequence; //sequence number of the last snapshot sent to them
+	SteamNetworkingMicroseconds lastClientTime; //client send time of their newest packet, echoed back for clock sync
+	SteamNetworkingMicroseconds lastClientTimeReceived; //when we got that packet
+	SteamNetworkingMicroseconds lastEchoedClientTime; //the client time we last echoed back to them
+	bool bSubscriber; //a spectator relay, it only watches so it isn't part of the rollback session
+	bool bBackedUp; //their send queue is over the limit, so this tick's snapshot is skipped
+	uint32 droppedSnapshots; //snapshots skipped for them so far
+	bool bWelcomed; //sent their ID and the world, held back until their first message in case it's a resume
+	bool bPackSnapshots; //they have our snapshot dictionary, so snapshots and baselines are packed with it
+	GameEventBatch events; //game events for them this tick, sent as one message when it ends
+	uint32 ackedSnapshot; //newest snapshot they've told us they applied
+	uint32 snapshotTicks[NETWORK_WORLD_HISTORY]; //world tick each recent snapshot was built from, by sequence
+	SteamNetworkingMicroseconds lastCorrectionTime; //when we last told them we'd moved them
+};
+
 //network session information
-SteamNetworkingMicroseconds g_logTimeZero;
 ISteamNetworkingSockets* m_pInterface;
 HSteamNetPollGroup m_hPollGroup;
-std::vector< HSteamNetConnection> m_Clients;
+std::vector<ClientConnection> m_Clients;
 HSteamNetConnection m_hConnection;
 HSteamListenSocket m_hListenSock;
 NetworkStatus networkStatus = INACTIVE;
+NetworkMode networkMode = NETWORK_MODE_STATE_SYNC;
 
+//rollback mode session, the host is always player 0 and clients play as their ID
+RollbackSession rollbackSession;
+unsigned char pendingRollbackInput = 0;
+SteamNetworkingMicroseconds lastRollbackSyncTime = 0;
 
-// kills the session
-static void NukeProcess(int rc)
+//set when this server is the front of a zone cluster, the zones own the world and we just route to them
+ZoneFront* zoneFront = nullptr;
+
+//snapshots skipped across every client because of backpressure
+uint32 droppedSnapshots = 0;
+
+//ticks since a connection last came or went, see CheckAllocationAudit
+int settledTicks = 0;
+
+//--capture-snapshots, every tick's snapshot payload is appended here as [size:4][payload] to train dictionaries from
+FILE* snapshotCaptureFile = nullptr;
+
+//see RegisterNetworkMetrics, nullptr until the library is up, which the metrics calls ignore
+Metric* metricMessagesReceived = nullptr;
+Metric* metricMessagesSent = nullptr;
+Metric* metricBytesReceived = nullptr;
+Metric* metricBytesSent = nullptr;
+Metric* metricSnapshotBytes = nullptr;
+Metric* metricTickSeconds = nullptr;
+Metric* metricConnections = nullptr;
+Metric* metricGameEvents = nullptr;
+
+//server, anything due at some point rather than every tick, advanced at the start of each tick
+TimerWheel serverTimers;
+
+//a connection waiting in the join queue
+struct PendingJoin
 {
-#ifdef _WIN32
-	ExitProcess(rc);
-#else
-	(void)rc; // Unused formal parameter
-	kill(getpid(), SIGKILL);
-#endif
+	HSteamNetConnection conn;
+	uint64 joinNumber; //counts up, so the queue is always in order of it
+	bool bAccepted; //accepted but not yet in the poll group, anything they send waits on the connection
+	int lastSentPosition; //queue position we last told them, 0 if we haven't yet
+};
+
+std::deque<PendingJoin> pendingJoins;
+uint64 nextJoinNumber = 1;
+float joinRate = NETWORK_JOIN_RATE;
+int joinBurst = NETWORK_JOIN_BURST;
+int joinsPerTick = NETWORK_MAX_JOINS_PER_TICK;
+float joinTokens = NETWORK_JOIN_BURST;
+SteamNetworkingMicroseconds lastJoinRefillTime = 0;
+
+std::deque<PendingJoin>::iterator FindPendingJoin(HSteamNetConnection conn)
+{
+	return std::find_if(pendingJoins.begin(), pendingJoins.end(), [conn](const PendingJoin& join) {
+		return join.conn == conn;
+		});
 }
 
-//outputs information to the console
-//kills the session if the type is a bug
-static void DebugOutput(ESteamNetworkingSocketsDebugOutputType eType, const char* pszMsg)
+//tells a join where they are in the queue, if it's changed since last time
+void SendJoinQueuePosition(PendingJoin& join, int position)
 {
-	SteamNetworkingMicroseconds time = SteamNetworkingUtils()->GetLocalTimestamp() - g_logTimeZero;
-	printf("%10.6f %s\n", time * 1e-6, pszMsg);
-	fflush(stdout);
-	if (eType == k_ESteamNetworkingSocketsDebugOutputType_Bug)
+	if (position == join.lastSentPosition)
 	{
-		fflush(stdout);
-		fflush(stderr);
-		NukeProcess(1);
+		return;
 	}
+
+	char message[NETWORK_HEADER_SIZE + 4];
+	WriteMessageHeader(MESSAGE_JOIN_QUEUE, message);
+	SerializeInt(position, message + NETWORK_HEADER_SIZE);
+	SendNetworkMessage(join.conn, message, sizeof(message), k_nSteamNetworkingSend_Reliable);
+	join.lastSentPosition = position;
 }
 
-//debugs an error and kills the session
-static void FatalError(const char* fmt, ...)
+//fires every NETWORK_JOIN_QUEUE_UPDATE_INTERVAL for each accepted join until they're in or gone
+void UpdateJoinQueuePosition(uint64 joinNumber, SteamNetworkingMicroseconds now)
 {
-	char text[2048];
-	va_list ap;
-	va_start(ap, fmt);
-	vsprintf(text, fmt, ap);
-	va_end(ap);
-	char* nl = strchr(text, '\0') - 1;
-	if (nl >= text && *nl == '\n')
-		*nl = '\0';
-	DebugOutput(k_ESteamNetworkingSocketsDebugOutputType_Bug, text);
+	auto itJoin = std::lower_bound(pendingJoins.begin(), pendingJoins.end(), joinNumber, [](const PendingJoin& join, uint64 number) {
+		return join.joinNumber < number;
+		});
+	if (itJoin == pendingJoins.end() || itJoin->joinNumber != joinNumber)
+	{
+		return;
+	}
+
+	SendJoinQueuePosition(*itJoin, (int)(itJoin - pendingJoins.begin()) + 1);
+	serverTimers.Schedule(now + NETWORK_JOIN_QUEUE_UPDATE_INTERVAL, UpdateJoinQueuePosition, joinNumber);
 }
 
-//prints a string to the console
-static void Printf(const char* fmt, ...)
+//finds a connected client by their connection handle
+std::vector<ClientConnection>::iterator FindClient(HSteamNetConnection conn)
 {
-	char text[2048];
-	va_list ap;
-	va_start(ap, fmt);
-	vsprintf(text, fmt, ap);
-	va_end(ap);
-	char* nl = strchr(text, '\0') - 1;
-	if (nl >= text && *nl == '\n')
-		*nl = '\0';
-	DebugOutput(k_ESteamNetworkingSocketsDebugOutputType_Msg, text);
+	return std::find_if(m_Clients.begin(), m_Clients.end(), [conn](const ClientConnection& client) {
+		return client.conn == conn;
+		});
 }
 
-// trim from start (in place)
-static inline void ltrim(std::string& s) {
-	s.erase(s.begin(), std::find_if(s.begin(), s.end(), [](int ch) {
-		return !std::isspace(ch);
-		}));
+/////////////////////////////////////////////////////////////////////////////
+//
+// Game events
+//
+/////////////////////////////////////////////////////////////////////////////
+
+//client, events for the server this tick
+GameEventBatch outgoingEvents;
+//events from other players waiting for PollGameEvent
+GameEventQueue receivedEvents;
+
+//adds an encoded event to a connection's batch, sending the batch early if it's full
+static void QueueGameEvent(HSteamNetConnection conn, GameEventBatch& batch, const char* encoded, int size)
+{
+	if (!batch.Append(encoded, size))
+	{
+		SteamNetworkingMessage_t* pMsg = batch.Flush(conn);
+		SendNetworkMessages(1, &pMsg, nullptr);
+		batch.Append(encoded, size);
+	}
+	AddCounter(metricGameEvents, 1);
 }
 
-// trim from end (in place)
-static inline void rtrim(std::string& s) {
-	s.erase(std::find_if(s.rbegin(), s.rend(), [](int ch) {
-		return !std::isspace(ch);
-		}).base(), s.end());
+//server, queues an event for every player except the one it came from
+static void BroadcastGameEvent(const GameEvent& event, HSteamNetConnection except)
+{
+	char encoded[GAME_EVENT_MAX_ENCODED_SIZE];
+	int size = EncodeGameEvent(event, encoded);
+	for (ClientConnection& client : m_Clients)
+	{
+		//relays only forward snapshots
+		if (client.conn != except && !client.bSubscriber)
+		{
+			QueueGameEvent(client.conn, client.events, encoded, size);
+		}
+	}
 }
 
 /////////////////////////////////////////////////////////////////////////////
 //
-// NetworkServer
+// Checkpoint
 //
 /////////////////////////////////////////////////////////////////////////////
 
-class NetworkServer
+//the players' entities live in a memory-mapped file as well as clientPositions
+//only state sync servers checkpoint, a cluster front's world belongs to its zones
+WorldCheckpoint worldCheckpoint;
+SteamNetworkingMicroseconds lastCheckpointTime = 0;
+bool bCheckpointDisabled = false; //--bench, every run starts from the same empty world
+
+//a slot held until its player comes back with the token
+//either restored from the checkpoint or left by a connection that dropped
+struct ReservedSlot
 {
-public:
-	void Run(uint16 nPort)
-	{
-		// Select instance to use.  For now we'll always use the default.
-		// But we could use SteamGameServerNetworkingSockets() on Steam.
-		m_pInterface = SteamNetworkingSockets();
+	char id;
+	uint64 sessionToken;
+	TimerHandle expireTimer; //lets the slot go if they don't make it back in time
+	bool bHasAckedWorld; //we know what they'd seen, so a resume only needs what's changed since
+	std::vector<DataPacket> ackedWorld;
+};
+std::vector<ReservedSlot> reservedSlots;
 
-		// Start listening
-		SteamNetworkingIPAddr serverLocalAddr;
-		serverLocalAddr.Clear();
-		serverLocalAddr.m_port = nPort;
-		SteamNetworkingConfigValue_t opt;
-		opt.SetPtr(k_ESteamNetworkingConfig_Callback_ConnectionStatusChanged, (void*)SteamNetConnectionStatusChangedCallback);
-		m_hListenSock = m_pInterface->CreateListenSocketIP(serverLocalAddr, 1, &opt);
-		if (m_hListenSock == k_HSteamListenSocket_Invalid)
-			FatalError("Failed to listen on port %d", nPort);
-		m_hPollGroup = m_pInterface->CreatePollGroup();
-		if (m_hPollGroup == k_HSteamNetPollGroup_Invalid)
-			FatalError("Failed to listen on port %d", nPort);
-		Printf("Server listening on port %d\n", nPort);
+std::mt19937_64 sessionTokenGenerator{ std::random_device{}() };
 
-		networkStatus = SERVER_ACTIVE;
+//server, the movement step and what it's working on, kept between ticks
+MovementStep movementStep;
+std::vector<MovementBody> movementBodies;
+//players the server has moved since they were last told, by ID
+bool pendingCorrections[NETWORK_MAX_ENTITIES] = {};
+
+//server, bots moved around as if they were players, they hold the top simulatedPlayers IDs
+int simulatedPlayers = 0;
+//seeded the same every run, so every benchmark run moves them the same way
+std::mt19937 simulatedPlayerRandom(1);
+
+//the lowest ID a bot has, real players get the ones below it
+int FirstSimulatedPlayerID()
+{
+	return NETWORK_MAX_ENTITIES - simulatedPlayers;
+}
 
+//0 means no session, so it's never handed out
+uint64 GenerateSessionToken()
+{
+	uint64 token = 0;
+	while (token == 0)
+	{
+		token = sessionTokenGenerator();
 	}
-private:
-	static void SteamNetConnectionStatusChangedCallback(SteamNetConnectionStatusChangedCallback_t* pInfo)
+	return token;
+}
+
+//lowest ID nobody is using or has reserved, the host is always 0
+//returns -1 if the server is full
+int AllocateClientID()
+{
+	for (int id = 1; id < FirstSimulatedPlayerID(); id++)
 	{
-		s_pCallbackInstance->OnSteamNetConnectionStatusChanged(pInfo);
+		bool bTaken = std::any_of(m_Clients.begin(), m_Clients.end(), [id](const ClientConnection& client) {
+			return client.id == id;
+			})
+			|| std::any_of(reservedSlots.begin(), reservedSlots.end(), [id](const ReservedSlot& reserved) {
+			return reserved.id == id;
+			});
+
+		if (!bTaken)
+		{
+			return id;
+		}
 	}
-public:
-	void SendStringToClient(HSteamNetConnection conn, const char* str)
+	return -1;
+}
+
+//lets go of someone who didn't make it back in time
+void ExpireReservedSlot(uint64 sessionToken, SteamNetworkingMicroseconds now)
+{
+	auto itReserved = std::find_if(reservedSlots.begin(), reservedSlots.end(), [sessionToken](const ReservedSlot& reserved) {
+		return reserved.sessionToken == sessionToken;
+		});
+	if (itReserved == reservedSlots.end())
 	{
-		m_pInterface->SendMessageToConnection(conn, str, (uint32)strlen(str), k_nSteamNetworkingSend_Reliable, nullptr);
+		return;
 	}
-private:
-	void OnSteamNetConnectionStatusChanged(SteamNetConnectionStatusChangedCallback_t* pInfo)
+
+	Printf("Client %d didn't come back, freeing their slot", itReserved->id);
+	clientPositions.erase(itReserved->id);
+	reservedSlots.erase(itReserved);
+}
+
+//maps the checkpoint and puts back whoever was in it
+//they stand still where they were until they reclaim their slot or it runs out
+void RestoreWorldCheckpoint()
+{
+	if (!worldCheckpoint.Open(NETWORK_CHECKPOINT_PATH))
 	{
-		char temp[1024];
+		Printf("Failed to map %s, running without a checkpoint", NETWORK_CHECKPOINT_PATH);
+		return;
+	}
 
-		// What's the state of the connection?
-		switch (pInfo->m_info.m_eState)
+	SteamNetworkingMicroseconds now = SteamNetworkingUtils()->GetLocalTimestamp();
+	for (int id = 1; id < FirstSimulatedPlayerID(); id++)
+	{
+		const CheckpointSlot* pSlot = worldCheckpoint.GetSlot(id);
+		if (pSlot == nullptr)
 		{
-		case k_ESteamNetworkingConnectionState_None:
-			// NOTE: We will get callbacks here when we destroy connections.  You can ignore these.
-			break;
+			continue;
+		}
 
-		case k_ESteamNetworkingConnectionState_ClosedByPeer:
-		case k_ESteamNetworkingConnectionState_ProblemDetectedLocally:
-		{
-			// Ignore if they were not previously connected.  (If they disconnected
-			// before we accepted the connection.)
-			if (pInfo->m_eOldState == k_ESteamNetworkingConnectionState_Connected)
-			{
+		clientPositions[id] = { { pSlot->posX, pSlot->posY }, { 0, 0 }, now };
+		TimerHandle expireTimer = serverTimers.Schedule(now + NETWORK_CHECKPOINT_RECLAIM_TIME, ExpireReservedSlot, pSlot->sessionToken);
+		reservedSlots.push_back({ (char)id, pSlot->sessionToken, expireTimer, false, {} });
+	}
 
-				// Locate the client.  Note that it should have been found, because this
+	if (!reservedSlots.empty())
+	{
+		Printf("Restored %d players from %s", (int)reservedSlots.size(), NETWORK_CHECKPOINT_PATH);
+	}
+}
+
+//moves the bots on at player speed, bouncing them off the edges of the world
+//they're written to clientPositions like any player's update, so everything downstream treats them the same
+void UpdateSimulatedPlayers(SteamNetworkingMicroseconds now)
+{
+	const int maxX = NETWORK_WORLD_WIDTH - NETWORK_PLAYER_SIZE;
+	const int maxY = NETWORK_WORLD_HEIGHT - NETWORK_PLAYER_SIZE;
+	std::uniform_int_distribution<int> anyX(0, maxX);
+	std::uniform_int_distribution<int> anyY(0, maxY);
+	std::uniform_int_distribution<int> anyVelocity(-NETWORK_PLAYER_SPEED, NETWORK_PLAYER_SPEED);
+
+	for (int id = FirstSimulatedPlayerID(); id < NETWORK_MAX_ENTITIES; id++)
+	{
+		auto itEntity = clientPositions.find(id);
+		if (itEntity == clientPositions.end())
+		{
+			int x = anyX(simulatedPlayerRandom);
+			int y = anyY(simulatedPlayerRandom);
+			int velX = anyVelocity(simulatedPlayerRandom);
+			int velY = anyVelocity(simulatedPlayerRandom);
+			clientPositions[id] = { { x, y }, { velX, velY }, now };
+			continue;
+		}
+
+		RemoteEntity& entity = itEntity->second;
+		Vector2Int position = ExtrapolatePosition(entity, now);
+		if (position.x < 0 || position.x > maxX)
+		{
+			position.x = std::min(std::max(position.x, 0), maxX);
+			entity.velocity.x = -entity.velocity.x;
+		}
+		if (position.y < 0 || position.y > maxY)
+		{
+			position.y = std::min(std::max(position.y, 0), maxY);
+			entity.velocity.y = -entity.velocity.y;
+		}
+
+		//the movement step stopped them against someone or something, head off another way
+		if (entity.velocity.x == 0)
+		{
+			entity.velocity.x = anyVelocity(simulatedPlayerRandom);
+		}
+		if (entity.velocity.y == 0)
+		{
+			entity.velocity.y = anyVelocity(simulatedPlayerRandom);
+		}
+
+		entity.position = position;
+		entity.updateTime = now;
+	}
+}
+
+//pushes everyone apart and out of the obstacles, anyone it moves is stopped along that axis
+//and has a correction queued, which BuildCorrectionMessage sends them at the end of the tick
+void StepMovement(SteamNetworkingMicroseconds now)
+{
+	movementBodies.clear();
+	for (const auto& entity : clientPositions)
+	{
+		movementBodies.push_back({ entity.first, ExtrapolatePosition(entity.second, now), entity.second.velocity, false, false, false });
+	}
+
+	movementStep.Resolve(movementBodies);
+
+	for (const MovementBody& body : movementBodies)
+	{
+		if (!body.bMoved)
+		{
+			continue;
+		}
+
+		RemoteEntity& entity = clientPositions[body.id];
+		entity.position = body.position;
+		entity.velocity.x = body.bBlockedX ? 0 : entity.velocity.x;
+		entity.velocity.y = body.bBlockedY ? 0 : entity.velocity.y;
+		entity.updateTime = now;
+		pendingCorrections[body.id] = true;
+	}
+
+	//the host is us, so it goes straight to the gameplay screen
+	if (pendingCorrections[0])
+	{
+		pendingCorrections[0] = false;
+		correctedPosition = clientPositions[0].position;
+		bPositionCorrected = true;
+	}
+}
+
+//writes every player that could come back to the checkpoint
+//slots that haven't changed since last time are left alone, so mostly this writes nothing
+void SaveWorldCheckpoint(SteamNetworkingMicroseconds now)
+{
+	if (!worldCheckpoint.IsOpen() || now - lastCheckpointTime < NETWORK_CHECKPOINT_INTERVAL)
+	{
+		return;
+	}
+	lastCheckpointTime = now;
+
+	//a slot is only worth keeping if someone holds its token
+	uint64 slotTokens[CHECKPOINT_MAX_SLOTS] = {};
+	for (const ClientConnection& client : m_Clients)
+	{
+		if (client.id > 0)
+		{
+			slotTokens[(int)client.id] = client.sessionToken;
+		}
+	}
+	for (const ReservedSlot& reserved : reservedSlots)
+	{
+		slotTokens[(int)reserved.id] = reserved.sessionToken;
+	}
+
+	for (int id = 1; id < CHECKPOINT_MAX_SLOTS; id++)
+	{
+		auto itEntity = clientPositions.find(id);
+		if (slotTokens[id] == 0 || itEntity == clientPositions.end())
+		{
+			worldCheckpoint.ClearSlot(id);
+			continue;
+		}
+
+		Vector2Int position = ExtrapolatePosition(itEntity->second, now);
+
+		CheckpointSlot slot = {};
+		slot.bUsed = 1;
+		slot.posX = position.x;
+		slot.posY = position.y;
+		slot.velX = itEntity->second.velocity.x;
+		slot.velY = itEntity->second.velocity.y;
+		slot.sessionToken = slotTokens[id];
+		worldCheckpoint.WriteSlot(id, slot);
+	}
+
+	worldCheckpoint.Flush();
+}
+
+//the world as it stood for the last few ticks, the newest is what every client's snapshot is built from
+//older ticks are kept to diff against when a player resumes
+std::vector<DataPacket> worldHistory[NETWORK_WORLD_HISTORY];
+uint32 worldTick = 0;
+SteamNetworkingMicroseconds snapshotTime = 0;
+
+//keeps a dropped client's slot for them to resume, along with the world they'd last acked
+void HoldClientSlot(const ClientConnection& client)
+{
+	if (networkMode != NETWORK_MODE_STATE_SYNC || zoneFront != nullptr || client.bSubscriber || client.id <= 0)
+	{
+		return;
+	}
+
+	SteamNetworkingMicroseconds now = SteamNetworkingUtils()->GetLocalTimestamp();
+	ReservedSlot reserved = { client.id, client.sessionToken, 0, false, {} };
+
+	//only if that snapshot's world is still in the history
+	uint32 ackedTick = client.snapshotTicks[client.ackedSnapshot % NETWORK_WORLD_HISTORY];
+	if (client.ackedSnapshot != 0 && client.snapshotSequence - client.ackedSnapshot < NETWORK_WORLD_HISTORY
+		&& worldTick - ackedTick < NETWORK_WORLD_HISTORY)
+	{
+		reserved.bHasAckedWorld = true;
+		reserved.ackedWorld = worldHistory[ackedTick % NETWORK_WORLD_HISTORY];
+	}
+
+	//they stand where they were while they're away
+	auto itEntity = clientPositions.find(client.id);
+	if (itEntity != clientPositions.end())
+	{
+		itEntity->second = { ExtrapolatePosition(itEntity->second, now), { 0, 0 }, now };
+	}
+
+	Printf("Holding client %d's slot for them to resume", client.id);
+	reserved.expireTimer = serverTimers.Schedule(now + NETWORK_RESUME_GRACE_TIME, ExpireReservedSlot, client.sessionToken);
+	reservedSlots.push_back(reserved);
+}
+
+//writes a snapshot's payload, everything after the message header
+static void WriteSnapshotPayload(uint32 sequence, SteamNetworkingMicroseconds echoedClientTime, int holdTime,
+	const std::vector<DataPacket>& snapshotEntities, char* outPayload)
+{
+	SerializeInt((int)sequence, outPayload);
+	SerializeInt64(snapshotTime, outPayload + 4);
+	SerializeInt64(echoedClientTime, outPayload + 12);
+	SerializeInt(holdTime, outPayload + 20);
+	SerializeInt((int)snapshotEntities.size(), outPayload + 24);
+
+	char* record = outPayload + NETWORK_SNAPSHOT_HEADER_SIZE;
+	for (const DataPacket& entity : snapshotEntities)
+	{
+		SerializeDataPacket(entity, record);
+		record += NETWORK_PACKET_SIZE;
+	}
+}
+
+//appends this tick's snapshot to the capture, as a client with nothing to echo would get it
+static void CaptureSnapshot(const std::vector<DataPacket>& snapshotEntities)
+{
+	static std::vector<char> capture;
+	capture.resize(4 + NETWORK_SNAPSHOT_HEADER_SIZE + snapshotEntities.size() * NETWORK_PACKET_SIZE);
+	SerializeInt((int)capture.size() - 4, capture.data());
+	WriteSnapshotPayload(worldTick, 0, 0, snapshotEntities, capture.data() + 4);
+	fwrite(capture.data(), 1, capture.size(), snapshotCaptureFile);
+}
+
+//builds one client's snapshot straight into a message ready to send
+//safe to call from the job system's workers, it only touches this client's entry
+//returns nullptr if there's nothing worth sending them
+SteamNetworkingMessage_t* BuildSnapshotMessage(ClientConnection& client)
+{
+	//the next one they do get carries the whole world again, so nothing is lost
+	if (client.bBackedUp)
+	{
+		return nullptr;
+	}
+
+	//rollback mode has no state to sync, snapshots only carry clock sync replies
+	if (networkMode == NETWORK_MODE_ROLLBACK && client.lastClientTime == client.lastEchoedClientTime)
+	{
+		return nullptr;
+	}
+	client.lastEchoedClientTime = client.lastClientTime;
+
+	const std::vector<DataPacket>& snapshotEntities = worldHistory[worldTick % NETWORK_WORLD_HISTORY];
+	int count = (int)snapshotEntities.size();
+	int size = NETWORK_HEADER_SIZE + NETWORK_SNAPSHOT_HEADER_SIZE + count * NETWORK_PACKET_SIZE;
+
+	PauseAllocationAudit(); //message buffers are the library's business
+	SteamNetworkingMessage_t* snapshotMsg = SteamNetworkingUtils()->AllocateMessage(size);
+	ResumeAllocationAudit();
+	char* data = (char*)snapshotMsg->m_pData;
+	//echo their newest timestamp so they can work out the round trip and our clock
+	int holdTime = 0;
+	if (client.lastClientTime != 0)
+	{
+		holdTime = (int)(snapshotTime - client.lastClientTimeReceived);
+	}
+
+	client.snapshotSequence++;
+	client.snapshotTicks[client.snapshotSequence % NETWORK_WORLD_HISTORY] = worldTick;
+	WriteMessageHeader(MESSAGE_SNAPSHOT, data);
+	WriteSnapshotPayload(client.snapshotSequence, client.lastClientTime, holdTime, snapshotEntities, data + NETWORK_HEADER_SIZE);
+
+	//packed: [raw size:4][record offset:1][rANS stream], only sent if it's actually smaller
+	if (client.bPackSnapshots)
+	{
+		thread_local std::vector<char> packed;
+		packed.clear();
+		if (snapshotCodec.Encode(data + NETWORK_HEADER_SIZE, size - NETWORK_HEADER_SIZE, NETWORK_SNAPSHOT_HEADER_SIZE, packed)
+			&& NETWORK_HEADER_SIZE + 4 + (int)packed.size() < size)
+		{
+			int packedSize = NETWORK_HEADER_SIZE + 4 + (int)packed.size();
+			PauseAllocationAudit();
+			SteamNetworkingMessage_t* packedMsg = SteamNetworkingUtils()->AllocateMessage(packedSize);
+			ResumeAllocationAudit();
+			char* packedData = (char*)packedMsg->m_pData;
+			WriteMessageHeader(MESSAGE_SNAPSHOT_PACKED, packedData);
+			SerializeInt(size - NETWORK_HEADER_SIZE, packedData + NETWORK_HEADER_SIZE);
+			memcpy(packedData + NETWORK_HEADER_SIZE + 4, packed.data(), packed.size());
+
+			snapshotMsg->Release();
+			snapshotMsg = packedMsg;
+			size = packedSize;
+		}
+	}
+	ObserveHistogram(metricSnapshotBytes, size);
+
+	snapshotMsg->m_conn = client.conn;
+	snapshotMsg->m_nFlags = k_nSteamNetworkingSend_Unreliable;
+	snapshotMsg->m_idxLane = NETWORK_LANE_UPDATES;
+	return snapshotMsg;
+}
+
+//tells a player where we've put them, if we've moved them and haven't told them too recently
+//reliable, once it's sent they won't be told again unless they end up somewhere else they can't be
+SteamNetworkingMessage_t* BuildCorrectionMessage(ClientConnection& client, SteamNetworkingMicroseconds now)
+{
+	if (networkMode != NETWORK_MODE_STATE_SYNC || client.bSubscriber || client.id <= 0 || !pendingCorrections[(int)client.id]
+		|| now - client.lastCorrectionTime < NETWORK_CORRECTION_INTERVAL)
+	{
+		return nullptr;
+	}
+
+	auto itEntity = clientPositions.find(client.id);
+	if (itEntity == clientPositions.end())
+	{
+		return nullptr;
+	}
+	pendingCorrections[(int)client.id] = false;
+	client.lastCorrectionTime = now;
+
+	Vector2Int position = ExtrapolatePosition(itEntity->second, now);
+	PauseAllocationAudit(); //message buffers are the library's business
+	SteamNetworkingMessage_t* correctionMsg = SteamNetworkingUtils()->AllocateMessage(NETWORK_HEADER_SIZE + 8);
+	ResumeAllocationAudit();
+	char* data = (char*)correctionMsg->m_pData;
+	WriteMessageHeader(MESSAGE_POSITION_CORRECTION, data);
+	SerializeInt(position.x, data + NETWORK_HEADER_SIZE);
+	SerializeInt(position.y, data + NETWORK_HEADER_SIZE + 4);
+
+	correctionMsg->m_conn = client.conn;
+	correctionMsg->m_nFlags = k_nSteamNetworkingSend_Reliable;
+	correctionMsg->m_idxLane = NETWORK_LANE_UPDATES;
+	return correctionMsg;
+}
+
+
+// kills the session
+static void NukeProcess(int rc)
+{
+#ifdef _WIN32
+	ExitProcess(rc);
+#else
+	(void)rc; // Unused formal parameter
+	kill(getpid(), SIGKILL);
+#endif
+}
+
+//hands GameNetworkingSockets' output to the log
+//kills the session if the type is a bug
+static void DebugOutput(ESteamNetworkingSocketsDebugOutputType eType, const char* pszMsg)
+{
+	if (eType == k_ESteamNetworkingSocketsDebugOutputType_Bug)
+	{
+		AsyncLogText(ASYNC_LOG_FATAL, pszMsg);
+		FlushAsyncLog();
+		NukeProcess(1);
+	}
+
+	int level = ASYNC_LOG_DEBUG;
+	if (eType <= k_ESteamNetworkingSocketsDebugOutputType_Error)
+		level = ASYNC_LOG_ERROR;
+	else if (eType == k_ESteamNetworkingSocketsDebugOutputType_Warning)
+		level = ASYNC_LOG_WARNING;
+	else if (eType <= k_ESteamNetworkingSocketsDebugOutputType_Msg)
+		level = ASYNC_LOG_INFO;
+	AsyncLogText(level, pszMsg);
+}
+
+//debugs an error and kills the session
+//the log is flushed first so the reason makes it out
+void FatalError(const char* fmt, ...)
+{
+	va_list ap;
+	va_start(ap, fmt);
+	AsyncLogV(ASYNC_LOG_FATAL, fmt, ap);
+	va_end(ap);
+	FlushAsyncLog();
+	NukeProcess(1);
+}
+
+//prints a string to the console
+void Printf(const char* fmt, ...)
+{
+	va_list ap;
+	va_start(ap, fmt);
+	AsyncLogV(ASYNC_LOG_INFO, fmt, ap);
+	va_end(ap);
+}
+
+// trim from start (in place)
+static inline void ltrim(std::string& s) {
+	s.erase(s.begin(), std::find_if(s.begin(), s.end(), [](int ch) {
+		return !std::isspace(ch);
+		}));
+}
+
+// trim from end (in place)
+static inline void rtrim(std::string& s) {
+	s.erase(std::find_if(s.rbegin(), s.rend(), [](int ch) {
+		return !std::isspace(ch);
+		}).base(), s.end());
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// NetworkServer
+//
+/////////////////////////////////////////////////////////////////////////////
+
+class NetworkServer
+{
+public:
+	void Run(uint16 nPort)
+	{
+		// Select instance to use.  For now we'll always use the default.
+		// But we could use SteamGameServerNetworkingSockets() on Steam.
+		m_pInterface = SteamNetworkingSockets();
+
+		// Start listening
+		SteamNetworkingIPAddr serverLocalAddr;
+		serverLocalAddr.Clear();
+		serverLocalAddr.m_port = nPort;
+		SteamNetworkingConfigValue_t opt;
+		opt.SetPtr(k_ESteamNetworkingConfig_Callback_ConnectionStatusChanged, (void*)SteamNetConnectionStatusChangedCallback);
+		m_hListenSock = m_pInterface->CreateListenSocketIP(serverLocalAddr, 1, &opt);
+		if (m_hListenSock == k_HSteamListenSocket_Invalid)
+			FatalError("Failed to listen on port %d", nPort);
+		m_hPollGroup = m_pInterface->CreatePollGroup();
+		if (m_hPollGroup == k_HSteamNetPollGroup_Invalid)
+			FatalError("Failed to listen on port %d", nPort);
+		Printf("Server listening on port %d\n", nPort);
+
+		//the host is always player 0
+		myID = 0;
+		if (networkMode == NETWORK_MODE_ROLLBACK)
+		{
+			rollbackSession.Start(myID, (int)(SteamNetworkingUtils()->GetLocalTimestamp() * ROLLBACK_TICK_RATE / 1000000));
+		}
+
+		//sized for a full server up front, so a busy tick never has to grow them
+		for (std::vector<DataPacket>& tickEntities : worldHistory)
+		{
+			tickEntities.reserve(NETWORK_MAX_ENTITIES);
+		}
+		movementStep.Reserve(NETWORK_MAX_ENTITIES);
+		movementBodies.reserve(NETWORK_MAX_ENTITIES);
+
+		serverTimers.Init(SteamNetworkingUtils()->GetLocalTimestamp(), NETWORK_MAX_ENTITIES * 4);
+
+		networkStatus = SERVER_ACTIVE;
+
+	}
+private:
+	static void SteamNetConnectionStatusChangedCallback(SteamNetConnectionStatusChangedCallback_t* pInfo)
+	{
+		s_pCallbackInstance->OnSteamNetConnectionStatusChanged(pInfo);
+	}
+public:
+	//sends the client the ID they should stamp on their packets, and the token to reclaim it with
+	void SendIDToClient(HSteamNetConnection conn, char clientID, uint64 token)
+	{
+		char message[NETWORK_HEADER_SIZE + 9];
+		WriteMessageHeader(MESSAGE_ASSIGN_ID, message);
+		message[NETWORK_HEADER_SIZE] = clientID;
+		SerializeInt64((int64)token, message + NETWORK_HEADER_SIZE + 1);
+
+		SendNetworkMessage(conn, message, sizeof(message), k_nSteamNetworkingSend_Reliable);
+	}
+
+	//sends the whole world as one compressed reliable message on the bulk lane
+	//so a new client is caught up in one round trip
+	void SendBaselineToClient(const ClientConnection& client)
+	{
+		std::vector<DataPacket> entities;
+		GatherWorldEntities(SteamNetworkingUtils()->GetLocalTimestamp(), entities);
+		SendBulkMessage(client.conn, BuildWorldBaseline(entities, client.bPackSnapshots));
+	}
+
+	//sends a resuming client only what changed since the world they last acked
+	void SendDeltaToClient(const ClientConnection& client, const std::vector<DataPacket>& ackedWorld)
+	{
+		std::vector<DataPacket> entities;
+		GatherWorldEntities(SteamNetworkingUtils()->GetLocalTimestamp(), entities);
+		SendBulkMessage(client.conn, BuildWorldDelta(ackedWorld, entities, client.bPackSnapshots));
+	}
+
+	//lets the front of the join queue in as fast as the token bucket allows
+	//everyone still waiting is accepted, so they don't time out, and told their place
+	void AdmitPendingJoins(SteamNetworkingMicroseconds now)
+	{
+		if (lastJoinRefillTime != 0)
+		{
+			joinTokens = std::min(joinTokens + joinRate * (float)(now - lastJoinRefillTime) / 1000000.0f, (float)joinBurst);
+		}
+		lastJoinRefillTime = now;
+
+		int joined = 0;
+		while (!pendingJoins.empty() && joined < joinsPerTick && joinTokens >= 1.0f)
+		{
+			PendingJoin& join = pendingJoins.front();
+			if (!join.bAccepted && !AcceptPendingJoin(join))
+			{
+				pendingJoins.pop_front();
+				continue;
+			}
+
+			//full, they keep their place until someone leaves
+			int clientID = AllocateClientID();
+			if (clientID < 0)
+			{
+				break;
+			}
+
+			AdmitClient(join.conn, clientID);
+			pendingJoins.pop_front();
+			joinTokens -= 1.0f;
+			joined++;
+		}
+
+		//joins are accepted from the front, so only the ones after the accepted ones need looking at
+		//once accepted, their own timer keeps them told their place
+		auto itJoin = std::partition_point(pendingJoins.begin(), pendingJoins.end(), [](const PendingJoin& join) {
+			return join.bAccepted;
+			});
+		for (int accepted = 0; itJoin != pendingJoins.end() && accepted < NETWORK_MAX_ACCEPTS_PER_TICK; accepted++)
+		{
+			if (!AcceptPendingJoin(*itJoin))
+			{
+				itJoin = pendingJoins.erase(itJoin);
+				continue;
+			}
+
+			SendJoinQueuePosition(*itJoin, (int)(itJoin - pendingJoins.begin()) + 1);
+			serverTimers.Schedule(now + NETWORK_JOIN_QUEUE_UPDATE_INTERVAL, UpdateJoinQueuePosition, itJoin->joinNumber);
+			++itJoin;
+		}
+	}
+
+	//the first thing a client gets once we know whether they're new: their ID and the world
+	void WelcomeClient(ClientConnection& client)
+	{
+		SendIDToClient(client.conn, client.id, client.sessionToken);
+		SendBaselineToClient(client);
+		client.bWelcomed = true;
+		settledTicks = 0;
+
+		//let everyone already here know, their first message has put them in the world by now
+		auto itEntity = clientPositions.find(client.id);
+		if (!client.bSubscriber && itEntity != clientPositions.end())
+		{
+			GameEvent spawn = {};
+			spawn.type = GAME_EVENT_SPAWN;
+			spawn.player = client.id;
+			spawn.x = itEntity->second.position.x;
+			spawn.y = itEntity->second.position.y;
+			BroadcastGameEvent(spawn, client.conn);
+		}
+	}
+private:
+	//returns false if they'd already gone
+	bool AcceptPendingJoin(PendingJoin& join)
+	{
+		// Try to accept the connection.
+		if (m_pInterface->AcceptConnection(join.conn) != k_EResultOK)
+		{
+			// This could fail.  If the remote host tried to connect, but then
+			// disconnected, the connection may already be half closed.  Just
+			// destroy whatever we have on our side.
+			m_pInterface->CloseConnection(join.conn, 0, nullptr, false);
+			Printf("Can't accept connection.  (It was already closed?)");
+			return false;
+		}
+		join.bAccepted = true;
+		return true;
+	}
+
+	//moves a connection from the join queue into the game
+	void AdmitClient(HSteamNetConnection conn, int clientID)
+	{
+		// Assign the poll group
+		//anything they sent while queued moves over with them, so a resume isn't lost
+		if (!m_pInterface->SetConnectionPollGroup(conn, m_hPollGroup))
+		{
+			m_pInterface->CloseConnection(conn, 0, nullptr, false);
+			Printf("Failed to set poll group?");
+			return;
+		}
+
+		//give the baseline its own lane, sharing bandwidth with the updates
+		const int lanePriorities[NETWORK_LANE_COUNT] = { 0, 0 };
+		const uint16 laneWeights[NETWORK_LANE_COUNT] = { 3, 1 };
+		if (m_pInterface->ConfigureConnectionLanes(conn, NETWORK_LANE_COUNT, lanePriorities, laneWeights) != k_EResultOK)
+		{
+			Printf("Failed to configure connection lanes?");
+		}
+
+		// Add them to the client list
+		//their ID is sent with the world once we've heard from them (see WelcomeClient)
+		ClientConnection newClient = {};
+		newClient.conn = conn;
+		newClient.id = (char)clientID;
+		newClient.sessionToken = GenerateSessionToken();
+		m_Clients.push_back(newClient);
+	}
+
+	//a baseline or delta, reliable on the bulk lane
+	void SendBulkMessage(HSteamNetConnection conn, const std::vector<char>& baseline)
+	{
+		SteamNetworkingMessage_t* baselineMsg = SteamNetworkingUtils()->AllocateMessage((int)baseline.size());
+		memcpy(baselineMsg->m_pData, baseline.data(), baseline.size());
+		baselineMsg->m_conn = conn;
+		baselineMsg->m_nFlags = k_nSteamNetworkingSend_Reliable;
+		baselineMsg->m_idxLane = NETWORK_LANE_BULK;
+
+		int64 result;
+		SendNetworkMessages(1, &baselineMsg, &result);
+		if (result < 0)
+		{
+			Printf("Failed to send baseline (%d)", (int)-result);
+		}
+	}
+
+	void OnSteamNetConnectionStatusChanged(SteamNetConnectionStatusChangedCallback_t* pInfo)
+	{
+		settledTicks = 0; //someone came or went, the next few ticks will be allocating
+		char temp[1024];
+
+		// What's the state of the connection?
+		switch (pInfo->m_info.m_eState)
+		{
+		case k_ESteamNetworkingConnectionState_None:
+			// NOTE: We will get callbacks here when we destroy connections.  You can ignore these.
+			break;
+
+		case k_ESteamNetworkingConnectionState_ClosedByPeer:
+		case k_ESteamNetworkingConnectionState_ProblemDetectedLocally:
+		{
+			//they gave up waiting in the join queue, nothing else knows about them yet
+			auto itPending = FindPendingJoin(pInfo->m_hConn);
+			if (itPending != pendingJoins.end())
+			{
+				Printf("Connection %s left the join queue", pInfo->m_info.m_szConnectionDescription);
+				pendingJoins.erase(itPending);
+			}
+			// Ignore if they were not previously connected.  (If they disconnected
+			// before we accepted the connection.)
+			else if (pInfo->m_eOldState == k_ESteamNetworkingConnectionState_Connected)
+			{
+
+				// Locate the client.  Note that it should have been found, because this
 				// is the only codepath where we remove clients (except on shutdown),
 				// and connection change callbacks are dispatched in queue order.
-				auto itClient = std::find(m_Clients.begin(), m_Clients.end(), pInfo->m_hConn);
+				auto itClient = FindClient(pInfo->m_hConn);
 				assert(itClient != m_Clients.end());
 
 				// Select appropriate log messages
@@ -310,11 +1501,139 @@ private:
 					pInfo->m_info.m_szEndDebug
 				);
 
+				if (zoneFront != nullptr)
+				{
+					zoneFront->RemoveEntity(itClient->id);
+				}
+				//dropped rather than left, they'll likely be back in a moment
+				else if (pInfo->m_info.m_eState == k_ESteamNetworkingConnectionState_ProblemDetectedLocally)
+				{
+					HoldClientSlot(*itClient);
+				}
+
 				m_Clients.erase(itClient);
 			}
 			else
 			{
-				assert(pInfo->m_eOldState == k_ESteamNetworkingConnectionState_Connecting);
+				assert(pInfo->m_eOldState == k_ESteamNetworkingConnectionState_Connecting);
+			}
+
+			// Clean up the connection.  This is important!
+			// The connection is "closed" in the network sense, but
+			// it has not been destroyed.  We must close it on our end, too
+			// to finish up.  The reason information do not matter in this case,
+			// and we cannot linger because it's already closed on the other end,
+			// so we just pass 0's.
+			m_pInterface->CloseConnection(pInfo->m_hConn, 0, nullptr, false);
+			break;
+		}
+
+		case k_ESteamNetworkingConnectionState_Connecting:
+		{
+			// This must be a new connection
+			assert(FindClient(pInfo->m_hConn) == m_Clients.end());
+
+			Printf("Connection request from %s", pInfo->m_info.m_szConnectionDescription);
+
+			//they join the queue, AdmitPendingJoins lets them in at the start of a tick
+			pendingJoins.push_back({ pInfo->m_hConn, nextJoinNumber++, false, 0 });
+			break;
+		}
+
+		case k_ESteamNetworkingConnectionState_Connected:
+			// We will get a callback immediately after accepting the connection.
+			// Since we are the server, we can ignore this, it's not news to us.
+			break;
+
+		default:
+			// Silences -Wswitch
+			break;
+		}
+	}
+};
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// NetworkClient
+//
+/////////////////////////////////////////////////////////////////////////////
+
+class NetworkClient
+{
+public:
+	void Run(const SteamNetworkingIPAddr& serverAddr)
+	{
+		// Select instance to use.  For now we'll always use the default.
+		m_pInterface = SteamNetworkingSockets();
+
+		m_ServerAddr = serverAddr;
+		Connect();
+		if (m_hConnection == k_HSteamNetConnection_Invalid)
+			FatalError("Failed to create connection");
+
+		//CLIENT_ACTIVE once it connects
+		networkStatus = CLIENT_STARTING;
+	}
+
+	//keeps trying to reach the server after we've lost it, it may just be restarting
+	void Reconnect()
+	{
+		if (SteamNetworkingUtils()->GetLocalTimestamp() - m_LastConnectAttempt >= NETWORK_RECONNECT_INTERVAL)
+		{
+			Connect();
+		}
+	}
+private:
+	void Connect()
+	{
+		// Start connecting
+		char szAddr[SteamNetworkingIPAddr::k_cchMaxString];
+		m_ServerAddr.ToString(szAddr, sizeof(szAddr), true);
+		Printf("Connecting to server at %s", szAddr);
+		SteamNetworkingConfigValue_t opt;
+		opt.SetPtr(k_ESteamNetworkingConfig_Callback_ConnectionStatusChanged, (void*)SteamNetConnectionStatusChangedCallback);
+		m_hConnection = m_pInterface->ConnectByIPAddress(m_ServerAddr, 1, &opt);
+		m_LastConnectAttempt = SteamNetworkingUtils()->GetLocalTimestamp();
+	}
+
+	SteamNetworkingIPAddr m_ServerAddr;
+	SteamNetworkingMicroseconds m_LastConnectAttempt = 0;
+
+	static void SteamNetConnectionStatusChangedCallback(SteamNetConnectionStatusChangedCallback_t* pInfo)
+	{
+		s_pClientCallbackInstance->OnSteamNetConnectionStatusChanged(pInfo);
+	}
+
+	void OnSteamNetConnectionStatusChanged(SteamNetConnectionStatusChangedCallback_t* pInfo)
+	{
+		settledTicks = 0; //someone came or went, the next few ticks will be allocating
+		assert(pInfo->m_hConn == m_hConnection || m_hConnection == k_HSteamNetConnection_Invalid);
+
+		// What's the state of the connection?
+		switch (pInfo->m_info.m_eState)
+		{
+		case k_ESteamNetworkingConnectionState_None:
+			// NOTE: We will get callbacks here when we destroy connections.  You can ignore these.
+			break;
+
+		case k_ESteamNetworkingConnectionState_ClosedByPeer:
+		case k_ESteamNetworkingConnectionState_ProblemDetectedLocally:
+		{
+			// Print an appropriate message
+			if (pInfo->m_eOldState == k_ESteamNetworkingConnectionState_Connecting)
+			{
+				// Note: we could distinguish between a timeout, a rejected connection,
+				// or some other transport problem.
+				Printf("We sought the remote host, yet our efforts were met with defeat.  (%s)", pInfo->m_info.m_szEndDebug);
+			}
+			else if (pInfo->m_info.m_eState == k_ESteamNetworkingConnectionState_ProblemDetectedLocally)
+			{
+				Printf("Alas, troubles beset us; we have lost contact with the host.  (%s)", pInfo->m_info.m_szEndDebug);
+			}
+			else
+			{
+				// NOTE: We could check the reason code for a normal disconnection
+				Printf("The host hath bidden us farewell.  (%s)", pInfo->m_info.m_szEndDebug);
 			}
 
 			// Clean up the connection.  This is important!
@@ -324,371 +1643,1108 @@ private:
 			// and we cannot linger because it's already closed on the other end,
 			// so we just pass 0's.
 			m_pInterface->CloseConnection(pInfo->m_hConn, 0, nullptr, false);
+			m_hConnection = k_HSteamNetConnection_Invalid;
+			bServerConnected = false;
+			networkStatus = CLIENT_STARTING;
+
+			//hold on to our session so we can ask for our slot back once we're reconnected
+			if (sessionToken != 0)
+			{
+				resumeToken = sessionToken;
+			}
+			break;
+		}
+
+		case k_ESteamNetworkingConnectionState_Connecting:
+			// We will get this callback when we start connecting.
+			// We can ignore this.
+			break;
+
+		case k_ESteamNetworkingConnectionState_Connected:
+		{
+			Printf("Connected to server OK");
+			bServerConnected = true;
+			networkStatus = CLIENT_ACTIVE;
+			joinQueuePosition = 0;
+
+			//it may be a different server process than last time, with its own sequence and clock
+			lastSnapshotSequence = 0;
+			clockSynced = false;
+
+			//ahead of anything else, so the server knows before it sends us the world
+			if (snapshotCodec.IsLoaded())
+			{
+				char message[NETWORK_HEADER_SIZE + 4];
+				WriteMessageHeader(MESSAGE_CODEC_OFFER, message);
+				SerializeInt((int)snapshotCodec.GetDictionaryID(), message + NETWORK_HEADER_SIZE);
+				SendNetworkMessage(m_hConnection, message, sizeof(message), k_nSteamNetworkingSend_Reliable);
+			}
+
+			if (resumeToken != 0)
+			{
+				char message[NETWORK_HEADER_SIZE + 8];
+				WriteMessageHeader(MESSAGE_RESUME, message);
+				SerializeInt64((int64)resumeToken, message + NETWORK_HEADER_SIZE);
+				SendNetworkMessage(m_hConnection, message, sizeof(message), k_nSteamNetworkingSend_Reliable);
+				resumeToken = 0;
+			}
+			break;
+		}
+
+		default:
+			// Silences -Wswitch
 			break;
 		}
-
-		case k_ESteamNetworkingConnectionState_Connecting:
+	}
+};
+
+const uint16 DEFAULT_SERVER_PORT = 27020;
+
+void PrintUsageAndExit(int rc = 1)
+{
+	fflush(stderr);
+	printf(
+		R"usage(Usage:
+    example client SERVER_ADDR
+    example server [--port PORT] [--zones ZONES] [--join-rate PER_SECOND] [--join-burst JOINS] [--joins-per-tick JOINS]
+                   [--capture-snapshots FILE]
+either can also take the --sim-* options from net_conditions.h
+)usage"
+);
+	fflush(stdout);
+	exit(rc);
+}
+
+//brings up GameNetworkingSockets, safe to call off the game thread
+//every process that talks to the network has these, the game registers its own frame metrics
+static void RegisterNetworkMetrics()
+{
+	static const double snapshotBuckets[] = { 64, 256, 1024, 4096, 16384, 65536 };
+	static const double tickBuckets[] = { 0.0005, 0.001, 0.002, 0.004, 0.008, 0.016, 0.033, 0.1 };
+
+	metricMessagesReceived = RegisterCounter("game_network_messages_received_total", "Messages received from any connection");
+	metricMessagesSent = RegisterCounter("game_network_messages_sent_total", "Messages sent to any connection");
+	metricBytesReceived = RegisterCounter("game_network_bytes_received_total", "Message bytes received, before the library's own framing");
+	metricBytesSent = RegisterCounter("game_network_bytes_sent_total", "Message bytes sent, before the library's own framing");
+	metricSnapshotBytes = RegisterHistogram("game_network_snapshot_bytes", "Size of each snapshot message built for a client",
+		snapshotBuckets, sizeof(snapshotBuckets) / sizeof(snapshotBuckets[0]));
+	metricTickSeconds = RegisterHistogram("game_network_server_tick_seconds", "Time the server spends in one network update",
+		tickBuckets, sizeof(tickBuckets) / sizeof(tickBuckets[0]));
+	metricConnections = RegisterGauge("game_network_connections", "Clients connected to this server");
+	metricGameEvents = RegisterCounter("game_network_game_events_total", "Game events queued for a connection, each fanned out copy counted");
+}
+
+//returns false with the reason in errMsg if it can't
+static bool TryInitNetworkLibrary(SteamDatagramErrMsg& errMsg)
+{
+	// Create client and server sockets
+#ifdef STEAMNETWORKINGSOCKETS_OPENSOURCE
+	if (!GameNetworkingSockets_Init(nullptr, errMsg))
+		return false;
+#else
+	SteamDatagram_SetAppID(570); // Just set something, doesn't matter what
+	SteamDatagram_SetUniverse(false, k_EUniverseDev);
+
+	if (!SteamDatagramClient_Init(errMsg))
+		return false;
+
+	// Disable authentication when running with Steam, for this
+	// example, since we're not a real app.
+	//
+	// Authentication is disabled automatically in the open-source
+	// version since we don't have a trusted third party to issue
+	// certs.
+	SteamNetworkingUtils()->SetGlobalConfigValueInt32(k_ESteamNetworkingConfig_IP_AllowWithoutAuth, 1);
+#endif
+
+	SteamNetworkingUtils()->SetDebugOutputFunction(k_ESteamNetworkingSocketsDebugOutputType_Msg, DebugOutput);
+
+	RegisterNetworkMetrics();
+
+	//every entity there can be, so entities coming and going never allocate
+	EntityMap::allocator_type::Pool::Reserve(NETWORK_MAX_ENTITIES);
+
+	//without it everything still works, just compressed with deflate
+	if (!snapshotCodec.Load(SNAPSHOT_DICTIONARY_PATH))
+	{
+		Printf("No snapshot dictionary at %s, snapshots won't be packed", SNAPSHOT_DICTIONARY_PATH);
+	}
+
+	StartNetworkConditions();
+	return true;
+}
+
+//shared by the game and the headless cluster processes
+void InitNetworkLibrary()
+{
+	SteamDatagramErrMsg errMsg;
+	if (!TryInitNetworkLibrary(errMsg))
+		FatalError("Failed to start the networking library.  %s", errMsg);
+}
+
+//bInitLibrary is false when the library was already brought up in the background
+int startSessionFromArgument(int argc, const char* argv[], bool bInitLibrary)
+{
+	bool bServer = false;
+	bool bClient = false;
+	int nPort = DEFAULT_SERVER_PORT;
+	int nZones = 0;
+	SteamNetworkingIPAddr addrServer; addrServer.Clear();
+
+	for (int i = 0; i < argc; ++i)
+	{
+		if (!bClient && !bServer)
+		{
+			if (!strcmp(argv[i], "client"))
+			{
+				bClient = true;
+				continue;
+			}
+			if (!strcmp(argv[i], "server"))
+			{
+				bServer = true;
+				Printf("is server");
+				continue;
+			}
+		}
+		if (!strcmp(argv[i], "--port"))
+		{
+			++i;
+			if (i >= argc)
+				PrintUsageAndExit();
+			nPort = atoi(argv[i]);
+			if (nPort <= 0 || nPort > 65535)
+				FatalError("Invalid port %d", nPort);
+			continue;
+		}
+		if (ParseNetworkConditionOption(argc, argv, i))
+		{
+			continue;
+		}
+		if (bServer && (!strcmp(argv[i], "--join-rate") || !strcmp(argv[i], "--join-burst") || !strcmp(argv[i], "--joins-per-tick")))
+		{
+			if (i + 1 >= argc)
+				PrintUsageAndExit();
+			float value = (float)atof(argv[i + 1]);
+			if (value < 1.0f)
+				FatalError("Invalid %s %s", argv[i], argv[i + 1]);
+
+			if (!strcmp(argv[i], "--join-rate"))
+				joinRate = value;
+			else if (!strcmp(argv[i], "--join-burst"))
+				joinBurst = (int)value;
+			else
+				joinsPerTick = (int)value;
+			joinTokens = (float)joinBurst;
+			++i;
+			continue;
+		}
+		if (bServer && !strcmp(argv[i], "--capture-snapshots"))
+		{
+			++i;
+			if (i >= argc)
+				PrintUsageAndExit();
+			snapshotCaptureFile = fopen(argv[i], "wb");
+			if (snapshotCaptureFile == nullptr)
+				FatalError("Can't write snapshots to %s", argv[i]);
+			continue;
+		}
+		if (bServer && !strcmp(argv[i], "--zones"))
+		{
+			++i;
+			if (i >= argc)
+				PrintUsageAndExit();
+			nZones = atoi(argv[i]);
+			if (nZones <= 0 || nZones > ZONE_MAX_ZONES)
+				FatalError("Invalid zone count %d", nZones);
+			continue;
+		}
+
+		// Anything else, must be server address to connect to
+		if (bClient && addrServer.IsIPv6AllZeros())
+		{
+			if (!addrServer.ParseString(argv[i]))
+				FatalError("Invalid server address '%s'", argv[i]);
+			if (addrServer.m_port == 0)
+				addrServer.m_port = DEFAULT_SERVER_PORT;
+			continue;
+		}
+
+		PrintUsageAndExit();
+	}
+
+	if (bClient == bServer || (bClient && addrServer.IsIPv6AllZeros()))
+		PrintUsageAndExit();
+
+	//
+	// Initialization
+	//
+
+	if (bInitLibrary)
+	{
+		InitNetworkLibrary();
+	}
+
+	//
+	// Application Loop
+	//
+
+	if (bClient)
+	{
+		myClient = new NetworkClient;
+		myClient->Run(addrServer);
+	}
+	else
+	{
+		myServer = new NetworkServer;
+		myServer->Run((uint16)nPort);
+
+		if (nZones > 0)
+		{
+			zoneFront = new ZoneFront(clientPositions);
+			zoneFront->Start(nZones);
+		}
+		else if (networkMode == NETWORK_MODE_STATE_SYNC && !bCheckpointDisabled)
+		{
+			RestoreWorldCheckpoint();
+		}
+	}
+
+	return 0;
+}
+
+static void startSessionFromString(const char* argument, bool bInitLibrary)
+{
+	//split the string
+	std::istringstream iss(argument);
+	std::vector<std::string> tokens;
+	std::string token;
+	while (iss >> token) {
+		tokens.push_back(token);
+	}
+
+	// build const char* array
+	std::vector<const char*> argv;
+	for (auto& t : tokens) {
+		argv.push_back(t.c_str());
+	}
+
+	//get the amount of args
+	int argc = static_cast<int>(argv.size());
+
+	startSessionFromArgument(argc, argv.data(), bInitLibrary);
+}
+
+void startSession(const char* argument)
+{
+	startSessionFromString(argument, true);
+}
+
+//async startup
+//the library's init can take a noticeable time (crypto setup), so the game starts it on its own
+//thread and UpdateNetwork finishes the session off on the game thread once it's up
+std::thread startupThread;
+std::atomic<bool> bStartupDone{ false };
+bool bStartupSucceeded = false; //published by bStartupDone
+SteamDatagramErrMsg startupError;
+std::string startupArgument;
+
+static void StartSessionAsync(NetworkStatus startingStatus, const char* argument)
+{
+	//one session per run
+	if (networkStatus != INACTIVE)
+	{
+		return;
+	}
+
+	networkStatus = startingStatus;
+	startupArgument = argument;
+	bStartupDone = false;
+	startupThread = std::thread([]() {
+		bStartupSucceeded = TryInitNetworkLibrary(startupError);
+		bStartupDone = true;
+		});
+}
+
+//once the background init is done, creates the session on the game thread
+//returns false while there's no session to update yet
+static bool PollSessionStartup()
+{
+	if (startupThread.joinable())
+	{
+		if (!bStartupDone)
+		{
+			return false;
+		}
+		startupThread.join();
+
+		if (!bStartupSucceeded)
+		{
+			Printf("Failed to start the networking library.  %s", startupError);
+			networkStatus = NETWORK_FAILED;
+			return false;
+		}
+		startSessionFromString(startupArgument.c_str(), false);
+	}
+
+	return myServer != nullptr || myClient != nullptr;
+}
+
+void StartServer()
+{
+	StartSessionAsync(SERVER_STARTING, "server --port 7777");
+}
+
+void StartClient()
+{
+	StartSessionAsync(CLIENT_STARTING, "client 127.0.0.1:7777");
+}
+
+void StartSpectator()
+{
+	//a relay looks just like a server to its spectators
+	StartSessionAsync(CLIENT_STARTING, "client 127.0.0.1:7900");
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// Message dispatch
+//
+/////////////////////////////////////////////////////////////////////////////
+
+static void ServerHandlePlayerState(const ISteamNetworkingMessage* pMsg, const char* payload, int payloadSize)
+{
+	auto itClient = FindClient(pMsg->m_conn);
+	if (itClient == m_Clients.end())
+	{
+		return;
+	}
+
+	//their ID is whatever we last gave them, a packet sent before a resume may still carry the old one
+	DataPacket incomingDataPacket = DeserializeDataPacket(payload);
+	incomingDataPacket.id = itClient->id;
+
+	//in a cluster the owning zone moves them, we hear back once it has
+	if (zoneFront != nullptr)
+	{
+		zoneFront->RoutePlayerState(incomingDataPacket);
+	}
+	else if (networkMode == NETWORK_MODE_ROLLBACK)
+	{
+		//only a heartbeat, rollback moves them by its own step
+		clientPositions[incomingDataPacket.id] = { { incomingDataPacket.posX, incomingDataPacket.posY },
+			{ incomingDataPacket.velX, incomingDataPacket.velY }, pMsg->m_usecTimeReceived };
+	}
+	else
+	{
+		//no further than they could have gone since last time, the movement step sorts out the rest
+		Vector2Int claimed = { incomingDataPacket.posX, incomingDataPacket.posY };
+		Vector2Int position = claimed;
+		auto itEntity = clientPositions.find(incomingDataPacket.id);
+		if (itEntity != clientPositions.end())
+		{
+			position = LimitMove(itEntity->second.position, claimed, pMsg->m_usecTimeReceived - itEntity->second.updateTime);
+		}
+		if (position.x != claimed.x || position.y != claimed.y)
 		{
-			// This must be a new connection
-			assert(std::find(m_Clients.begin(), m_Clients.end(), pInfo->m_hConn) == m_Clients.end());
+			pendingCorrections[(int)incomingDataPacket.id] = true;
+		}
 
-			Printf("Connection request from %s", pInfo->m_info.m_szConnectionDescription);
+		Vector2Int velocity = LimitVelocity({ incomingDataPacket.velX, incomingDataPacket.velY });
+		clientPositions[incomingDataPacket.id] = { position, velocity, pMsg->m_usecTimeReceived };
+	}
 
-			// A client is attempting to connect
-			// Try to accept the connection.
-			if (m_pInterface->AcceptConnection(pInfo->m_hConn) != k_EResultOK)
-			{
-				// This could fail.  If the remote host tried to connect, but then
-				// disconnected, the connection may already be half closed.  Just
-				// destroy whatever we have on our side.
-				m_pInterface->CloseConnection(pInfo->m_hConn, 0, nullptr, false);
-				Printf("Can't accept connection.  (It was already closed?)");
-				break;
-			}
+	//remember their timestamp to echo back in their next snapshot
+	itClient->lastClientTime = DeserializeInt64(payload + NETWORK_PACKET_SIZE);
+	itClient->lastClientTimeReceived = pMsg->m_usecTimeReceived;
 
-			// Assign the poll group
-			if (!m_pInterface->SetConnectionPollGroup(pInfo->m_hConn, m_hPollGroup))
-			{
-				m_pInterface->CloseConnection(pInfo->m_hConn, 0, nullptr, false);
-				Printf("Failed to set poll group?");
-				break;
-			}
+	//and which snapshot they're up to, in case they have to resume
+	uint32 ackedSnapshot = (uint32)DeserializeInt(payload, NETWORK_PACKET_SIZE + 8);
+	if ((int32)(ackedSnapshot - itClient->ackedSnapshot) > 0 && (int32)(itClient->snapshotSequence - ackedSnapshot) >= 0)
+	{
+		itClient->ackedSnapshot = ackedSnapshot;
+	}
+}
 
-			// Send them a welcome message
-			//sprintf(temp, "Welcome to the server");
-			//SendStringToClient(pInfo->m_hConn, temp);
+static void ServerHandleSubscribe(const ISteamNetworkingMessage* pMsg, const char* payload, int payloadSize)
+{
+	auto itClient = FindClient(pMsg->m_conn);
+	if (itClient != m_Clients.end() && !itClient->bSubscriber)
+	{
+		itClient->bSubscriber = true;
+		Printf("Client %d is a spectator relay", itClient->id);
+	}
+}
 
-			//send them their ID
-			std::string clientIDPacket = "ID";
-			char clientID = (char)(m_Clients.size() + 1);
-			clientIDPacket.append(&clientID);
-			//clientIDPacket.append('\0');
-			SendStringToClient(pInfo->m_hConn, clientIDPacket.c_str());
+//a player who came back with their token asks for their old slot
+static void ServerHandleResume(const ISteamNetworkingMessage* pMsg, const char* payload, int payloadSize)
+{
+	uint64 token = (uint64)DeserializeInt64(payload);
+	if (token == 0)
+	{
+		return;
+	}
 
-			// Add them to the client list, using std::map wacky syntax
-			m_Clients.push_back(pInfo->m_hConn);
-			break;
-		}
+	//if they noticed the drop before we did their old connection is still here, so finish it off
+	auto itStale = std::find_if(m_Clients.begin(), m_Clients.end(), [token, pMsg](const ClientConnection& client) {
+		return client.sessionToken == token && client.conn != pMsg->m_conn;
+		});
+	if (itStale != m_Clients.end())
+	{
+		HoldClientSlot(*itStale);
+		m_pInterface->CloseConnection(itStale->conn, 0, "Resumed on a new connection", false);
+		m_Clients.erase(itStale);
+	}
 
-		case k_ESteamNetworkingConnectionState_Connected:
-			// We will get a callback immediately after accepting the connection.
-			// Since we are the server, we can ignore this, it's not news to us.
-			break;
+	auto itClient = FindClient(pMsg->m_conn);
+	auto itReserved = std::find_if(reservedSlots.begin(), reservedSlots.end(), [token](const ReservedSlot& reserved) {
+		return reserved.sessionToken == token;
+		});
 
-		default:
-			// Silences -Wswitch
-			break;
-		}
+	//too late or never ours, they just get welcomed with the ID they joined with
+	if (itClient == m_Clients.end() || itReserved == reservedSlots.end())
+	{
+		return;
 	}
-};
 
-/////////////////////////////////////////////////////////////////////////////
-//
-// NetworkClient
-//
-/////////////////////////////////////////////////////////////////////////////
+	//drop the entity they started as and hand them back their old one
+	clientPositions.erase(itClient->id);
+	itClient->id = itReserved->id;
+	itClient->sessionToken = token;
 
-class NetworkClient
+	myServer->SendIDToClient(itClient->conn, itClient->id, token);
+	if (itReserved->bHasAckedWorld)
+	{
+		myServer->SendDeltaToClient(*itClient, itReserved->ackedWorld);
+	}
+	else
+	{
+		myServer->SendBaselineToClient(*itClient);
+	}
+	itClient->bWelcomed = true;
+
+	Printf("Client %d resumed their session", itClient->id);
+	serverTimers.Cancel(itReserved->expireTimer);
+	reservedSlots.erase(itReserved);
+}
+
+static void ClientHandleAssignID(const ISteamNetworkingMessage* pMsg, const char* payload, int payloadSize)
 {
-public:
-	void Run(const SteamNetworkingIPAddr& serverAddr)
+	//signed so a relay's NETWORK_SPECTATOR_ID comes through as -1
+	int newID = (signed char)payload[0];
+
+	//we've been given our old slot back, forget the one we were using in the meantime
+	if (myID > 0 && newID != myID)
 	{
-		// Select instance to use.  For now we'll always use the default.
-		m_pInterface = SteamNetworkingSockets();
+		clientPositions.erase(myID);
+	}
 
-		// Start connecting
-		char szAddr[SteamNetworkingIPAddr::k_cchMaxString];
-		serverAddr.ToString(szAddr, sizeof(szAddr), true);
-		Printf("Connecting to server at %s", szAddr);
-		SteamNetworkingConfigValue_t opt;
-		opt.SetPtr(k_ESteamNetworkingConfig_Callback_ConnectionStatusChanged, (void*)SteamNetConnectionStatusChangedCallback);
-		m_hConnection = m_pInterface->ConnectByIPAddress(serverAddr, 1, &opt);
-		if (m_hConnection == k_HSteamNetConnection_Invalid)
-			FatalError("Failed to create connection");
+	myID = newID;
+	sessionToken = (uint64)DeserializeInt64(payload + 1);
 
-		networkStatus = CLIENT_ACTIVE;
+	//being welcomed means we're out of the join queue
+	joinQueuePosition = 0;
+}
+
+static void ClientHandleJoinQueue(const ISteamNetworkingMessage* pMsg, const char* payload, int payloadSize)
+{
+	int position = DeserializeInt(payload);
+	if (joinQueuePosition == 0)
+	{
+		Printf("The server is busy, we're number %d in the join queue", position);
 	}
-private:
-	static void SteamNetConnectionStatusChangedCallback(SteamNetConnectionStatusChangedCallback_t* pInfo)
+	joinQueuePosition = position;
+}
+
+static void ClientHandlePositionCorrection(const ISteamNetworkingMessage* pMsg, const char* payload, int payloadSize)
+{
+	//the gameplay screen picks it up with PollPositionCorrection
+	correctedPosition.x = DeserializeInt(payload);
+	correctedPosition.y = DeserializeInt(payload, 4);
+	bPositionCorrected = true;
+}
+
+static void ClientHandleBaseline(const ISteamNetworkingMessage* pMsg, const char* payload, int payloadSize)
+{
+	//the world baseline sent when we joined
+	if (!ApplyWorldBaseline(payload, payloadSize))
 	{
-		s_pClientCallbackInstance->OnSteamNetConnectionStatusChanged(pInfo);
+		Printf("Received a malformed world baseline");
 	}
+}
 
-	void OnSteamNetConnectionStatusChanged(SteamNetConnectionStatusChangedCallback_t* pInfo)
+static void ClientHandleBaselineDelta(const ISteamNetworkingMessage* pMsg, const char* payload, int payloadSize)
+{
+	//what we missed while we were away, sent instead of the baseline when we resume
+	if (!ApplyWorldDelta(payload, payloadSize))
 	{
-		assert(pInfo->m_hConn == m_hConnection || m_hConnection == k_HSteamNetConnection_Invalid);
+		Printf("Received a malformed world delta");
+	}
+}
 
-		// What's the state of the connection?
-		switch (pInfo->m_info.m_eState)
-		{
-		case k_ESteamNetworkingConnectionState_None:
-			// NOTE: We will get callbacks here when we destroy connections.  You can ignore these.
-			break;
+static void ClientHandleSnapshot(const ISteamNetworkingMessage* pMsg, const char* payload, int payloadSize)
+{
+	//snapshots are unreliable and may arrive out of order, only the newest one matters
+	uint32 sequence = (uint32)DeserializeInt(payload);
+	if (lastSnapshotSequence != 0 && (int32)(sequence - lastSnapshotSequence) <= 0)
+	{
+		return;
+	}
 
-		case k_ESteamNetworkingConnectionState_ClosedByPeer:
-		case k_ESteamNetworkingConnectionState_ProblemDetectedLocally:
-		{
-			// Print an appropriate message
-			if (pInfo->m_eOldState == k_ESteamNetworkingConnectionState_Connecting)
-			{
-				// Note: we could distinguish between a timeout, a rejected connection,
-				// or some other transport problem.
-				Printf("We sought the remote host, yet our efforts were met with defeat.  (%s)", pInfo->m_info.m_szEndDebug);
-			}
-			else if (pInfo->m_info.m_eState == k_ESteamNetworkingConnectionState_ProblemDetectedLocally)
-			{
-				Printf("Alas, troubles beset us; we have lost contact with the host.  (%s)", pInfo->m_info.m_szEndDebug);
-			}
-			else
-			{
-				// NOTE: We could check the reason code for a normal disconnection
-				Printf("The host hath bidden us farewell.  (%s)", pInfo->m_info.m_szEndDebug);
-			}
+	int count = DeserializeInt(payload, 24);
+	if (count < 0 || count > (payloadSize - NETWORK_SNAPSHOT_HEADER_SIZE) / NETWORK_PACKET_SIZE
+		|| payloadSize != NETWORK_SNAPSHOT_HEADER_SIZE + count * NETWORK_PACKET_SIZE)
+	{
+		Printf("Received a malformed snapshot");
+		return;
+	}
+	lastSnapshotSequence = sequence;
 
-			// Clean up the connection.  This is important!
-			// The connection is "closed" in the network sense, but
-			// it has not been destroyed.  We must close it on our end, too
-			// to finish up.  The reason information do not matter in this case,
-			// and we cannot linger because it's already closed on the other end,
-			// so we just pass 0's.
-			m_pInterface->CloseConnection(pInfo->m_hConn, 0, nullptr, false);
-			m_hConnection = k_HSteamNetConnection_Invalid;
-			break;
-		}
+	SteamNetworkingMicroseconds serverTime = DeserializeInt64(payload + 4);
+	SteamNetworkingMicroseconds echoedTime = DeserializeInt64(payload + 12);
+	if (echoedTime != 0)
+	{
+		AddClockSample(echoedTime, serverTime, DeserializeInt(payload, 20), pMsg->m_usecTimeReceived);
+	}
 
-		case k_ESteamNetworkingConnectionState_Connecting:
-			// We will get this callback when we start connecting.
-			// We can ignore this.
-			break;
+	//positions are as of when the server sent them, so once we know its clock
+	//extrapolate from then rather than from when they got here
+	SteamNetworkingMicroseconds updateTime = pMsg->m_usecTimeReceived;
+	if (clockSynced)
+	{
+		updateTime = std::min(serverTime - serverClockOffset, updateTime);
+	}
 
-		case k_ESteamNetworkingConnectionState_Connected:
-			Printf("Connected to server OK");
-			break;
+	//unpack the whole block in one go, then merge it into the world
+	DecodeEntityBlock(payload + NETWORK_SNAPSHOT_HEADER_SIZE, count, decodedEntities);
+	for (int i = 0; i < count; i++)
+	{
+		clientPositions[decodedEntities.ids[i]] = { { decodedEntities.posX[i], decodedEntities.posY[i] },
+			{ decodedEntities.velX[i], decodedEntities.velY[i] }, updateTime };
+	}
+}
 
-		default:
-			// Silences -Wswitch
-			break;
-		}
+static void ClientHandleSnapshotPacked(const ISteamNetworkingMessage* pMsg, const char* payload, int payloadSize)
+{
+	thread_local std::vector<char> raw;
+	//the size comes off the wire and Decode allocates it up front, so hold it to the biggest snapshot there can be
+	int rawSize = DeserializeInt(payload);
+	if (rawSize < NETWORK_SNAPSHOT_HEADER_SIZE || rawSize > NETWORK_SNAPSHOT_HEADER_SIZE + NETWORK_MAX_ENTITIES * NETWORK_PACKET_SIZE
+		|| !snapshotCodec.Decode(payload + 4, payloadSize - 4, rawSize, raw))
+	{
+		Printf("Received a malformed packed snapshot");
+		return;
 	}
-};
+	ClientHandleSnapshot(pMsg, raw.data(), rawSize);
+}
 
-const uint16 DEFAULT_SERVER_PORT = 27020;
+static void ServerHandleCodecOffer(const ISteamNetworkingMessage* pMsg, const char* payload, int payloadSize)
+{
+	auto itClient = FindClient(pMsg->m_conn);
+	if (itClient == m_Clients.end())
+	{
+		return;
+	}
 
-void PrintUsageAndExit(int rc = 1)
+	//only pack for them if we'd both build the same tables
+	uint32 offeredID = (uint32)DeserializeInt(payload);
+	itClient->bPackSnapshots = snapshotCodec.IsLoaded() && offeredID == snapshotCodec.GetDictionaryID();
+
+	char message[NETWORK_HEADER_SIZE + 4];
+	WriteMessageHeader(MESSAGE_CODEC_OFFER, message);
+	SerializeInt(itClient->bPackSnapshots ? (int)offeredID : 0, message + NETWORK_HEADER_SIZE);
+	SendNetworkMessage(pMsg->m_conn, message, sizeof(message), k_nSteamNetworkingSend_Reliable);
+}
+
+static void ClientHandleCodecOffer(const ISteamNetworkingMessage* pMsg, const char* payload, int payloadSize)
 {
-	fflush(stderr);
-	printf(
-		R"usage(Usage:
-    example client SERVER_ADDR
-    example server [--port PORT]
-)usage"
-);
-	fflush(stdout);
-	exit(rc);
+	uint32 agreedID = (uint32)DeserializeInt(payload);
+	if (agreedID != 0)
+		Printf("Server packs our snapshots with dictionary %08x", agreedID);
+	else
+		Printf("Server has a different snapshot dictionary, snapshots will be sent unpacked");
 }
 
-int startSessionFromArgument(int argc, const char* argv[])
+static void ServerHandleGameEvents(const ISteamNetworkingMessage* pMsg, const char* payload, int payloadSize)
 {
-	bool bServer = false;
-	bool bClient = false;
-	int nPort = DEFAULT_SERVER_PORT;
-	SteamNetworkingIPAddr addrServer; addrServer.Clear();
+	auto itClient = FindClient(pMsg->m_conn);
+	if (itClient == m_Clients.end() || itClient->bSubscriber)
+	{
+		return;
+	}
 
-	for (int i = 0; i < argc; ++i)
+	GameEvent event;
+	int offset = 0;
+	while (offset < payloadSize)
 	{
-		if (!bClient && !bServer)
+		int size = DecodeGameEvent(payload + offset, payloadSize - offset, event);
+		if (size < 0)
 		{
-			if (!strcmp(argv[i], "client"))
-			{
-				bClient = true;
-				continue;
-			}
-			if (!strcmp(argv[i], "server"))
-			{
-				bServer = true;
-				Printf("is server");
-				continue;
-			}
+			Printf("Received a malformed game event from client %d", itClient->id);
+			return;
 		}
-		if (!strcmp(argv[i], "--port"))
+		offset += size;
+
+		//trust the connection, not the player they claim
+		event.player = itClient->id;
+		receivedEvents.Push(event);
+		BroadcastGameEvent(event, pMsg->m_conn);
+	}
+}
+
+static void ClientHandleGameEvents(const ISteamNetworkingMessage* pMsg, const char* payload, int payloadSize)
+{
+	GameEvent event;
+	int offset = 0;
+	while (offset < payloadSize)
+	{
+		int size = DecodeGameEvent(payload + offset, payloadSize - offset, event);
+		if (size < 0)
 		{
-			++i;
-			if (i >= argc)
-				PrintUsageAndExit();
-			nPort = atoi(argv[i]);
-			if (nPort <= 0 || nPort > 65535)
-				FatalError("Invalid port %d", nPort);
-			continue;
+			Printf("Received a malformed game event");
+			return;
 		}
+		offset += size;
+		receivedEvents.Push(event);
+	}
+}
 
-		// Anything else, must be server address to connect to
-		if (bClient && addrServer.IsIPv6AllZeros())
+//sends a rollback input, the server stamps the player when relaying
+static void SendRollbackInput(HSteamNetConnection conn, int player, int frame, unsigned char input)
+{
+	char message[NETWORK_HEADER_SIZE + 6];
+	WriteMessageHeader(MESSAGE_ROLLBACK_INPUT, message);
+	message[NETWORK_HEADER_SIZE] = (char)player;
+	SerializeInt(frame, message + NETWORK_HEADER_SIZE + 1);
+	message[NETWORK_HEADER_SIZE + 5] = (char)input;
+
+	//inputs must all arrive and in order, but are tiny and late ones cause rollbacks, so skip nagle
+	SendNetworkMessage(conn, message, sizeof(message), k_nSteamNetworkingSend_ReliableNoNagle);
+}
+
+static void ServerHandleRollbackInput(const ISteamNetworkingMessage* pMsg, const char* payload, int payloadSize)
+{
+	auto itClient = FindClient(pMsg->m_conn);
+	if (networkMode != NETWORK_MODE_ROLLBACK || itClient == m_Clients.end() || itClient->id >= ROLLBACK_MAX_PLAYERS)
+	{
+		return;
+	}
+
+	//trust the connection, not the player index they claim
+	int player = itClient->id;
+	int frame = DeserializeInt(payload, 1);
+	unsigned char input = (unsigned char)payload[5];
+	rollbackSession.AddRemoteInput(player, frame, input);
+
+	//pass it on to everyone else
+	for (auto& client : m_Clients)
+	{
+		if (client.conn != pMsg->m_conn && !client.bSubscriber)
 		{
-			if (!addrServer.ParseString(argv[i]))
-				FatalError("Invalid server address '%s'", argv[i]);
-			if (addrServer.m_port == 0)
-				addrServer.m_port = DEFAULT_SERVER_PORT;
-			continue;
+			SendRollbackInput(client.conn, player, frame, input);
 		}
-
-		PrintUsageAndExit();
 	}
+}
 
-	if (bClient == bServer || (bClient && addrServer.IsIPv6AllZeros()))
-		PrintUsageAndExit();
+static void ClientHandleRollbackInput(const ISteamNetworkingMessage* pMsg, const char* payload, int payloadSize)
+{
+	rollbackSession.AddRemoteInput((unsigned char)payload[0], DeserializeInt(payload, 1), (unsigned char)payload[5]);
+}
 
-	//
-	// Initialization
-	//
+static void ClientHandleRollbackSync(const ISteamNetworkingMessage* pMsg, const char* payload, int payloadSize)
+{
+	RollbackState syncState;
+	int* stateInts = (int*)&syncState;
+	for (int i = 0; i < ROLLBACK_STATE_INTS; i++)
+	{
+		stateInts[i] = DeserializeInt(payload, i * 4);
+	}
 
-	// Create client and server sockets
-#ifdef STEAMNETWORKINGSOCKETS_OPENSOURCE
-	SteamDatagramErrMsg errMsg;
-	if (!GameNetworkingSockets_Init(nullptr, errMsg))
-		FatalError("GameNetworkingSockets_Init failed.  %s", errMsg);
-#else
-	SteamDatagram_SetAppID(570); // Just set something, doesn't matter what
-	SteamDatagram_SetUniverse(false, k_EUniverseDev);
+	//the first sync is where we join the session
+	if (!rollbackSession.IsStarted())
+	{
+		if (myID < 0)
+		{
+			return;
+		}
+		rollbackSession.Start(myID, syncState.frame);
+	}
 
-	SteamDatagramErrMsg errMsg;
-	if (!SteamDatagramClient_Init(errMsg))
-		FatalError("SteamDatagramClient_Init failed.  %s", errMsg);
+	rollbackSession.ApplySyncState(syncState);
+}
 
-	// Disable authentication when running with Steam, for this
-	// example, since we're not a real app.
-	//
-	// Authentication is disabled automatically in the open-source
-	// version since we don't have a trusted third party to issue
-	// certs.
-	SteamNetworkingUtils()->SetGlobalConfigValueInt32(k_ESteamNetworkingConfig_IP_AllowWithoutAuth, 1);
-#endif
+//what the server does with each message type, in MessageType order
+static const MessageHandlerEntry serverHandlers[MESSAGE_TYPE_COUNT] =
+{
+	{ 0, nullptr },									//MESSAGE_ASSIGN_ID
+	{ 0, nullptr },									//MESSAGE_BASELINE
+	{ NETWORK_PACKET_SIZE + 12, ServerHandlePlayerState },	//MESSAGE_PLAYER_STATE
+	{ 0, nullptr },									//MESSAGE_SNAPSHOT
+	{ 6, ServerHandleRollbackInput },					//MESSAGE_ROLLBACK_INPUT
+	{ 0, nullptr },									//MESSAGE_ROLLBACK_SYNC
+	{ 0, nullptr },									//MESSAGE_ZONE_HELLO
+	{ 0, nullptr },									//MESSAGE_ZONE_ROUTE
+	{ 0, nullptr },									//MESSAGE_ZONE_HANDOFF
+	{ 0, nullptr },									//MESSAGE_ZONE_MIRROR
+	{ 0, nullptr },									//MESSAGE_ZONE_STATE
+	{ 0, nullptr },									//MESSAGE_ZONE_REMOVE
+	{ 0, ServerHandleSubscribe },						//MESSAGE_SUBSCRIBE
+	{ 8, ServerHandleResume },						//MESSAGE_RESUME
+	{ 0, nullptr },									//MESSAGE_BASELINE_DELTA
+	{ 0, nullptr },									//MESSAGE_JOIN_QUEUE
+	{ 4, ServerHandleCodecOffer },					//MESSAGE_CODEC_OFFER
+	{ 0, nullptr },									//MESSAGE_SNAPSHOT_PACKED
+	{ 2, ServerHandleGameEvents },					//MESSAGE_GAME_EVENTS
+	{ 0, nullptr },									//MESSAGE_POSITION_CORRECTION
+};
+
+//what the client does with each message type, in MessageType order
+static const MessageHandlerEntry clientHandlers[MESSAGE_TYPE_COUNT] =
+{
+	{ 9, ClientHandleAssignID },						//MESSAGE_ASSIGN_ID
+	{ 5, ClientHandleBaseline },						//MESSAGE_BASELINE
+	{ 0, nullptr },									//MESSAGE_PLAYER_STATE
+	{ NETWORK_SNAPSHOT_HEADER_SIZE, ClientHandleSnapshot },	//MESSAGE_SNAPSHOT
+	{ 6, ClientHandleRollbackInput },					//MESSAGE_ROLLBACK_INPUT
+	{ ROLLBACK_STATE_INTS * 4, ClientHandleRollbackSync },	//MESSAGE_ROLLBACK_SYNC
+	{ 0, nullptr },									//MESSAGE_ZONE_HELLO
+	{ 0, nullptr },									//MESSAGE_ZONE_ROUTE
+	{ 0, nullptr },									//MESSAGE_ZONE_HANDOFF
+	{ 0, nullptr },									//MESSAGE_ZONE_MIRROR
+	{ 0, nullptr },									//MESSAGE_ZONE_STATE
+	{ 0, nullptr },									//MESSAGE_ZONE_REMOVE
+	{ 0, nullptr },									//MESSAGE_SUBSCRIBE
+	{ 0, nullptr },									//MESSAGE_RESUME
+	{ 5, ClientHandleBaselineDelta },					//MESSAGE_BASELINE_DELTA
+	{ 4, ClientHandleJoinQueue },						//MESSAGE_JOIN_QUEUE
+	{ 4, ClientHandleCodecOffer },					//MESSAGE_CODEC_OFFER
+	{ 9, ClientHandleSnapshotPacked },				//MESSAGE_SNAPSHOT_PACKED
+	{ 2, ClientHandleGameEvents },					//MESSAGE_GAME_EVENTS
+	{ 8, ClientHandlePositionCorrection },			//MESSAGE_POSITION_CORRECTION
+};
 
-	g_logTimeZero = SteamNetworkingUtils()->GetLocalTimestamp();
+bool DispatchNetworkMessage(const MessageHandlerEntry* handlers, const ISteamNetworkingMessage* pMsg)
+{
+	AddCounter(metricMessagesReceived, 1);
+	AddCounter(metricBytesReceived, pMsg->m_cbSize);
 
-	SteamNetworkingUtils()->SetDebugOutputFunction(k_ESteamNetworkingSocketsDebugOutputType_Msg, DebugOutput);
+	if (pMsg->m_cbSize < NETWORK_HEADER_SIZE)
+	{
+		return false;
+	}
 
-	//
-	// Application Loop
-	//
+	const unsigned char* data = (const unsigned char*)pMsg->m_pData;
+	if (data[0] >= MESSAGE_TYPE_COUNT || data[1] != NETWORK_PROTOCOL_VERSION)
+	{
+		return false;
+	}
 
-	if (bClient)
+	const MessageHandlerEntry& entry = handlers[data[0]];
+	int payloadSize = pMsg->m_cbSize - NETWORK_HEADER_SIZE;
+	if (entry.handler == nullptr || payloadSize < entry.minPayloadSize)
 	{
-		myClient = new NetworkClient;
-		myClient->Run(addrServer);
+		return false;
 	}
-	else
+
+	entry.handler(pMsg, (const char*)data + NETWORK_HEADER_SIZE, payloadSize);
+	return true;
+}
+
+EResult SendNetworkMessage(HSteamNetConnection conn, const void* data, uint32 size, int sendFlags)
+{
+	AllocationAuditPause pause; //the library queues a copy, see alloc_audit.h
+	AddCounter(metricMessagesSent, 1);
+	AddCounter(metricBytesSent, size);
+	return m_pInterface->SendMessageToConnection(conn, data, size, sendFlags, nullptr);
+}
+
+void SendNetworkMessages(int count, SteamNetworkingMessage_t* const* messages, int64* outResults)
+{
+	//the messages belong to the library once they're sent, so count them first
+	unsigned long long bytes = 0;
+	for (int i = 0; i < count; i++)
 	{
-		myServer = new NetworkServer;
-		myServer->Run((uint16)nPort);
+		bytes += messages[i]->m_cbSize;
 	}
+	AddCounter(metricMessagesSent, count);
+	AddCounter(metricBytesSent, bytes);
 
-	return 0;
+	AllocationAuditPause pause;
+	m_pInterface->SendMessages(count, messages, outResults);
 }
 
-void startSession(const char* argument)
+//steps the rollback simulation up to the current frame on the shared server timeline,
+//sending our input for every frame we step
+void UpdateRollback()
 {
-	//split the string
-	std::istringstream iss(argument);
-	std::vector<std::string> tokens;
-	std::string token;
-	while (iss >> token) {
-		tokens.push_back(token);
+	if (!rollbackSession.IsStarted() || !IsServerTimeSynced())
+	{
+		return;
 	}
 
-	// build const char* array
-	std::vector<const char*> argv;
-	for (auto& t : tokens) {
-		argv.push_back(t.c_str());
+	int targetFrame = (int)(GetServerTime() * ROLLBACK_TICK_RATE);
+	bool bPlaying = myID >= 0 && myID < ROLLBACK_MAX_PLAYERS;
+
+	//resolves any rollback even if no new frame is due
+	rollbackSession.Advance(rollbackSession.GetCurrentFrame());
+
+	while (rollbackSession.GetCurrentFrame() < targetFrame)
+	{
+		int frame = rollbackSession.GetCurrentFrame();
+		if (bPlaying)
+		{
+			frame = rollbackSession.AddLocalInput(pendingRollbackInput);
+			unsigned char input = pendingRollbackInput | ROLLBACK_INPUT_PRESENT;
+
+			if (networkStatus == SERVER_ACTIVE)
+			{
+				for (auto& client : m_Clients)
+				{
+					if (!client.bSubscriber)
+					{
+						SendRollbackInput(client.conn, myID, frame, input);
+					}
+				}
+			}
+			else
+			{
+				SendRollbackInput(m_hConnection, myID, frame, input);
+			}
+		}
+
+		rollbackSession.Advance(frame + 1);
 	}
+}
 
-	//get the amount of args
-	int argc = static_cast<int>(argv.size());
+//host only, sends everyone the newest state every player's input has been confirmed for
+void SendRollbackSync(SteamNetworkingMicroseconds now)
+{
+	if (now - lastRollbackSyncTime < NETWORK_ROLLBACK_SYNC_INTERVAL || m_Clients.empty())
+	{
+		return;
+	}
 
-	startSessionFromArgument(argc, argv.data());
+	const RollbackState* syncState = rollbackSession.GetHistoryState(rollbackSession.GetConfirmedFrame() + 1);
+	if (syncState == nullptr)
+	{
+		return;
+	}
+	lastRollbackSyncTime = now;
+
+	char message[NETWORK_HEADER_SIZE + ROLLBACK_STATE_INTS * 4];
+	WriteMessageHeader(MESSAGE_ROLLBACK_SYNC, message);
+	const int* stateInts = (const int*)syncState;
+	for (int i = 0; i < ROLLBACK_STATE_INTS; i++)
+	{
+		SerializeInt(stateInts[i], message + NETWORK_HEADER_SIZE + i * 4);
+	}
+
+	for (auto& client : m_Clients)
+	{
+		if (!client.bSubscriber)
+		{
+			SendNetworkMessage(client.conn, message, sizeof(message), k_nSteamNetworkingSend_Reliable);
+		}
+	}
 }
 
-void StartServer()
+//works out which clients can't keep up, on the main thread as it asks the network
+//a slow client's unreliable queue would otherwise grow and every snapshot behind it gets later,
+//skipping ticks keeps the delay bounded and newest-wins on the client covers the gap
+void UpdateBackpressure()
 {
-	networkStatus = SERVER_STARTING;
-	startSession("server --port 7777");
+	for (auto& client : m_Clients)
+	{
+		SteamNetConnectionRealTimeStatus_t status;
+		SteamNetConnectionRealTimeLaneStatus_t laneStatus[NETWORK_LANE_COUNT];
+		PauseAllocationAudit();
+		EResult result = m_pInterface->GetConnectionRealTimeStatus(client.conn, &status, NETWORK_LANE_COUNT, laneStatus);
+		ResumeAllocationAudit();
+		if (result != k_EResultOK)
+		{
+			client.bBackedUp = false;
+			continue;
+		}
+
+		const SteamNetConnectionRealTimeLaneStatus_t& updateLane = laneStatus[NETWORK_LANE_UPDATES];
+		bool bBackedUp = updateLane.m_cbPendingUnreliable > NETWORK_MAX_PENDING_SNAPSHOT_BYTES
+			|| updateLane.m_usecQueueTime > NETWORK_MAX_SNAPSHOT_QUEUE_TIME;
+
+		if (bBackedUp && !client.bBackedUp)
+		{
+			Printf("Client %d is backed up (%d bytes, %d ms queued), skipping snapshots", client.id,
+				updateLane.m_cbPendingUnreliable, (int)(updateLane.m_usecQueueTime / 1000));
+		}
+		else if (!bBackedUp && client.bBackedUp)
+		{
+			Printf("Client %d caught up, %u snapshots skipped so far", client.id, client.droppedSnapshots);
+		}
+
+		client.bBackedUp = bBackedUp;
+		if (bBackedUp)
+		{
+			client.droppedSnapshots++;
+			droppedSnapshots++;
+		}
+	}
 }
 
-void StartClient()
+//everything the server sends at the end of a tick, kept between ticks so it's only ever grown
+std::vector<SteamNetworkingMessage_t*> tickMessages;
+
+//a job system range of clients' snapshots, each client only ever touches their own entry
+static void BuildSnapshotRange(int begin, int end, void* data)
 {
-	networkStatus = CLIENT_STARTING;
-	startSession("client 127.0.0.1:7777");
+	AddAllocationAuditThread();
+	for (int i = begin; i < end; i++)
+	{
+		tickMessages[i] = BuildSnapshotMessage(m_Clients[i]);
+	}
 }
 
 void UpdateServer()
 {
+	SteamNetworkingMicroseconds tickStart = SteamNetworkingUtils()->GetLocalTimestamp();
+
+	//resume slots running out, join queue updates
+	serverTimers.Advance(tickStart);
+
+	//let some of the join queue in before reading messages, so anything they sent while waiting is handled this tick
+	myServer->AdmitPendingJoins(SteamNetworkingUtils()->GetLocalTimestamp());
+
 	while (true)
 	{
 		ISteamNetworkingMessage* pIncomingMsg = nullptr;
+		PauseAllocationAudit();
 		int numMsgs = m_pInterface->ReceiveMessagesOnPollGroup(m_hPollGroup, &pIncomingMsg, 1);
+		ResumeAllocationAudit();
 		if (numMsgs == 0)
 			break;
 		if (numMsgs < 0)
 			FatalError("Error checking for messages");
 		assert(numMsgs == 1 && pIncomingMsg);
-		auto itClient = std::find(m_Clients.begin(), m_Clients.end(), pIncomingMsg->m_conn);
-		assert(itClient != m_Clients.end());
+		assert(FindClient(pIncomingMsg->m_conn) != m_Clients.end());
 
-		// '\0'-terminate it to make it easier to parse
-		// Assume it's a c-string and print it as-is
-		std::string sCmd;
+		if (!DispatchNetworkMessage(serverHandlers, pIncomingMsg))
+		{
+			Printf("Dropped a malformed message (%d bytes)", pIncomingMsg->m_cbSize);
+		}
 
-		// Populate a std::string with the data we received, assuming it's a character array
-		sCmd.assign((const char*)pIncomingMsg->m_pData, pIncomingMsg->m_cbSize);
+		//their first message wasn't a successful resume, so they're new here
+		//a codec offer comes before anything else and doesn't count
+		auto itClient = FindClient(pIncomingMsg->m_conn);
+		bool bCodecOffer = pIncomingMsg->m_cbSize > 0 && ((const char*)pIncomingMsg->m_pData)[0] == MESSAGE_CODEC_OFFER;
+		if (itClient != m_Clients.end() && !itClient->bWelcomed && !bCodecOffer)
+		{
+			myServer->WelcomeClient(*itClient);
+		}
 
 		// We don't need this anymore.
 		pIncomingMsg->Release();
+	}
 
-		const char* cmd = sCmd.c_str();
-		//Printf(cmd);
-
-		DataPacket incomingDataPacket = DeserializeDataPacket(cmd);
+	SteamNetworkingMicroseconds now = SteamNetworkingUtils()->GetLocalTimestamp();
 
-		clientPositions[incomingDataPacket.id] = { incomingDataPacket.posX, incomingDataPacket.posY };
+	//a cluster front is headless, so it has no player of its own
+	if (zoneFront != nullptr)
+	{
+		zoneFront->Update();
 	}
+	else
+	{
+		UpdatePacketVelocity(now);
+		clientPositions[0] = { { myPacket.posX, myPacket.posY }, { myPacket.velX, myPacket.velY }, now };
+
+		//rollback players move by their own deterministic step, the positions they send are only a heartbeat
+		if (networkMode == NETWORK_MODE_STATE_SYNC)
+		{
+			UpdateSimulatedPlayers(now);
+			StepMovement(now);
+		}
 
-	clientPositions[0] = { myPacket.posX, myPacket.posY };
+		SaveWorldCheckpoint(now);
+	}
 
 	//
 	// Poll Callbacks
 	//
 
-	//send data to clients
-	for (auto client : m_Clients)
+	if (networkMode == NETWORK_MODE_ROLLBACK)
 	{
-		//in clientPos, first means its ID and second means its position
-		for (auto& clientPos : clientPositions)
-		{
-			DataPacket curClientPacket;
-			curClientPacket.id = clientPos.first;
-			curClientPacket.posX = clientPos.second.x;
-			curClientPacket.posY = clientPos.second.y;
+		UpdateRollback();
+		SendRollbackSync(now);
+	}
+
+	//gather the world once for every client's snapshot
+	//rollback mode only exchanges inputs, so there's nothing to gather
+	std::vector<DataPacket>& snapshotEntities = worldHistory[++worldTick % NETWORK_WORLD_HISTORY];
+	snapshotEntities.clear();
+	if (networkMode != NETWORK_MODE_ROLLBACK)
+	{
+		GatherWorldEntities(now, snapshotEntities);
+	}
 
-			char serializedPacket[NETWORK_PACKET_SIZE];
-			SerializeDataPacket(curClientPacket, serializedPacket);
+	snapshotTime = SteamNetworkingUtils()->GetLocalTimestamp();
 
-			//myServer->SendStringToClient(client, serializedPacket);
-			m_pInterface->SendMessageToConnection(client, serializedPacket, NETWORK_PACKET_SIZE, 
-				k_nSteamNetworkingSend_Unreliable, nullptr);
-		}
-		
+	if (snapshotCaptureFile != nullptr && networkMode != NETWORK_MODE_ROLLBACK)
+	{
+		CaptureSnapshot(snapshotEntities);
+	}
+
+	UpdateBackpressure();
+
+	//build a snapshot per client, spread over the job system's workers when there are enough of them
+	int numClients = (int)m_Clients.size();
+	tickMessages.assign(numClients, nullptr);
+	if (numClients >= NETWORK_PARALLEL_SNAPSHOT_MIN_CLIENTS && GetJobWorkerCount() > 0)
+	{
+		ParallelFor(numClients, 0, BuildSnapshotRange, nullptr);
+	}
+	else
+	{
+		BuildSnapshotRange(0, numClients, nullptr);
+	}
+
+	//along with everyone's game events from this tick, and where we've moved anyone to
+	for (ClientConnection& client : m_Clients)
+	{
+		tickMessages.push_back(client.events.Flush(client.conn));
+		tickMessages.push_back(BuildCorrectionMessage(client, now));
+	}
+
+	//then hand them all to the network in one go
+	tickMessages.erase(std::remove(tickMessages.begin(), tickMessages.end(), nullptr), tickMessages.end());
+	if (!tickMessages.empty())
+	{
+		SendNetworkMessages((int)tickMessages.size(), tickMessages.data(), nullptr);
 	}
-	
 
+	PauseAllocationAudit(); //anything our callbacks allocate is a connection coming or going, which resets the audit
 	m_pInterface->RunCallbacks();
+	ResumeAllocationAudit();
 
+	SetGauge(metricConnections, (double)m_Clients.size());
+	ObserveHistogram(metricTickSeconds, (SteamNetworkingUtils()->GetLocalTimestamp() - tickStart) * 1e-6);
 }
 
 void UpdateClient()
 {
+	//lost the server, keep knocking until it's back
+	if (m_hConnection == k_HSteamNetConnection_Invalid)
+	{
+		myClient->Reconnect();
+		PauseAllocationAudit();
+		m_pInterface->RunCallbacks();
+		ResumeAllocationAudit();
+		return;
+	}
+
 	while (true)
 	{
 		ISteamNetworkingMessage* pIncomingMsg = nullptr;
+		PauseAllocationAudit();
 		int numMsgs = m_pInterface->ReceiveMessagesOnConnection(m_hConnection, &pIncomingMsg, 1);
+		ResumeAllocationAudit();
 		// Nothing? Do nothing.
 		if (numMsgs == 0)
 			break;
@@ -696,21 +2752,9 @@ void UpdateClient()
 			FatalError("Error checking for messages");
 		else
 		{
-			//is this an id packet?
-			char* message = (char*)pIncomingMsg->m_pData;
-			if (message == nullptr)
-			{
-				break;
-			}
-			if(message[0] == 'I' && message[1] == 'D')
-			{
-				//set the ID
-				myID = message[2];
-			}
-			else
+			if (!DispatchNetworkMessage(clientHandlers, pIncomingMsg))
 			{
-				DataPacket incomingPacket = DeserializeDataPacket(message);
-				clientPositions[incomingPacket.id] = { incomingPacket.posX, incomingPacket.posY };
+				Printf("Dropped a malformed message (%d bytes)", pIncomingMsg->m_cbSize);
 			}
 
 			// Just echo anything we get from the server
@@ -722,28 +2766,66 @@ void UpdateClient()
 		}
 	}
 
+	PauseAllocationAudit();
 	m_pInterface->RunCallbacks();
+	ResumeAllocationAudit();
+
+	SteamNetworkingMicroseconds now = SteamNetworkingUtils()->GetLocalTimestamp();
+	UpdatePacketVelocity(now);
+
+	if (!bServerConnected)
+	{
+		return;
+	}
+
+	//everything the game raised this frame, in one message
+	SteamNetworkingMessage_t* pEventsMsg = outgoingEvents.Flush(m_hConnection);
+	if (pEventsMsg != nullptr)
+	{
+		SendNetworkMessages(1, &pEventsMsg, nullptr);
+	}
+
+	if (networkMode == NETWORK_MODE_ROLLBACK)
+	{
+		UpdateRollback();
+
+		//positions come from the simulation, the state packet is only a heartbeat for clock sync
+		if (lastSentTime != 0 && now - lastSentTime < NETWORK_HEARTBEAT_INTERVAL)
+		{
+			return;
+		}
+	}
+	//everyone else dead-reckons us from our last packet, so only send when that goes stale
+	else if (!ShouldSendPacket(now))
+	{
+		return;
+	}
+
+	char serialPacket[NETWORK_HEADER_SIZE + NETWORK_PACKET_SIZE + 12];
+	WriteMessageHeader(MESSAGE_PLAYER_STATE, serialPacket);
+	SerializeDataPacket(myPacket, serialPacket + NETWORK_HEADER_SIZE);
 
-	std::string DebugMessage = "Client message";
+	//stamp it so the server can echo it back for clock sync
+	SerializeInt64(SteamNetworkingUtils()->GetLocalTimestamp(), serialPacket + NETWORK_HEADER_SIZE + NETWORK_PACKET_SIZE);
 
-	// Send it to the server and let them parse it
-	//m_pInterface->SendMessageToConnection(m_hConnection, DebugMessage.c_str(),
-	//	(uint32)DebugMessage.length(), k_nSteamNetworkingSend_Reliable, nullptr);
+	//and ack the newest snapshot, so if we drop it knows what we've already got
+	SerializeInt((int)lastSnapshotSequence, serialPacket + NETWORK_HEADER_SIZE + NETWORK_PACKET_SIZE + 8);
 
-	char serialPacket[NETWORK_PACKET_SIZE];
-	SerializeDataPacket(myPacket, serialPacket);
+	SendNetworkMessage(m_hConnection, serialPacket,
+		sizeof(serialPacket), k_nSteamNetworkingSend_Unreliable);
 
-	m_pInterface->SendMessageToConnection(m_hConnection, serialPacket,
-		NETWORK_PACKET_SIZE, k_nSteamNetworkingSend_Unreliable, nullptr);
+	lastSentPacket = myPacket;
+	lastSentTime = now;
 
 }
 
 void CloseServer()
 {
 	networkStatus = INACTIVE;
+	receivedEvents.Clear();
 	// Close all the connections
 	Printf("Closing connections...\n");
-	for (auto it : m_Clients)
+	for (auto& it : m_Clients)
 	{
 		// Send them one more goodbye message.  Note that we also have the
 		// connection close reason as a place to send final data.  However,
@@ -753,10 +2835,34 @@ void CloseServer()
 
 		// Close the connection.  We use "linger mode" to ask SteamNetworkingSockets
 		// to flush this out and close gracefully.
-		m_pInterface->CloseConnection(it, 0, "Server Shutdown", true);
+		m_pInterface->CloseConnection(it.conn, 0, "Server Shutdown", true);
 	}
 	m_Clients.clear();
 
+	for (auto& join : pendingJoins)
+	{
+		m_pInterface->CloseConnection(join.conn, 0, "Server Shutdown", false);
+	}
+	pendingJoins.clear();
+	reservedSlots.clear();
+
+	//a clean shutdown leaves nobody to restore
+	worldCheckpoint.ClearAll();
+	worldCheckpoint.Close();
+
+	if (snapshotCaptureFile != nullptr)
+	{
+		fclose(snapshotCaptureFile);
+		snapshotCaptureFile = nullptr;
+	}
+
+	if (zoneFront != nullptr)
+	{
+		zoneFront->Close();
+		delete zoneFront;
+		zoneFront = nullptr;
+	}
+
 	m_pInterface->CloseListenSocket(m_hListenSock);
 	m_hListenSock = k_HSteamListenSocket_Invalid;
 
@@ -781,15 +2887,17 @@ void CloseServer()
 	SteamDatagramClient_Kill();
 #endif
 
-	// Ug, why is there no simple solution for portable, non-blocking console user input?
-	// Just nuke the process
-	//LocalUserInput_Kill();
-	NukeProcess(0);
+	myServer = nullptr;
+
+	//the process carries on, so whoever closed us can still report and clean up (--bench prints its results after)
+	FlushAsyncLog();
 }
 
 void CloseClient()
 {
 	networkStatus = INACTIVE;
+	outgoingEvents.Clear();
+	receivedEvents.Clear();
 	// Close the connection gracefully.
 	// We use linger mode to ask for any remaining reliable data
 	// to be flushed out.  But remember this is an application
@@ -815,57 +2923,180 @@ void CloseClient()
 	SteamDatagramClient_Kill();
 #endif
 
-	// Ug, why is there no simple solution for portable, non-blocking console user input?
-	// Just nuke the process
-	//LocalUserInput_Kill();
-	NukeProcess(0);
+	myClient = nullptr;
+
+	//the process carries on, so the game can unload and close its window after
+	FlushAsyncLog();
+}
+
+//only a settled session's ticks are expected not to allocate, see alloc_audit.h
+static void CheckAllocationAudit(int allocations)
+{
+	bool bSettled = networkStatus == SERVER_ACTIVE || (networkStatus == CLIENT_ACTIVE && bServerConnected);
+	settledTicks = bSettled ? settledTicks + 1 : 0;
+	if (allocations > 0 && settledTicks > ALLOCATION_AUDIT_SETTLE_TICKS)
+	{
+		AsyncLog(ASYNC_LOG_ERROR, "A steady state network tick made %d heap allocations", allocations);
+		FlushAsyncLog();
+		assert(!"steady state network tick allocated");
+	}
 }
 
 void UpdateNetwork()
 {
+	//never blocks, it just skips the update until the session exists
+	if (!PollSessionStartup())
+	{
+		return;
+	}
+
+	UpdateNetworkConditions();
+
+	BeginAllocationAudit();
 	switch (networkStatus)
 	{
 	case SERVER_ACTIVE:
 		UpdateServer();
 		break;
+	case CLIENT_STARTING: //still connecting, the callbacks still need running
 	case CLIENT_ACTIVE:
 		UpdateClient();
 		break;
 	default:
 		break;
 	}
+	CheckAllocationAudit(EndAllocationAudit());
 }
 
 void CloseNetwork()
 {
+	//quitting while it's still starting up, wait for the init to finish so the thread isn't left running
+	if (startupThread.joinable())
+	{
+		startupThread.join();
+	}
+
 	switch (networkStatus)
 	{
 	case SERVER_ACTIVE:
 		CloseServer();
 		break;
+	case CLIENT_STARTING:
 	case CLIENT_ACTIVE:
-		CloseServer();
+		if (myClient != nullptr)
+		{
+			CloseClient();
+		}
 		break;
 	default:
 		break;
 	}
 }
 
+void SetNetworkMode(enum NetworkMode mode)
+{
+	//can't change how we sync once a session is running
+	if (networkStatus == INACTIVE)
+	{
+		networkMode = mode;
+	}
+}
+
+void SetSimulatedPlayers(int count)
+{
+	//bots only stand in for players whose positions the server is sent
+	if (networkStatus == INACTIVE && networkMode == NETWORK_MODE_STATE_SYNC)
+	{
+		simulatedPlayers = std::min(std::max(count, 0), NETWORK_MAX_ENTITIES - 1);
+	}
+}
+
+void DisableWorldCheckpoint()
+{
+	if (networkStatus == INACTIVE)
+	{
+		bCheckpointDisabled = true;
+	}
+}
+
+enum NetworkMode GetNetworkMode()
+{
+	return networkMode;
+}
+
+void UpdatePacketInput(unsigned char input)
+{
+	pendingRollbackInput = input & (NETWORK_INPUT_RIGHT | NETWORK_INPUT_LEFT | NETWORK_INPUT_UP | NETWORK_INPUT_DOWN);
+}
+
 int GetClientCount()
 {
+	if (networkMode == NETWORK_MODE_ROLLBACK)
+	{
+		const RollbackState& state = rollbackSession.GetState();
+		int activeCount = 0;
+		for (int player = 0; player < ROLLBACK_MAX_PLAYERS; player++)
+		{
+			activeCount += state.active[player] ? 1 : 0;
+		}
+		return activeCount;
+	}
+
 	//return m_Clients.size();
 	return clientPositions.size();
 }
 
 Vector2Int GetClientPosition(int clientID)
 {
+	if (networkMode == NETWORK_MODE_ROLLBACK)
+	{
+		const RollbackState& state = rollbackSession.GetState();
+		if (clientID < 0 || clientID >= ROLLBACK_MAX_PLAYERS || !state.active[clientID])
+		{
+			return { 0, 0 };
+		}
+		return { state.posX[clientID], state.posY[clientID] };
+	}
+
 	//make sure client id is valid
-	if (clientID > GetClientCount())
+	auto itClient = clientPositions.find(clientID);
+	if (itClient == clientPositions.end())
 	{
 		return { 0, 0 };
 	}
 
-	return clientPositions[clientID];
+	return ExtrapolatePosition(itClient->second, SteamNetworkingUtils()->GetLocalTimestamp());
+}
+
+int GetClientPositions(DataPacket* outClients, int maxClients)
+{
+	int count = 0;
+	if (networkMode == NETWORK_MODE_ROLLBACK)
+	{
+		const RollbackState& state = rollbackSession.GetState();
+		for (int player = 0; player < ROLLBACK_MAX_PLAYERS && count < maxClients; player++)
+		{
+			if (state.active[player])
+			{
+				outClients[count++] = { (char)player, state.posX[player], state.posY[player], 0, 0 };
+			}
+		}
+		return count;
+	}
+
+	//one timestamp for everyone, so they're all drawn as of the same moment
+	SteamNetworkingMicroseconds now = SteamNetworkingUtils()->GetLocalTimestamp();
+	for (const auto& entity : clientPositions)
+	{
+		if (count >= maxClients)
+		{
+			break;
+		}
+
+		Vector2Int position = ExtrapolatePosition(entity.second, now);
+		outClients[count++] = { (char)entity.first, position.x, position.y, entity.second.velocity.x, entity.second.velocity.y };
+	}
+	return count;
 }
 
 enum NetworkStatus GetNetworkStatus()
@@ -873,7 +3104,78 @@ enum NetworkStatus GetNetworkStatus()
 	return networkStatus;
 }
 
+int GetJoinQueuePosition()
+{
+	return joinQueuePosition;
+}
+
+bool PollPositionCorrection(Vector2Int* outPosition)
+{
+	if (!bPositionCorrected)
+	{
+		return false;
+	}
+
+	*outPosition = correctedPosition;
+	bPositionCorrected = false;
+	return true;
+}
+
+bool SendGameEvent(const GameEvent* event)
+{
+	if (networkStatus == SERVER_ACTIVE)
+	{
+		GameEvent stamped = *event;
+		stamped.player = myID;
+		BroadcastGameEvent(stamped, k_HSteamNetConnection_Invalid);
+		return true;
+	}
+
+	//only while connected, there's nowhere to keep them while we're reconnecting
+	if (networkStatus == CLIENT_ACTIVE && bServerConnected)
+	{
+		char encoded[GAME_EVENT_MAX_ENCODED_SIZE];
+		int size = EncodeGameEvent(*event, encoded);
+		QueueGameEvent(m_hConnection, outgoingEvents, encoded, size);
+		return true;
+	}
+	return false;
+}
+
+bool PollGameEvent(GameEvent* outEvent)
+{
+	return receivedEvents.Pop(*outEvent);
+}
+
 int GetMyID()
 {
 	return myID;
+}
+
+unsigned int GetDroppedSnapshotCount()
+{
+	return droppedSnapshots;
+}
+
+double GetServerTime()
+{
+	SteamNetworkingMicroseconds localTime = SteamNetworkingUtils()->GetLocalTimestamp();
+
+	//the server's own clock is the timeline
+	if (networkStatus == SERVER_ACTIVE)
+	{
+		return localTime * 1e-6;
+	}
+
+	return (localTime + serverClockOffset) * 1e-6;
+}
+
+float GetServerRoundTripTime()
+{
+	return (float)(smoothedRoundTrip * 1e-3);
+}
+
+bool IsServerTimeSynced()
+{
+	return networkStatus == SERVER_ACTIVE || clockSynced;
 }
\ No newline at end of file
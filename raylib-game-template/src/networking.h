@@ -1,3 +1,5 @@
+#include <stdbool.h>
+
 typedef struct Vector2Int
 {
 	int x;
@@ -8,6 +10,8 @@ typedef struct DataPacket
 	char id;
 	int posX;
 	int posY;
+	int velX; //pixels per second, used to dead-reckon between packets
+	int velY;
 } DataPacket;
 
 
@@ -18,14 +22,89 @@ extern "C" {
 enum NetworkStatus
 {
 	INACTIVE,
-	SERVER_STARTING,
+	SERVER_STARTING,	//networking library starting up in the background
 	SERVER_ACTIVE,
-	CLIENT_STARTING,
-	CLIENT_ACTIVE
+	CLIENT_STARTING,	//networking library starting up, or connecting to the server
+	CLIENT_ACTIVE,		//connected
+	NETWORK_FAILED		//the networking library couldn't start, see the console
+};
+
+//how the world is kept in sync
+enum NetworkMode
+{
+	NETWORK_MODE_STATE_SYNC,	//clients send positions, the server sends everyone snapshots
+	NETWORK_MODE_ROLLBACK		//peers only send inputs and run the same deterministic simulation
+};
+
+//input bits for UpdatePacketInput
+#define NETWORK_INPUT_RIGHT 0x01
+#define NETWORK_INPUT_LEFT 0x02
+#define NETWORK_INPUT_UP 0x04
+#define NETWORK_INPUT_DOWN 0x08
+
+//most entities the world can hold, IDs are a char on the wire
+#define NETWORK_MAX_ENTITIES 128
+
+//the world players move around in, the server holds everyone to it (see movement.h)
+#define NETWORK_WORLD_WIDTH 800
+#define NETWORK_WORLD_HEIGHT 450
+#define NETWORK_PLAYER_SIZE 20 //players are squares, positions are their top left corner
+#define NETWORK_PLAYER_SPEED 300 //pixels per second on each axis, 5 a frame at 60 frames per second
+
+//the ID a spectator relay gives its spectators, they aren't in the world
+#define NETWORK_SPECTATOR_ID -1
+
+//reliable gameplay events, see game_events.h
+#define GAME_EVENT_MAX_TEXT 120 //chat characters, not counting the terminator
+
+enum GameEventType
+{
+	GAME_EVENT_SPAWN,	//player appeared at x, y
+	GAME_EVENT_PICKUP,	//player picked up item at x, y
+	GAME_EVENT_CHAT,	//player said text
+
+	GAME_EVENT_TYPE_COUNT
 };
+
+//something solid in the world, nobody can stand in one
+typedef struct WorldBox
+{
+	int x;
+	int y;
+	int width;
+	int height;
+} WorldBox;
+
+typedef struct GameEvent
+{
+	enum GameEventType type;
+	int player; //set by the server from the connection it came in on, whatever the sender claims
+	int x;
+	int y;
+	int item;
+	char text[GAME_EVENT_MAX_TEXT + 1];
+} GameEvent;
+
+	//called before the session is started, defaults to state sync
+	void SetNetworkMode(enum NetworkMode mode);
+
+	//called before the session is started, picks up any --sim-* options (see net_conditions.h)
+	void ConfigureNetworkConditions(int argc, char** argv);
+	enum NetworkMode GetNetworkMode();
+
+	//called before the server is started, it moves count bots around the world as if they were players
+	//state sync only, they take the highest IDs so real players can still join, used by --bench
+	void SetSimulatedPlayers(int count);
+
+	//called before the server is started, it neither restores nor writes the world checkpoint,
+	//so a run isn't changed by players a previous one left behind, used by --bench
+	void DisableWorldCheckpoint();
+
 	//called when game scene is started
+	//these return straight away, the session is started in the background, watch GetNetworkStatus
 	void StartServer();
 	void StartClient();
+	void StartSpectator(); //watch through a spectator relay, see spectator_relay.h
 
 	//called in main update loop
 	void UpdateNetwork();
@@ -33,10 +112,56 @@ enum NetworkStatus
 
 	//called in screen_gameplay
 	void UpdatePacketPosition(int posX, int posY);
+	void UpdatePacketInput(unsigned char input); //rollback mode, NETWORK_INPUT_* bits held this frame
 	int GetClientCount();
 	Vector2Int GetClientPosition(int clientID);
+	//every player in the world where they should be now, in one pass, returns how many were written
+	//positions are extrapolated, velocities are the last ones we were sent
+	int GetClientPositions(DataPacket* outClients, int maxClients);
 	enum NetworkStatus GetNetworkStatus();
 	int GetMyID();
+	int GetJoinQueuePosition(); //the server is letting players in gradually and we're waiting, 0 once we're in
+
+	//the server moved us, out of someone or something or back to where we could have got to
+	//returns false if it hasn't since last time
+	bool PollPositionCorrection(Vector2Int* outPosition);
+	//the world's obstacles, the same everywhere, returns how many there are
+	int GetWorldObstacles(const WorldBox** outBoxes);
+
+	//queued and sent with everything else this tick as one reliable message per connection
+	//the server sends to every player, a client sends to the server which passes it on to everyone else
+	//returns false if there's no session to send it on
+	bool SendGameEvent(const GameEvent* event);
+	//events from other players in the order they were sent, returns false once there are none left
+	bool PollGameEvent(GameEvent* outEvent);
+
+	//shared server timeline, for interpolation and lag compensation
+	double GetServerTime(); //seconds on the server's clock
+	float GetServerRoundTripTime(); //smoothed round trip to the server in milliseconds
+	bool IsServerTimeSynced(); //false until the first round trip completes
+
+	//server, snapshots skipped because a client's send queue was backed up
+	unsigned int GetDroppedSnapshotCount();
+
+	//headless zone cluster processes (--cluster, --zone, --front), see zone_cluster.h
+	//returns the process exit code, or -1 if the command line doesn't ask for one
+	int RunClusterProcess(int argc, char** argv);
+
+	//headless spectator relay process (--relay), see spectator_relay.h
+	//returns the process exit code, or -1 if the command line doesn't ask for one
+	int RunRelayProcess(int argc, char** argv);
+
+	//headless snapshot decoder benchmark (--bench-decode), see entity_decode.h
+	//returns the process exit code, or -1 if the command line doesn't ask for one
+	int RunDecodeBenchmark(int argc, char** argv);
+
+	//headless movement step benchmark (--bench-movement), see movement.h
+	//returns the process exit code, or -1 if the command line doesn't ask for one
+	int RunMovementBenchmark(int argc, char** argv);
+
+	//headless snapshot codec tools (--train-dictionary, --bench-codec), see snapshot_codec.h
+	//returns the process exit code, or -1 if the command line doesn't ask for one
+	int RunCodecTool(int argc, char** argv);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,139 @@
+// Node pool allocator
+// Node based containers like std::map allocate on every insert and free on every erase. Given a
+// NodePoolAllocator they take fixed size blocks from a free list instead, and once the pool has
+// been reserved for the most the container will ever hold, inserting never touches the heap.
+//
+// Every allocator with the same Tag shares one pool whatever type the container rebinds it to,
+// so the pool can be reserved without knowing how big the container's nodes are. Anything bigger
+// than a block, or an array, goes straight to operator new.
+
+#ifndef NODE_POOL_H
+#define NODE_POOL_H
+
+#include <stddef.h>
+#include <mutex>
+#include <new>
+
+template <typename Tag, size_t BlockSize = 128>
+class NodePool
+{
+public:
+	//makes sure count blocks are free, allocating any that are missing in one go
+	//blocks are never given back to the heap, the pool is as big as it's ever needed to be
+	static void Reserve(int count)
+	{
+		std::lock_guard<std::mutex> lock(GetMutex());
+		int missing = count - GetFreeCount();
+		if (missing > 0)
+		{
+			AddBlocks(missing);
+		}
+	}
+
+	static void* Take()
+	{
+		std::lock_guard<std::mutex> lock(GetMutex());
+		FreeBlock*& pFree = GetFreeList();
+		if (pFree == nullptr)
+		{
+			//out of blocks, this is the allocation the pool is there to avoid so grow generously
+			AddBlocks(64);
+		}
+
+		FreeBlock* pBlock = pFree;
+		pFree = pBlock->pNext;
+		GetFreeCount()--;
+		return pBlock;
+	}
+
+	static void Give(void* pBlock)
+	{
+		std::lock_guard<std::mutex> lock(GetMutex());
+		FreeBlock* pFreed = static_cast<FreeBlock*>(pBlock);
+		pFreed->pNext = GetFreeList();
+		GetFreeList() = pFreed;
+		GetFreeCount()++;
+	}
+
+private:
+	union FreeBlock
+	{
+		FreeBlock* pNext;
+		alignas(max_align_t) unsigned char bytes[BlockSize];
+	};
+
+	//function statics rather than static members, so the pool is there before any global container uses it
+	static std::mutex& GetMutex()
+	{
+		static std::mutex mutex;
+		return mutex;
+	}
+
+	static FreeBlock*& GetFreeList()
+	{
+		static FreeBlock* pFree = nullptr;
+		return pFree;
+	}
+
+	static int& GetFreeCount()
+	{
+		static int freeCount = 0;
+		return freeCount;
+	}
+
+	//with the lock held
+	static void AddBlocks(int count)
+	{
+		FreeBlock* blocks = static_cast<FreeBlock*>(::operator new(count * sizeof(FreeBlock)));
+		for (int i = 0; i < count; i++)
+		{
+			blocks[i].pNext = GetFreeList();
+			GetFreeList() = &blocks[i];
+		}
+		GetFreeCount() += count;
+	}
+};
+
+template <typename T, typename Tag, size_t BlockSize = 128>
+class NodePoolAllocator
+{
+public:
+	typedef T value_type;
+	typedef NodePool<Tag, BlockSize> Pool;
+
+	template <typename U>
+	struct rebind
+	{
+		typedef NodePoolAllocator<U, Tag, BlockSize> other;
+	};
+
+	NodePoolAllocator() = default;
+	template <typename U>
+	NodePoolAllocator(const NodePoolAllocator<U, Tag, BlockSize>&) {}
+
+	T* allocate(size_t n)
+	{
+		if (n != 1 || sizeof(T) > BlockSize || alignof(T) > alignof(max_align_t))
+		{
+			return static_cast<T*>(::operator new(n * sizeof(T)));
+		}
+		return static_cast<T*>(Pool::Take());
+	}
+
+	void deallocate(T* p, size_t n)
+	{
+		if (n != 1 || sizeof(T) > BlockSize || alignof(T) > alignof(max_align_t))
+		{
+			::operator delete(p);
+			return;
+		}
+		Pool::Give(p);
+	}
+
+	template <typename U>
+	bool operator==(const NodePoolAllocator<U, Tag, BlockSize>&) const { return true; }
+	template <typename U>
+	bool operator!=(const NodePoolAllocator<U, Tag, BlockSize>&) const { return false; }
+};
+
+#endif // NODE_POOL_H
@@ -18,14 +18,35 @@
 /////////////////////////////////////////////////////////////////////////////////////////////
 
 #include "raylib.h"
+#include "rlgl.h"       // NOTE: Only for rlGetDrawCallCount()
+#include "rjobs.h"      // NOTE: Job system shared with raylib, see rjobs.h
 #include "screens.h"    // NOTE: Declares global (extern) variables and screens functions
 
 #include "networking.h"
+#include "async_log.h"
+#include "metrics.h"
+
+#include <stdio.h>      // Required for: printf()
+#include <stdlib.h>     // Required for: atoi(), qsort()
+#include <string.h>     // Required for: strcmp()
 
 #if defined(PLATFORM_WEB)
     #include <emscripten/emscripten.h>
 #endif
 
+//----------------------------------------------------------------------------------
+// Defines and Macros
+//----------------------------------------------------------------------------------
+#define BENCH_DEFAULT_PLAYERS       100     // Gameplay benchmark (--bench) defaults
+#define BENCH_DEFAULT_FRAMES        3000
+#define BENCH_WARMUP_FRAMES         60      // Not counted, lets the first snapshots and allocations settle
+
+//----------------------------------------------------------------------------------
+// Types and Structures Definition
+//----------------------------------------------------------------------------------
+// Frame phases timed by the gameplay benchmark
+typedef enum { BENCH_UPDATE = 0, BENCH_NETWORK, BENCH_DRAW, BENCH_FRAME, BENCH_PHASE_COUNT } BenchPhase;
+
 //----------------------------------------------------------------------------------
 // Shared Variables Definition (global)
 // NOTE: Those variables are shared between modules through screens.h
@@ -48,6 +69,13 @@ static bool transFadeOut = false;
 static int transFromScreen = -1;
 static GameScreen transToScreen = UNKNOWN;
 
+// Frame metrics, see metrics.h
+static Metric *metricFrameSeconds;
+static Metric *metricDrawCalls;
+static Metric *metricAudioUnderruns;
+static unsigned int lastDrawCallCount = 0;
+static unsigned int lastUnderrunCount = 0;
+
 //----------------------------------------------------------------------------------
 // Local Functions Declaration
 //----------------------------------------------------------------------------------
@@ -55,21 +83,53 @@ static void ChangeToScreen(int screen);     // Change to screen, no transition e
 
 static void TransitionToScreen(int screen); // Request transition to next screen
 static void UpdateTransition(void);         // Update transition effect
+static void UpdateFrameMetrics(void);       // Record frame time, draw calls and audio underruns
 static void DrawTransition(void);           // Draw transition effect (full-screen rectangle)
 
 static void UpdateDrawFrame(void);          // Update and draw one frame
 
+static int RunGameplayBenchmark(int argc, char *argv[]);   // Time gameplay frames with simulated players (--bench)
+
 //----------------------------------------------------------------------------------
 // Main entry point
 //----------------------------------------------------------------------------------
-int main(void)
+int main(int argc, char *argv[])
 {
+    // raylib's log shares the networking log's background writer, so printing never holds up a frame
+    SetTraceLogCallback(AsyncLogTraceCallback);
+
+    // Simulated lag/loss and metrics export apply to every kind of process, so pick them up first
+    ConfigureNetworkConditions(argc, argv);
+    ConfigureMetrics(argc, argv);
+
+    // One job system shared by the game and raylib, whatever this process turns out to be
+    InitJobSystem(-1);
+
+    // Zone cluster, spectator relay and benchmark processes run headless, without a window
+    // (the gameplay benchmark draws, but to a hidden one)
+    int headlessResult = RunClusterProcess(argc, argv);
+    if (headlessResult < 0) headlessResult = RunRelayProcess(argc, argv);
+    if (headlessResult < 0) headlessResult = RunDecodeBenchmark(argc, argv);
+    if (headlessResult < 0) headlessResult = RunMovementBenchmark(argc, argv);
+    if (headlessResult < 0) headlessResult = RunCodecTool(argc, argv);
+    if (headlessResult < 0) headlessResult = RunGameplayBenchmark(argc, argv);
+    if (headlessResult >= 0)
+    {
+        CloseJobSystem();
+        return headlessResult;
+    }
+
     // Initialization
     //---------------------------------------------------------
     InitWindow(screenWidth, screenHeight, "raylib game template");
 
     InitAudioDevice();      // Initialize audio device
 
+    static const double frameBuckets[] = { 0.008, 0.0167, 0.025, 0.0333, 0.05, 0.1, 0.25 };
+    metricFrameSeconds = RegisterHistogram("game_frame_seconds", "Time between rendered frames", frameBuckets, sizeof(frameBuckets)/sizeof(frameBuckets[0]));
+    metricDrawCalls = RegisterGauge("game_frame_draw_calls", "Draw calls issued in the last frame");
+    metricAudioUnderruns = RegisterCounter("game_audio_underruns_total", "Times an audio stream ran out of data and played silence");
+
     // Load global data (assets that must be available in all screens, i.e. font)
     font = LoadFont("resources/mecha.png");
     //music = LoadMusicStream("resources/ambient.ogg"); // TODO: Load music
@@ -117,6 +177,9 @@ int main(void)
 
     CloseNetwork();
 
+    // Finish any jobs still queued and stop the workers, while there's still a GL context for main thread jobs
+    CloseJobSystem();
+
     // Unload global data loaded
     UnloadFont(font);
     UnloadMusicStream(music);
@@ -310,4 +373,136 @@ static void UpdateDrawFrame(void)
 
     EndDrawing();
     //----------------------------------------------------------------------------------
+
+    UpdateFrameMetrics();
+}
+
+// Record frame time, draw calls and audio underruns
+static void UpdateFrameMetrics(void)
+{
+    ObserveHistogram(metricFrameSeconds, GetFrameTime());
+
+    unsigned int drawCallCount = rlGetDrawCallCount();
+    SetGauge(metricDrawCalls, (double)(drawCallCount - lastDrawCallCount));
+    lastDrawCallCount = drawCallCount;
+
+    unsigned int underrunCount = GetAudioStreamUnderrunCount();
+    AddCounter(metricAudioUnderruns, underrunCount - lastUnderrunCount);
+    lastUnderrunCount = underrunCount;
+}
+
+// Compare two frame times for qsort()
+static int CompareFrameTimes(const void *a, const void *b)
+{
+    double timeA = *(const double *)a;
+    double timeB = *(const double *)b;
+    return (timeA > timeB) - (timeA < timeB);
+}
+
+// Time gameplay frames with simulated players (--bench)
+// Starts a server with the requested number of bots in a hidden window, runs the gameplay screen
+// for a fixed number of frames as fast as it will go and prints each phase's frame time percentiles
+// NOTE: Returns the process exit code, or -1 if the command line doesn't ask for a benchmark
+static int RunGameplayBenchmark(int argc, char *argv[])
+{
+    int firstArg = -1;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--bench"))
+        {
+            firstArg = i + 1;
+            break;
+        }
+    }
+    if (firstArg < 0) return -1;
+
+    int players = (firstArg < argc)? atoi(argv[firstArg]) : BENCH_DEFAULT_PLAYERS;
+    int frames = (firstArg + 1 < argc)? atoi(argv[firstArg + 1]) : BENCH_DEFAULT_FRAMES;
+    if ((players < 0) || (players >= NETWORK_MAX_ENTITIES) || (frames <= 0))
+    {
+        printf("Usage:\n    raylib_game --bench [PLAYERS] [FRAMES]\n    PLAYERS is 0 to %d\n", NETWORK_MAX_ENTITIES - 1);
+        return 1;
+    }
+
+    // No vsync and no frame limit, a frame takes as long as it takes
+    SetConfigFlags(FLAG_WINDOW_HIDDEN);
+    InitWindow(screenWidth, screenHeight, "raylib game template - benchmark");
+    SetTargetFPS(0);
+
+    font = LoadFont("resources/mecha.png");
+
+    SetSimulatedPlayers(players);
+    DisableWorldCheckpoint();
+    StartServer();
+    while ((GetNetworkStatus() == SERVER_STARTING) && !WindowShouldClose())
+    {
+        UpdateNetwork();
+        WaitTime(0.001);
+    }
+
+    int result = 0;
+    if (GetNetworkStatus() != SERVER_ACTIVE)
+    {
+        printf("Benchmark server failed to start\n");
+        result = 1;
+    }
+    else
+    {
+        currentScreen = GAMEPLAY;
+        InitGameplayScreen();
+
+        double *times = (double *)RL_CALLOC(BENCH_PHASE_COUNT*frames, sizeof(double));
+        unsigned int firstDrawCall = 0;
+
+        for (int frame = -BENCH_WARMUP_FRAMES; frame < frames; frame++)
+        {
+            if (frame == 0) firstDrawCall = rlGetDrawCallCount();
+
+            double start = GetTime();
+            UpdateGameplayScreen();
+            double updated = GetTime();
+            UpdateNetwork();
+            double networked = GetTime();
+            BeginDrawing();
+                ClearBackground(RAYWHITE);
+                DrawGameplayScreen();
+            EndDrawing();
+            double drawn = GetTime();
+
+            if (frame >= 0)
+            {
+                times[BENCH_UPDATE*frames + frame] = updated - start;
+                times[BENCH_NETWORK*frames + frame] = networked - updated;
+                times[BENCH_DRAW*frames + frame] = drawn - networked;
+                times[BENCH_FRAME*frames + frame] = drawn - start;
+            }
+        }
+
+        unsigned int drawCalls = rlGetDrawCallCount() - firstDrawCall;
+
+        static const char *phaseNames[BENCH_PHASE_COUNT] = { "update", "network", "draw", "frame" };
+        printf("Gameplay benchmark, %d simulated players, %d frames, %.1f draw calls per frame\n", players, frames, (float)drawCalls/frames);
+        printf("%-8s %9s %9s %9s %9s %9s  (milliseconds)\n", "", "mean", "p50", "p90", "p99", "max");
+        for (int phase = 0; phase < BENCH_PHASE_COUNT; phase++)
+        {
+            double *phaseTimes = times + phase*frames;
+            double total = 0.0;
+            for (int frame = 0; frame < frames; frame++) total += phaseTimes[frame];
+            qsort(phaseTimes, frames, sizeof(double), CompareFrameTimes);
+
+            printf("%-8s %9.3f %9.3f %9.3f %9.3f %9.3f\n", phaseNames[phase], total*1000.0/frames,
+                phaseTimes[frames*50/100]*1000.0, phaseTimes[frames*90/100]*1000.0,
+                phaseTimes[frames*99/100]*1000.0, phaseTimes[frames - 1]*1000.0);
+        }
+
+        RL_FREE(times);
+        UnloadGameplayScreen();
+    }
+
+    CloseNetwork();
+    CloseJobSystem();       // Before the window goes, main thread jobs may need its GL context
+    UnloadFont(font);
+    CloseWindow();
+
+    return result;
 }
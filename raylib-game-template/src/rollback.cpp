@@ -0,0 +1,255 @@
+// Deterministic fixed-step simulation with rollback, used by the rollback network mode
+
+#include <string.h>
+#include <algorithm>
+
+#include "rollback.h"
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// RollbackSession
+//
+/////////////////////////////////////////////////////////////////////////////
+
+void RollbackSession::Start(int localPlayer, int startFrame)
+{
+	m_bStarted = true;
+	m_nLocalPlayer = localPlayer;
+
+	memset(&m_State, 0, sizeof(m_State));
+	m_State.frame = startFrame;
+	memset(m_History, 0, sizeof(m_History));
+	memset(m_Inputs, 0, sizeof(m_Inputs));
+	memset(m_UsedInputs, 0, sizeof(m_UsedInputs));
+
+	for (int i = 0; i < ROLLBACK_HISTORY; i++)
+	{
+		for (int player = 0; player < ROLLBACK_MAX_PLAYERS; player++)
+		{
+			m_InputFrames[i][player] = -1;
+		}
+	}
+
+	for (int player = 0; player < ROLLBACK_MAX_PLAYERS; player++)
+	{
+		m_LastInputFrame[player] = -1;
+		m_LastInput[player] = 0;
+	}
+
+	m_nRollbackFrame = -1;
+	m_nReplayedFrames = 0;
+}
+
+int RollbackSession::AddLocalInput(unsigned char input)
+{
+	int frame = m_State.frame;
+	int slot = frame % ROLLBACK_HISTORY;
+
+	input |= ROLLBACK_INPUT_PRESENT;
+	m_Inputs[slot][m_nLocalPlayer] = input;
+	m_InputFrames[slot][m_nLocalPlayer] = frame;
+	m_LastInputFrame[m_nLocalPlayer] = frame;
+	m_LastInput[m_nLocalPlayer] = input;
+
+	return frame;
+}
+
+void RollbackSession::AddRemoteInput(int player, int frame, unsigned char input)
+{
+	if (player < 0 || player >= ROLLBACK_MAX_PLAYERS || player == m_nLocalPlayer)
+	{
+		return;
+	}
+
+	//inputs arrive in order, so anything not newer is a duplicate
+	if (frame <= m_LastInputFrame[player])
+	{
+		return;
+	}
+
+	int slot = frame % ROLLBACK_HISTORY;
+	int oldestFrame = m_State.frame - ROLLBACK_HISTORY + 1;
+	if (frame >= oldestFrame)
+	{
+		m_Inputs[slot][player] = input;
+		m_InputFrames[slot][player] = frame;
+
+		//already simulated this frame with a guess, was it right?
+		//if so every guess after it was right too, as they all repeated the same input
+		if (frame < m_State.frame && m_UsedInputs[slot][player] != input)
+		{
+			Rewind(frame);
+		}
+	}
+
+	m_LastInputFrame[player] = frame;
+	m_LastInput[player] = input;
+}
+
+void RollbackSession::ApplySyncState(const RollbackState& syncState)
+{
+	if (!m_bStarted)
+	{
+		return;
+	}
+
+	int frame = syncState.frame;
+
+	//we're behind the host, just jump ahead
+	if (frame > m_State.frame)
+	{
+		m_State = syncState;
+		m_nRollbackFrame = -1;
+		return;
+	}
+
+	if (frame == m_State.frame)
+	{
+		if (memcmp(&m_State, &syncState, sizeof(RollbackState)) != 0)
+		{
+			m_State = syncState;
+		}
+		m_nRollbackFrame = -1;
+		return;
+	}
+
+	//too old to replay from
+	if (frame < m_State.frame - ROLLBACK_HISTORY + 1)
+	{
+		return;
+	}
+
+	//everything before the synced frame is settled now, replay from it if we went wrong
+	RollbackState& historyState = m_History[frame % ROLLBACK_HISTORY];
+	if (historyState.frame != frame || memcmp(&historyState, &syncState, sizeof(RollbackState)) != 0)
+	{
+		historyState = syncState;
+		m_nRollbackFrame = frame;
+	}
+	else if (m_nRollbackFrame >= 0 && m_nRollbackFrame < frame)
+	{
+		m_nRollbackFrame = frame;
+	}
+}
+
+void RollbackSession::Advance(int targetFrame)
+{
+	if (!m_bStarted)
+	{
+		return;
+	}
+
+	//replay from the oldest wrong guess
+	if (m_nRollbackFrame >= 0)
+	{
+		int fromFrame = std::max(m_nRollbackFrame, m_State.frame - ROLLBACK_HISTORY + 1);
+		int currentFrame = m_State.frame;
+		if (fromFrame < currentFrame)
+		{
+			m_State = m_History[fromFrame % ROLLBACK_HISTORY];
+			m_nReplayedFrames += currentFrame - fromFrame;
+			targetFrame = std::max(targetFrame, currentFrame);
+		}
+		m_nRollbackFrame = -1;
+	}
+
+	while (m_State.frame < targetFrame)
+	{
+		int frame = m_State.frame;
+		int slot = frame % ROLLBACK_HISTORY;
+
+		m_History[slot] = m_State;
+		for (int player = 0; player < ROLLBACK_MAX_PLAYERS; player++)
+		{
+			m_UsedInputs[slot][player] = GetInput(frame, player);
+		}
+
+		Step(m_State, m_UsedInputs[slot]);
+	}
+}
+
+int RollbackSession::GetConfirmedFrame() const
+{
+	//players we haven't heard from for longer than the history are treated as gone
+	int confirmedFrame = m_State.frame - 1;
+	int oldestFrame = m_State.frame - ROLLBACK_HISTORY + 1;
+	for (int player = 0; player < ROLLBACK_MAX_PLAYERS; player++)
+	{
+		if (m_LastInputFrame[player] >= oldestFrame)
+		{
+			confirmedFrame = std::min(confirmedFrame, m_LastInputFrame[player]);
+		}
+	}
+
+	return confirmedFrame;
+}
+
+const RollbackState* RollbackSession::GetHistoryState(int frame) const
+{
+	if (frame == m_State.frame)
+	{
+		return &m_State;
+	}
+
+	if (frame > m_State.frame || frame < m_State.frame - ROLLBACK_HISTORY + 1)
+	{
+		return nullptr;
+	}
+
+	const RollbackState& historyState = m_History[frame % ROLLBACK_HISTORY];
+	return (historyState.frame == frame) ? &historyState : nullptr;
+}
+
+//the confirmed input if we have it, otherwise a guess that they're still holding their last one
+unsigned char RollbackSession::GetInput(int frame, int player) const
+{
+	int slot = frame % ROLLBACK_HISTORY;
+	if (m_InputFrames[slot][player] == frame)
+	{
+		return m_Inputs[slot][player];
+	}
+
+	if (m_LastInputFrame[player] >= 0 && frame > m_LastInputFrame[player])
+	{
+		return m_LastInput[player];
+	}
+
+	return 0;
+}
+
+void RollbackSession::Rewind(int frame)
+{
+	if (m_nRollbackFrame < 0 || frame < m_nRollbackFrame)
+	{
+		m_nRollbackFrame = frame;
+	}
+}
+
+//moves the simulation on one frame
+//integer maths only, so every peer ends up with the exact same state
+void RollbackSession::Step(RollbackState& state, const unsigned char* inputs)
+{
+	for (int player = 0; player < ROLLBACK_MAX_PLAYERS; player++)
+	{
+		unsigned char input = inputs[player];
+
+		if (!state.active[player])
+		{
+			if (!(input & ROLLBACK_INPUT_PRESENT))
+			{
+				continue;
+			}
+
+			state.active[player] = 1;
+			state.posX[player] = ROLLBACK_SPAWN_X;
+			state.posY[player] = ROLLBACK_SPAWN_Y;
+		}
+
+		if (input & ROLLBACK_INPUT_RIGHT) state.posX[player] += ROLLBACK_MOVE_SPEED;
+		if (input & ROLLBACK_INPUT_LEFT) state.posX[player] -= ROLLBACK_MOVE_SPEED;
+		if (input & ROLLBACK_INPUT_UP) state.posY[player] -= ROLLBACK_MOVE_SPEED;
+		if (input & ROLLBACK_INPUT_DOWN) state.posY[player] += ROLLBACK_MOVE_SPEED;
+	}
+
+	state.frame++;
+}
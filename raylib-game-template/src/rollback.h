@@ -0,0 +1,95 @@
+// Deterministic fixed-step simulation with rollback, used by the rollback network mode
+// Peers only exchange inputs, remote inputs are predicted and the simulation is
+// rewound and replayed whenever a prediction turns out to be wrong
+
+#ifndef ROLLBACK_H
+#define ROLLBACK_H
+
+#define ROLLBACK_MAX_PLAYERS 4
+#define ROLLBACK_TICK_RATE 60
+//frames of state and input kept, so the furthest we can rewind
+#define ROLLBACK_HISTORY 64
+
+//where players appear when they first send an input
+#define ROLLBACK_SPAWN_X 400
+#define ROLLBACK_SPAWN_Y 225
+#define ROLLBACK_MOVE_SPEED 5
+
+//input bits, one byte per player per frame
+#define ROLLBACK_INPUT_RIGHT 0x01
+#define ROLLBACK_INPUT_LEFT 0x02
+#define ROLLBACK_INPUT_UP 0x04
+#define ROLLBACK_INPUT_DOWN 0x08
+#define ROLLBACK_INPUT_PRESENT 0x10 //set on every real input, players without it haven't joined yet
+
+//the whole simulation
+//only ints and no pointers, so saving or restoring a frame is a single memcpy
+struct RollbackState
+{
+	int frame;
+	int active[ROLLBACK_MAX_PLAYERS];
+	int posX[ROLLBACK_MAX_PLAYERS];
+	int posY[ROLLBACK_MAX_PLAYERS];
+};
+
+#define ROLLBACK_STATE_INTS ((int)(sizeof(RollbackState) / sizeof(int)))
+
+class RollbackSession
+{
+public:
+	//starts simulating from startFrame with nobody in the world
+	void Start(int localPlayer, int startFrame);
+	bool IsStarted() const { return m_bStarted; }
+
+	//the local input for the current frame
+	//returns the frame it was recorded against so it can be sent on
+	int AddLocalInput(unsigned char input);
+
+	//a confirmed input from another player
+	//rewinds on the next Advance if we predicted that frame wrong
+	void AddRemoteInput(int player, int frame, unsigned char input);
+
+	//the authoritative state for a frame, from the host
+	//replaces ours if it differs and replays everything after it
+	void ApplySyncState(const RollbackState& syncState);
+
+	//resolves any pending rollback then simulates forward up to targetFrame
+	void Advance(int targetFrame);
+
+	//the state at the start of the current frame
+	const RollbackState& GetState() const { return m_State; }
+	int GetCurrentFrame() const { return m_State.frame; }
+
+	//the newest frame for which every joined player's input is confirmed
+	int GetConfirmedFrame() const;
+
+	//state at the start of a frame still in the history, or nullptr
+	const RollbackState* GetHistoryState(int frame) const;
+
+	//frames replayed by rollbacks so far, for profiling
+	int GetReplayedFrames() const { return m_nReplayedFrames; }
+
+private:
+	unsigned char GetInput(int frame, int player) const;
+	void Rewind(int frame);
+
+	static void Step(RollbackState& state, const unsigned char* inputs);
+
+	bool m_bStarted = false;
+	int m_nLocalPlayer = 0;
+
+	RollbackState m_State = {};
+	RollbackState m_History[ROLLBACK_HISTORY] = {}; //state at the start of frame f, at f % ROLLBACK_HISTORY
+
+	unsigned char m_Inputs[ROLLBACK_HISTORY][ROLLBACK_MAX_PLAYERS] = {};
+	int m_InputFrames[ROLLBACK_HISTORY][ROLLBACK_MAX_PLAYERS] = {}; //which frame each slot holds, -1 if empty
+	unsigned char m_UsedInputs[ROLLBACK_HISTORY][ROLLBACK_MAX_PLAYERS] = {}; //what we actually simulated with
+
+	int m_LastInputFrame[ROLLBACK_MAX_PLAYERS] = {}; //newest confirmed frame per player, -1 if none
+	unsigned char m_LastInput[ROLLBACK_MAX_PLAYERS] = {}; //and its input, repeated as the prediction
+
+	int m_nRollbackFrame = -1; //earliest frame that needs replaying, -1 if none
+	int m_nReplayedFrames = 0;
+};
+
+#endif // ROLLBACK_H
@@ -26,6 +26,9 @@
 #include "raylib.h"
 #include "screens.h"
 #include "networking.h"
+#include "rlgl.h"
+
+#include <stddef.h>     // Required for: NULL
 
 //----------------------------------------------------------------------------------
 // Module Variables Definition (local)
@@ -37,6 +40,16 @@ static int finishScreen = 0;
 Vector2Int position = {0, 0};
 
 int moveSpeed = 5;
+
+//everyone in the world, refilled every frame by one GetClientPositions call
+static DataPacket players[NETWORK_MAX_ENTITIES] = { 0 };
+
+//----------------------------------------------------------------------------------
+// Local Functions Declaration
+//----------------------------------------------------------------------------------
+static void DrawRemotePlayers(void);    // Draw every other player as one batch
+static bool IsPositionBlocked(Vector2Int at);   // Would a player here be outside the world or in an obstacle
+
 //----------------------------------------------------------------------------------
 // Gameplay Screen Functions Definition
 //----------------------------------------------------------------------------------
@@ -64,24 +77,66 @@ void UpdateGameplayScreen(void)
         PlaySound(fxCoin);
     }
 
+    //events from the other players
+    GameEvent event;
+    while (PollGameEvent(&event))
+    {
+        switch (event.type)
+        {
+            case GAME_EVENT_SPAWN: TraceLog(LOG_INFO, "Player %d joined at %d, %d", event.player, event.x, event.y); break;
+            case GAME_EVENT_PICKUP: PlaySound(fxCoin); break;
+            case GAME_EVENT_CHAT: TraceLog(LOG_INFO, "Player %d: %s", event.player, event.text); break;
+            default: break;
+        }
+    }
+
+    //in rollback mode the network simulation moves us, so just hand it our input
+    if (GetNetworkMode() == NETWORK_MODE_ROLLBACK)
+    {
+        unsigned char input = 0;
+        if (IsKeyDown(KEY_RIGHT)) input |= NETWORK_INPUT_RIGHT;
+        if (IsKeyDown(KEY_LEFT)) input |= NETWORK_INPUT_LEFT;
+        if (IsKeyDown(KEY_UP)) input |= NETWORK_INPUT_UP;
+        if (IsKeyDown(KEY_DOWN)) input |= NETWORK_INPUT_DOWN;
+
+        UpdatePacketInput(input);
+        position = GetClientPosition(GetMyID());
+        return;
+    }
+
+    //the server has the last word on where we are
+    Vector2Int corrected;
+    if (PollPositionCorrection(&corrected))
+    {
+        position = corrected;
+    }
+
     //take user input for player positions
+    Vector2Int move = { 0, 0 };
     if (IsKeyDown(KEY_RIGHT))
     {
-        position.x += moveSpeed;
+        move.x += moveSpeed;
     }
     if (IsKeyDown(KEY_LEFT))
     {
-        position.x -= moveSpeed;
+        move.x -= moveSpeed;
     }
     if (IsKeyDown(KEY_UP))
     {
-        position.y -= moveSpeed;
+        move.y -= moveSpeed;
     }
     if (IsKeyDown(KEY_DOWN))
     {
-        position.y += moveSpeed;
+        move.y += moveSpeed;
     }
 
+    //the same rules the server holds us to, so it only has to step in when we run into someone
+    //one axis at a time, so we slide along walls instead of sticking to them
+    Vector2Int next = { position.x + move.x, position.y };
+    if (!IsPositionBlocked(next)) position = next;
+    next = (Vector2Int){ position.x, position.y + move.y };
+    if (!IsPositionBlocked(next)) position = next;
+
     UpdatePacketPosition(position.x, position.y);
 
 }
@@ -95,17 +150,31 @@ void DrawGameplayScreen(void)
     DrawTextEx(font, "GAMEPLAY SCREEN", pos, font.baseSize*3.0f, 4, MAROON);
     DrawText("PRESS ENTER or TAP to JUMP to ENDING SCREEN", 130, 220, 20, MAROON);
 
-    //draw clients
-    DrawRectangle(GetClientPosition(0).x, GetClientPosition(0).y, 20, 20, GREEN);
-    DrawRectangle(GetClientPosition(1).x, GetClientPosition(1).y, 20, 20, GREEN);
-    DrawRectangle(GetClientPosition(2).x, GetClientPosition(2).y, 20, 20, GREEN);
-    DrawRectangle(GetClientPosition(3).x, GetClientPosition(3).y, 20, 20, GREEN);
+    //the session starts in the background, say what it's up to until it's going
+    switch (GetNetworkStatus())
+    {
+        case SERVER_STARTING: DrawText("STARTING SERVER...", 130, 250, 20, MAROON); break;
+        case CLIENT_STARTING: DrawText("CONNECTING...", 130, 250, 20, MAROON); break;
+        case CLIENT_ACTIVE:
+            if (GetJoinQueuePosition() > 0) DrawText(TextFormat("WAITING TO JOIN, NUMBER %d IN THE QUEUE", GetJoinQueuePosition()), 130, 250, 20, MAROON);
+            break;
+        case NETWORK_FAILED: DrawText("NETWORK FAILED TO START, SEE THE CONSOLE", 130, 250, 20, MAROON); break;
+        default: break;
+    }
 
-    //draw this player
-    DrawRectangle(position.x, position.y, 20, 20, RED);
+    //draw the world's obstacles
+    const WorldBox *obstacles = NULL;
+    int obstacleCount = GetWorldObstacles(&obstacles);
+    for (int i = 0; i < obstacleCount; i++)
+    {
+        DrawRectangle(obstacles[i].x, obstacles[i].y, obstacles[i].width, obstacles[i].height, DARKPURPLE);
+    }
 
-    
+    //draw clients
+    DrawRemotePlayers();
 
+    //draw this player
+    DrawRectangle(position.x, position.y, NETWORK_PLAYER_SIZE, NETWORK_PLAYER_SIZE, RED);
 }
 
 // Gameplay Screen Unload logic
@@ -118,4 +187,80 @@ void UnloadGameplayScreen(void)
 int FinishGameplayScreen(void)
 {
     return finishScreen;
-}
\ No newline at end of file
+}
+
+//----------------------------------------------------------------------------------
+// Module specific Functions Definition
+//----------------------------------------------------------------------------------
+
+// Draw every other player, with their ID on them, as one batch
+// NOTE: Shapes are drawn with the default font's texture, so the quads and the labels
+// all land in the same draw call as long as the batch has room for them
+static void DrawRemotePlayers(void)
+{
+    const Color palette[] = { GREEN, LIME, DARKGREEN, SKYBLUE, BLUE, GOLD, ORANGE, PINK, BEIGE, VIOLET };
+    const int paletteCount = sizeof(palette)/sizeof(palette[0]);
+
+    int count = GetClientPositions(players, NETWORK_MAX_ENTITIES);
+    int myID = GetMyID();
+
+    Texture2D texture = GetShapesTexture();
+    Rectangle source = GetShapesTextureRectangle();
+    float left = source.x/texture.width;
+    float top = source.y/texture.height;
+    float right = (source.x + source.width)/texture.width;
+    float bottom = (source.y + source.height)/texture.height;
+
+    // Make room for everyone up front so nothing forces a draw halfway through,
+    // a quad each plus up to three glyphs for the label
+    rlCheckRenderBatchLimit(count*4*4);
+
+    rlSetTexture(texture.id);
+    rlBegin(RL_QUADS);
+
+        rlNormal3f(0.0f, 0.0f, 1.0f);
+
+        for (int i = 0; i < count; i++)
+        {
+            if (players[i].id == myID) continue;
+
+            Color color = palette[players[i].id%paletteCount];
+            float x = (float)players[i].posX;
+            float y = (float)players[i].posY;
+
+            rlColor4ub(color.r, color.g, color.b, color.a);
+            rlTexCoord2f(left, top);
+            rlVertex2f(x, y);
+            rlTexCoord2f(left, bottom);
+            rlVertex2f(x, y + NETWORK_PLAYER_SIZE);
+            rlTexCoord2f(right, bottom);
+            rlVertex2f(x + NETWORK_PLAYER_SIZE, y + NETWORK_PLAYER_SIZE);
+            rlTexCoord2f(right, top);
+            rlVertex2f(x + NETWORK_PLAYER_SIZE, y);
+        }
+
+    rlEnd();
+    rlSetTexture(0);
+
+    for (int i = 0; i < count; i++)
+    {
+        if (players[i].id == myID) continue;
+        DrawText(TextFormat("%d", players[i].id), players[i].posX + 4, players[i].posY + 5, 10, BLACK);
+    }
+}
+
+// Would a player here be outside the world or in an obstacle
+static bool IsPositionBlocked(Vector2Int at)
+{
+    if ((at.x < 0) || (at.y < 0) || (at.x > NETWORK_WORLD_WIDTH - NETWORK_PLAYER_SIZE) || (at.y > NETWORK_WORLD_HEIGHT - NETWORK_PLAYER_SIZE)) return true;
+
+    const WorldBox *obstacles = NULL;
+    int obstacleCount = GetWorldObstacles(&obstacles);
+    for (int i = 0; i < obstacleCount; i++)
+    {
+        if ((at.x < obstacles[i].x + obstacles[i].width) && (at.x + NETWORK_PLAYER_SIZE > obstacles[i].x) &&
+            (at.y < obstacles[i].y + obstacles[i].height) && (at.y + NETWORK_PLAYER_SIZE > obstacles[i].y)) return true;
+    }
+
+    return false;
+}
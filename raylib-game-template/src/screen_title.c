@@ -90,6 +90,20 @@ void UpdateTitleScreen(void)
         
     }
 
+    //watch through a spectator relay instead of playing
+    if (IsKeyPressed(KEY_S))
+    {
+        StartSpectator();
+        finishScreen = 2; //GAMEPLAY
+        PlaySound(fxCoin);
+    }
+
+    //toggle between state sync and rollback
+    if (IsKeyPressed(KEY_R))
+    {
+        SetNetworkMode((GetNetworkMode() == NETWORK_MODE_ROLLBACK)? NETWORK_MODE_STATE_SYNC : NETWORK_MODE_ROLLBACK);
+    }
+
     //is the mouse hovering over the button?
     serverIsHovered = CheckCollisionPointRec(GetMousePosition(), serverButtonRect);
     clientIsHovered = CheckCollisionPointRec(GetMousePosition(), clientButtonRect);
@@ -127,6 +141,10 @@ void DrawTitleScreen(void)
     
     DrawText("Server", serverButtonRect.x, serverButtonRect.y, textFontSize, WHITE);
     DrawText("Client", clientButtonRect.x, clientButtonRect.y, textFontSize, WHITE);
+
+    DrawText((GetNetworkMode() == NETWORK_MODE_ROLLBACK)? "MODE: ROLLBACK (R to toggle)" : "MODE: STATE SYNC (R to toggle)",
+        120, GetScreenHeight() - 40, textFontSize, DARKGREEN);
+    DrawText("S to spectate through a relay", 120, GetScreenHeight() - 70, textFontSize, DARKGREEN);
 }
 
 // Title Screen Unload logic
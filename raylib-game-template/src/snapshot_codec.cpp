@@ -0,0 +1,534 @@
+// Snapshot codec, see snapshot_codec.h
+
+#define _CRT_SECURE_NO_WARNINGS
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+#include "snapshot_codec.h"
+
+//DEFLATE helpers from raylib (rcore.c), only for comparing against in the benchmark
+extern "C"
+{
+	unsigned char* CompressData(const unsigned char* data, int dataSize, int* compDataSize);
+	void MemFree(void* ptr);
+	int sinflate(void* out, int cap, const void* in, int size);
+}
+
+//rANS keeps its state between RANS_LOW and RANS_LOW << 8, moving a byte in or out at a time
+#define RANS_LOW (1u << 23)
+#define SNAPSHOT_CODEC_SLOTS (1 << SNAPSHOT_CODEC_SCALE_BITS)
+
+SnapshotCodec snapshotCodec;
+
+static uint32 ReadUint32(const unsigned char* data)
+{
+	return (uint32)data[0] | ((uint32)data[1] << 8) | ((uint32)data[2] << 16) | ((uint32)data[3] << 24);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// SnapshotCodec
+//
+/////////////////////////////////////////////////////////////////////////////
+
+bool SnapshotCodec::MapSymbols(const char* raw, int rawSize, int recordOffset, std::vector<unsigned char>& outSymbols, std::vector<unsigned char>& outContexts) const
+{
+	int count = (recordOffset >= 4 && recordOffset <= 255 && rawSize >= recordOffset) ? DeserializeInt(raw, recordOffset - 4) : -1;
+	if (count < 0 || count > (rawSize - recordOffset) / NETWORK_PACKET_SIZE)
+	{
+		return false;
+	}
+	int recordsEnd = recordOffset + count * NETWORK_PACKET_SIZE;
+
+	outSymbols.resize(rawSize);
+	outContexts.resize(rawSize);
+	unsigned char previousID = 0;
+	for (int i = 0; i < rawSize; i++)
+	{
+		unsigned char value = (unsigned char)raw[i];
+		if (i < recordOffset || i >= recordsEnd)
+		{
+			outContexts[i] = SNAPSHOT_CODEC_CONTEXT_OTHER;
+			outSymbols[i] = value;
+			continue;
+		}
+
+		int position = (i - recordOffset) % NETWORK_PACKET_SIZE;
+		outContexts[i] = (unsigned char)(1 + position);
+		if (position == 0)
+		{
+			outSymbols[i] = (unsigned char)(value - previousID);
+			previousID = value;
+		}
+		else
+		{
+			outSymbols[i] = value;
+		}
+	}
+	return true;
+}
+
+void SnapshotCodec::AddTrainingMessage(const char* raw, int rawSize, int recordOffset)
+{
+	m_TrainingCounts.resize(SNAPSHOT_CODEC_CONTEXT_COUNT * 256);
+
+	std::vector<unsigned char> symbols, contexts;
+	if (!MapSymbols(raw, rawSize, recordOffset, symbols, contexts))
+	{
+		return;
+	}
+	for (int i = 0; i < rawSize; i++)
+	{
+		m_TrainingCounts[contexts[i] * 256 + symbols[i]]++;
+	}
+}
+
+void SnapshotCodec::FinishTraining()
+{
+	m_TrainingCounts.resize(SNAPSHOT_CODEC_CONTEXT_COUNT * 256);
+
+	for (int context = 0; context < SNAPSHOT_CODEC_CONTEXT_COUNT; context++)
+	{
+		const uint64* counts = &m_TrainingCounts[context * 256];
+		uint64 total = 0;
+		for (int symbol = 0; symbol < 256; symbol++)
+		{
+			total += counts[symbol];
+		}
+
+		//every byte keeps at least one slot so anything can still be coded, just expensively,
+		//the rest are shared out by how often they were seen
+		const int spareSlots = SNAPSHOT_CODEC_SLOTS - 256;
+		int assigned = 0;
+		int mostCommon = 0;
+		for (int symbol = 0; symbol < 256; symbol++)
+		{
+			int frequency = 1 + (total > 0 ? (int)(counts[symbol] * spareSlots / total) : spareSlots / 256);
+			m_Frequency[context][symbol] = (uint16)frequency;
+			assigned += frequency;
+			if (counts[symbol] > counts[mostCommon])
+			{
+				mostCommon = symbol;
+			}
+		}
+
+		//rounding down leaves a few slots over, give them to the byte that can best use them
+		m_Frequency[context][mostCommon] += (uint16)(SNAPSHOT_CODEC_SLOTS - assigned);
+	}
+
+	m_TrainingCounts.clear();
+	BuildTables();
+}
+
+void SnapshotCodec::BuildTables()
+{
+	m_SlotSymbol.resize(SNAPSHOT_CODEC_CONTEXT_COUNT * SNAPSHOT_CODEC_SLOTS);
+	for (int context = 0; context < SNAPSHOT_CODEC_CONTEXT_COUNT; context++)
+	{
+		int start = 0;
+		for (int symbol = 0; symbol < 256; symbol++)
+		{
+			m_Start[context][symbol] = (uint16)start;
+			memset(&m_SlotSymbol[context * SNAPSHOT_CODEC_SLOTS + start], symbol, m_Frequency[context][symbol]);
+			start += m_Frequency[context][symbol];
+		}
+	}
+
+	//FNV-1a of the frequencies, two different dictionaries matching by chance isn't worth worrying about
+	uint32 hash = 2166136261u;
+	const unsigned char* bytes = (const unsigned char*)m_Frequency;
+	for (size_t i = 0; i < sizeof(m_Frequency); i++)
+	{
+		hash = (hash ^ bytes[i]) * 16777619u;
+	}
+	m_nDictionaryID = (hash != 0) ? hash : 1;
+}
+
+//file layout: [magic:4][version:4][context count:4][context count * 256 * frequency:2], little endian
+bool SnapshotCodec::Save(const char* path) const
+{
+	FILE* pFile = fopen(path, "wb");
+	if (pFile == nullptr)
+	{
+		return false;
+	}
+
+	std::vector<char> data(12 + sizeof(m_Frequency));
+	SerializeInt(SNAPSHOT_DICTIONARY_MAGIC, data.data());
+	SerializeInt(SNAPSHOT_DICTIONARY_VERSION, data.data() + 4);
+	SerializeInt(SNAPSHOT_CODEC_CONTEXT_COUNT, data.data() + 8);
+	char* frequency = data.data() + 12;
+	for (int context = 0; context < SNAPSHOT_CODEC_CONTEXT_COUNT; context++)
+	{
+		for (int symbol = 0; symbol < 256; symbol++)
+		{
+			frequency[0] = (char)(m_Frequency[context][symbol] & 0xFF);
+			frequency[1] = (char)(m_Frequency[context][symbol] >> 8);
+			frequency += 2;
+		}
+	}
+
+	bool bWritten = fwrite(data.data(), 1, data.size(), pFile) == data.size();
+	return (fclose(pFile) == 0) && bWritten;
+}
+
+bool SnapshotCodec::Load(const char* path)
+{
+	m_nDictionaryID = 0;
+
+	FILE* pFile = fopen(path, "rb");
+	if (pFile == nullptr)
+	{
+		return false;
+	}
+	std::vector<char> data(12 + sizeof(m_Frequency));
+	bool bRead = fread(data.data(), 1, data.size(), pFile) == data.size();
+	fclose(pFile);
+
+	if (!bRead || DeserializeInt(data.data()) != SNAPSHOT_DICTIONARY_MAGIC || DeserializeInt(data.data(), 4) != SNAPSHOT_DICTIONARY_VERSION
+		|| DeserializeInt(data.data(), 8) != SNAPSHOT_CODEC_CONTEXT_COUNT)
+	{
+		return false;
+	}
+
+	const unsigned char* frequency = (const unsigned char*)data.data() + 12;
+	for (int context = 0; context < SNAPSHOT_CODEC_CONTEXT_COUNT; context++)
+	{
+		int total = 0;
+		for (int symbol = 0; symbol < 256; symbol++)
+		{
+			m_Frequency[context][symbol] = (uint16)(frequency[0] | (frequency[1] << 8));
+			frequency += 2;
+
+			//a byte with no slots could never be coded
+			if (m_Frequency[context][symbol] == 0)
+			{
+				return false;
+			}
+			total += m_Frequency[context][symbol];
+		}
+		if (total != SNAPSHOT_CODEC_SLOTS)
+		{
+			return false;
+		}
+	}
+
+	BuildTables();
+	return true;
+}
+
+bool SnapshotCodec::Encode(const char* raw, int rawSize, int recordOffset, std::vector<char>& outPacked) const
+{
+	thread_local std::vector<unsigned char> symbols, contexts, buffer;
+	if (!IsLoaded() || !MapSymbols(raw, rawSize, recordOffset, symbols, contexts))
+	{
+		return false;
+	}
+
+	//rANS works backwards, so fill the buffer from the end
+	//no byte costs more than SCALE_BITS bits, which bounds the size
+	buffer.resize(rawSize * 2 + 8);
+	unsigned char* end = buffer.data() + buffer.size();
+	unsigned char* out = end;
+
+	uint32 state = RANS_LOW;
+	for (int i = rawSize - 1; i >= 0; i--)
+	{
+		uint32 frequency = m_Frequency[contexts[i]][symbols[i]];
+		uint32 start = m_Start[contexts[i]][symbols[i]];
+
+		uint32 stateMax = ((RANS_LOW >> SNAPSHOT_CODEC_SCALE_BITS) << 8) * frequency;
+		while (state >= stateMax)
+		{
+			*--out = (unsigned char)(state & 0xFF);
+			state >>= 8;
+		}
+		state = ((state / frequency) << SNAPSHOT_CODEC_SCALE_BITS) + (state % frequency) + start;
+	}
+
+	out -= 4;
+	out[0] = (unsigned char)(state >> 0);
+	out[1] = (unsigned char)(state >> 8);
+	out[2] = (unsigned char)(state >> 16);
+	out[3] = (unsigned char)(state >> 24);
+
+	outPacked.push_back((char)recordOffset);
+	outPacked.insert(outPacked.end(), out, end);
+	return true;
+}
+
+bool SnapshotCodec::Decode(const char* packed, int packedSize, int rawSize, std::vector<char>& outRaw) const
+{
+	if (!IsLoaded() || packedSize < 5 || rawSize < 0)
+	{
+		return false;
+	}
+
+	const unsigned char* in = (const unsigned char*)packed;
+	const unsigned char* end = in + packedSize;
+	int recordOffset = *in++;
+	if (recordOffset < 4 || recordOffset > rawSize)
+	{
+		return false;
+	}
+
+	uint32 state = ReadUint32(in);
+	in += 4;
+
+	outRaw.resize(rawSize);
+	int recordsEnd = -1; //known once the count in front of the records is decoded
+	unsigned char previousID = 0;
+	const uint32 slotMask = SNAPSHOT_CODEC_SLOTS - 1;
+	for (int i = 0; i < rawSize; i++)
+	{
+		if (i == recordOffset)
+		{
+			int count = DeserializeInt(outRaw.data(), recordOffset - 4);
+			if (count < 0 || count > (rawSize - recordOffset) / NETWORK_PACKET_SIZE)
+			{
+				return false;
+			}
+			recordsEnd = recordOffset + count * NETWORK_PACKET_SIZE;
+		}
+
+		int position = (i >= recordOffset && i < recordsEnd) ? (i - recordOffset) % NETWORK_PACKET_SIZE : -1;
+		int context = 1 + position; //-1 is SNAPSHOT_CODEC_CONTEXT_OTHER
+
+		uint32 slot = state & slotMask;
+		unsigned char symbol = m_SlotSymbol[context * SNAPSHOT_CODEC_SLOTS + slot];
+		state = m_Frequency[context][symbol] * (state >> SNAPSHOT_CODEC_SCALE_BITS) + slot - m_Start[context][symbol];
+		while (state < RANS_LOW)
+		{
+			if (in >= end)
+			{
+				return false;
+			}
+			state = (state << 8) | *in++;
+		}
+
+		if (position == 0)
+		{
+			symbol = (unsigned char)(symbol + previousID);
+			previousID = symbol;
+		}
+		outRaw[i] = (char)symbol;
+	}
+
+	//the encoder started from RANS_LOW, so anything else means the data was damaged
+	return state == RANS_LOW && in == end;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// Training and benchmark
+//
+/////////////////////////////////////////////////////////////////////////////
+
+//a snapshot payload of count players wandering a screen sized world
+//used when training without captures and as the benchmark's workload
+static void BuildSimulatedSnapshot(std::mt19937& random, int count, uint32 sequence, std::vector<char>& outRaw)
+{
+	std::uniform_int_distribution<int> anyX(0, 799);
+	std::uniform_int_distribution<int> anyY(0, 449);
+	std::uniform_int_distribution<int> percent(0, 99);
+	std::uniform_int_distribution<int> speed(285, 315); //5 pixels a frame at 60fps, give or take frame timing
+	std::uniform_int_distribution<int> idGap(1, 3);
+
+	outRaw.assign(NETWORK_SNAPSHOT_HEADER_SIZE + count * NETWORK_PACKET_SIZE, 0);
+	SteamNetworkingMicroseconds serverTime = 60000000 + (SteamNetworkingMicroseconds)sequence * 16667;
+	SerializeInt((int)sequence, outRaw.data());
+	SerializeInt64(serverTime, outRaw.data() + 4);
+	SerializeInt64(serverTime - 40000 - percent(random) * 100, outRaw.data() + 12);
+	SerializeInt(percent(random) * 100, outRaw.data() + 20);
+	SerializeInt(count, outRaw.data() + 24);
+
+	int id = 0;
+	for (int i = 0; i < count; i++)
+	{
+		DataPacket entity;
+		entity.id = (char)id;
+		entity.posX = anyX(random);
+		entity.posY = anyY(random);
+		entity.velX = 0;
+		entity.velY = 0;
+
+		//most players are stood still at any moment, the rest walk along one or both axes
+		int movement = percent(random);
+		if (movement >= 55)
+			entity.velX = (percent(random) < 50 ? -1 : 1) * speed(random);
+		if (movement >= 80)
+			entity.velY = (percent(random) < 50 ? -1 : 1) * speed(random);
+		if (movement >= 45 && movement < 55)
+			entity.velY = (percent(random) < 50 ? -1 : 1) * speed(random);
+
+		SerializeDataPacket(entity, outRaw.data() + NETWORK_SNAPSHOT_HEADER_SIZE + i * NETWORK_PACKET_SIZE);
+		id = std::min(id + idGap(random), 127);
+	}
+}
+
+//capture files are back to back [size:4][snapshot payload], as written by --capture-snapshots
+static int TrainDictionary(int argc, char** argv, int firstArg)
+{
+	if (firstArg >= argc)
+	{
+		printf("Usage:\n    raylib_game --train-dictionary OUT.dict [CAPTURE...]\n");
+		return 1;
+	}
+	const char* outPath = argv[firstArg];
+
+	SnapshotCodec codec;
+	int messages = 0;
+	for (int i = firstArg + 1; i < argc; i++)
+	{
+		FILE* pFile = fopen(argv[i], "rb");
+		if (pFile == nullptr)
+		{
+			printf("Can't open %s\n", argv[i]);
+			return 1;
+		}
+
+		char sizeBytes[4];
+		std::vector<char> raw;
+		while (fread(sizeBytes, 1, 4, pFile) == 4)
+		{
+			int size = DeserializeInt(sizeBytes);
+			if (size < 0 || size > 1 << 20)
+			{
+				break;
+			}
+			raw.resize(size);
+			if (fread(raw.data(), 1, size, pFile) != (size_t)size)
+			{
+				break;
+			}
+			codec.AddTrainingMessage(raw.data(), size, NETWORK_SNAPSHOT_HEADER_SIZE);
+			messages++;
+		}
+		fclose(pFile);
+	}
+
+	//nothing captured, so make do with a simulated game
+	if (messages == 0)
+	{
+		printf("No captures given, training on simulated snapshots\n");
+		std::mt19937 random(1);
+		std::vector<char> raw;
+		for (int sequence = 1; sequence <= 20000; sequence++)
+		{
+			BuildSimulatedSnapshot(random, 1 + sequence % 64, sequence, raw);
+			codec.AddTrainingMessage(raw.data(), (int)raw.size(), NETWORK_SNAPSHOT_HEADER_SIZE);
+			messages++;
+		}
+	}
+
+	codec.FinishTraining();
+	if (!codec.Save(outPath))
+	{
+		printf("Can't write %s\n", outPath);
+		return 1;
+	}
+	printf("Trained dictionary %08x on %d snapshots, saved to %s\n", codec.GetDictionaryID(), messages, outPath);
+	return 0;
+}
+
+//sizes are whole messages as they'd go on the wire, header and size fields included
+static int BenchmarkCodec(int argc, char** argv, int firstArg)
+{
+	const char* path = (firstArg < argc) ? argv[firstArg] : SNAPSHOT_DICTIONARY_PATH;
+	int iterations = (firstArg + 1 < argc) ? atoi(argv[firstArg + 1]) : 2000;
+
+	SnapshotCodec codec;
+	if (!codec.Load(path) || iterations <= 0)
+	{
+		printf("Can't load a dictionary from %s\nUsage:\n    raylib_game --bench-codec [DICTIONARY] [ITERATIONS]\n", path);
+		return 1;
+	}
+
+	printf("Dictionary %08x, %d snapshots per size\n", codec.GetDictionaryID(), iterations);
+	printf("%8s %8s %14s %14s %12s %12s %12s %12s\n", "entities", "raw B", "deflate B", "dictionary B",
+		"deflate enc", "deflate dec", "dict enc", "dict dec");
+
+	const int entityCounts[] = { 0, 1, 2, 4, 8, 16, 32, 64, 127 };
+	int deflateBreakEven = -1;
+	int dictionaryBreakEven = -1;
+	int rc = 0;
+	for (int count : entityCounts)
+	{
+		std::mt19937 random(count + 1);
+		std::vector<std::vector<char>> snapshots(iterations);
+		for (int i = 0; i < iterations; i++)
+		{
+			BuildSimulatedSnapshot(random, count, i + 1, snapshots[i]);
+		}
+
+		double deflateBytes = 0, dictionaryBytes = 0;
+		double deflateEncode = 0, deflateDecode = 0, dictionaryEncode = 0, dictionaryDecode = 0;
+		std::vector<char> packed, unpacked, inflated;
+		for (const std::vector<char>& raw : snapshots)
+		{
+			auto start = std::chrono::steady_clock::now();
+			int compressedSize = 0;
+			unsigned char* compressed = CompressData((const unsigned char*)raw.data(), (int)raw.size(), &compressedSize);
+			auto encoded = std::chrono::steady_clock::now();
+			//inflated the way networking.cpp does it, into a buffer of the size the message claims
+			inflated.resize(raw.size() + 1);
+			sinflate(inflated.data(), (int)inflated.size(), compressed, compressedSize);
+			auto decoded = std::chrono::steady_clock::now();
+			MemFree(compressed);
+
+			deflateBytes += NETWORK_HEADER_SIZE + 5 + compressedSize;
+			deflateEncode += std::chrono::duration<double, std::micro>(encoded - start).count();
+			deflateDecode += std::chrono::duration<double, std::micro>(decoded - encoded).count();
+
+			start = std::chrono::steady_clock::now();
+			packed.clear();
+			codec.Encode(raw.data(), (int)raw.size(), NETWORK_SNAPSHOT_HEADER_SIZE, packed);
+			encoded = std::chrono::steady_clock::now();
+			bool bDecoded = codec.Decode(packed.data(), (int)packed.size(), (int)raw.size(), unpacked);
+			decoded = std::chrono::steady_clock::now();
+
+			//a small wrong answer is no use
+			if (!bDecoded || unpacked != raw)
+			{
+				printf("Dictionary round trip failed with %d entities\n", count);
+				rc = 1;
+			}
+
+			dictionaryBytes += NETWORK_HEADER_SIZE + 4 + packed.size();
+			dictionaryEncode += std::chrono::duration<double, std::micro>(encoded - start).count();
+			dictionaryDecode += std::chrono::duration<double, std::micro>(decoded - encoded).count();
+		}
+
+		int rawBytes = NETWORK_HEADER_SIZE + (int)snapshots[0].size();
+		deflateBytes /= iterations;
+		dictionaryBytes /= iterations;
+		printf("%8d %8d %8.1f %4.0f%% %8.1f %4.0f%% %10.2fus %10.2fus %10.2fus %10.2fus\n", count, rawBytes,
+			deflateBytes, 100.0 * deflateBytes / rawBytes, dictionaryBytes, 100.0 * dictionaryBytes / rawBytes,
+			deflateEncode / iterations, deflateDecode / iterations, dictionaryEncode / iterations, dictionaryDecode / iterations);
+
+		if (deflateBreakEven < 0 && deflateBytes < rawBytes)
+			deflateBreakEven = count;
+		if (dictionaryBreakEven < 0 && dictionaryBytes < rawBytes)
+			dictionaryBreakEven = count;
+	}
+
+	printf("Break even: deflate from %d entities, dictionary from %d entities (-1 is never)\n", deflateBreakEven, dictionaryBreakEven);
+	fflush(stdout);
+	return rc;
+}
+
+int RunCodecTool(int argc, char** argv)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "--train-dictionary"))
+			return TrainDictionary(argc, argv, i + 1);
+		if (!strcmp(argv[i], "--bench-codec"))
+			return BenchmarkCodec(argc, argv, i + 1);
+	}
+	return -1;
+}
@@ -0,0 +1,80 @@
+// Snapshot codec
+// Snapshots are a handful of 17 byte records whose bytes are very predictable one by one: the
+// top bytes of every position are nearly always 0, velocities are 0 or the walking speed, ids
+// count up. Deflate has no time to learn that in a message this small, so instead a model of
+// every byte of a record is trained offline from captured snapshots and shipped with the game
+// as a dictionary, and messages are entropy coded against it with rANS.
+//
+// The client offers the id of its dictionary when it connects and the server only packs its
+// messages if it has the same one. To train a dictionary from a server's real traffic:
+//
+//     raylib_game server --capture-snapshots FILE          (on the server's command line)
+//     raylib_game --train-dictionary OUT.dict FILE...
+//
+// and to compare it against deflate and no compression at all:
+//
+//     raylib_game --bench-codec [DICTIONARY] [ITERATIONS]
+
+#ifndef SNAPSHOT_CODEC_H
+#define SNAPSHOT_CODEC_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "net_protocol.h"
+
+#define SNAPSHOT_DICTIONARY_PATH "resources/snapshot.dict"
+#define SNAPSHOT_DICTIONARY_MAGIC 0x43494453 //'SDIC'
+#define SNAPSHOT_DICTIONARY_VERSION 1
+
+//one model for the bytes outside the records, then one per byte of a record
+#define SNAPSHOT_CODEC_CONTEXT_OTHER 0
+#define SNAPSHOT_CODEC_CONTEXT_COUNT (1 + NETWORK_PACKET_SIZE)
+#define SNAPSHOT_CODEC_SCALE_BITS 12 //symbol frequencies add up to 1 << this
+
+//how a compressed message body was compressed, the byte after its uncompressed size
+#define NETWORK_COMPRESSION_DEFLATE 0
+#define NETWORK_COMPRESSION_DICTIONARY 1
+
+class SnapshotCodec
+{
+public:
+	//reads a dictionary written by Save, returns false if it's missing or not one
+	bool Load(const char* path);
+	bool Save(const char* path) const;
+	bool IsLoaded() const { return m_nDictionaryID != 0; }
+
+	//identifies the dictionary so both ends can check they have the same one, 0 if none is loaded
+	uint32 GetDictionaryID() const { return m_nDictionaryID; }
+
+	//counts the bytes of some raw messages, then turns the counts into a dictionary
+	//recordOffset is where the records start, their count is always the 4 bytes before that
+	void AddTrainingMessage(const char* raw, int rawSize, int recordOffset);
+	void FinishTraining();
+
+	//appends [record offset:1][rANS stream] to outPacked, returns false if the records don't fit in raw
+	//safe to call from several threads at once
+	bool Encode(const char* raw, int rawSize, int recordOffset, std::vector<char>& outPacked) const;
+
+	//replaces outRaw with exactly rawSize decoded bytes, returns false if packed is malformed
+	bool Decode(const char* packed, int packedSize, int rawSize, std::vector<char>& outRaw) const;
+
+private:
+	//works out every byte's context and transformed value
+	//ids are stored as the difference from the id before, so an ordered list is all 1s
+	bool MapSymbols(const char* raw, int rawSize, int recordOffset, std::vector<unsigned char>& outSymbols, std::vector<unsigned char>& outContexts) const;
+
+	//normalizes the counts into frequencies and builds the coding tables from them
+	void BuildTables();
+
+	uint16 m_Frequency[SNAPSHOT_CODEC_CONTEXT_COUNT][256] = {};
+	uint16 m_Start[SNAPSHOT_CODEC_CONTEXT_COUNT][256] = {};
+	std::vector<unsigned char> m_SlotSymbol; //the symbol for each of the 1 << SCALE_BITS slots, per context
+	std::vector<uint64> m_TrainingCounts;
+	uint32 m_nDictionaryID = 0;
+};
+
+//the dictionary this process packs with, loaded from SNAPSHOT_DICTIONARY_PATH when the library starts
+extern SnapshotCodec snapshotCodec;
+
+#endif // SNAPSHOT_CODEC_H
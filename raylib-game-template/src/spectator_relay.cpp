@@ -0,0 +1,504 @@
+// Spectator relay, see spectator_relay.h
+
+#define _CRT_SECURE_NO_WARNINGS
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include "net_conditions.h"
+#include "spectator_relay.h"
+
+//the process-wide instance, for the static callback and message handlers
+static SpectatorRelay* s_pRelayInstance = nullptr;
+
+//the ID and baseline the server sends when we connect, snapshots carry the whole world anyway
+//and spectators' codec offers and game events, the relay forwards snapshots as they are and nothing else
+static void RelayIgnoreMessage(const ISteamNetworkingMessage* pMsg, const char* payload, int payloadSize)
+{
+}
+
+static void RelayHandleSnapshot(const ISteamNetworkingMessage* pMsg, const char* payload, int payloadSize)
+{
+	s_pRelayInstance->OnUpstreamSnapshot(pMsg, payload, payloadSize);
+}
+
+static void RelayHandleView(const ISteamNetworkingMessage* pMsg, const char* payload, int payloadSize)
+{
+	s_pRelayInstance->OnSpectatorView(pMsg, payload);
+}
+
+//what the relay does with messages from the game server, in MessageType order
+static const MessageHandlerEntry upstreamHandlers[MESSAGE_TYPE_COUNT] =
+{
+	{ 9, RelayIgnoreMessage },						//MESSAGE_ASSIGN_ID
+	{ 5, RelayIgnoreMessage },						//MESSAGE_BASELINE
+	{ 0, nullptr },									//MESSAGE_PLAYER_STATE
+	{ NETWORK_SNAPSHOT_HEADER_SIZE, RelayHandleSnapshot },	//MESSAGE_SNAPSHOT
+	{ 0, nullptr },									//MESSAGE_ROLLBACK_INPUT
+	{ 0, nullptr },									//MESSAGE_ROLLBACK_SYNC
+	{ 0, nullptr },									//MESSAGE_ZONE_HELLO
+	{ 0, nullptr },									//MESSAGE_ZONE_ROUTE
+	{ 0, nullptr },									//MESSAGE_ZONE_HANDOFF
+	{ 0, nullptr },									//MESSAGE_ZONE_MIRROR
+	{ 0, nullptr },									//MESSAGE_ZONE_STATE
+	{ 0, nullptr },									//MESSAGE_ZONE_REMOVE
+	{ 0, nullptr },									//MESSAGE_SUBSCRIBE
+	{ 0, nullptr },									//MESSAGE_RESUME
+	{ 0, nullptr },									//MESSAGE_BASELINE_DELTA
+	{ 4, RelayIgnoreMessage },						//MESSAGE_JOIN_QUEUE
+	{ 0, nullptr },									//MESSAGE_CODEC_OFFER
+	{ 0, nullptr },									//MESSAGE_SNAPSHOT_PACKED
+	{ 0, nullptr },									//MESSAGE_GAME_EVENTS
+	{ 0, nullptr },									//MESSAGE_POSITION_CORRECTION
+};
+
+//what the relay does with messages from spectators, in MessageType order
+static const MessageHandlerEntry spectatorHandlers[MESSAGE_TYPE_COUNT] =
+{
+	{ 0, nullptr },									//MESSAGE_ASSIGN_ID
+	{ 0, nullptr },									//MESSAGE_BASELINE
+	{ NETWORK_PACKET_SIZE + 8, RelayHandleView },		//MESSAGE_PLAYER_STATE
+	{ 0, nullptr },									//MESSAGE_SNAPSHOT
+	{ 0, nullptr },									//MESSAGE_ROLLBACK_INPUT
+	{ 0, nullptr },									//MESSAGE_ROLLBACK_SYNC
+	{ 0, nullptr },									//MESSAGE_ZONE_HELLO
+	{ 0, nullptr },									//MESSAGE_ZONE_ROUTE
+	{ 0, nullptr },									//MESSAGE_ZONE_HANDOFF
+	{ 0, nullptr },									//MESSAGE_ZONE_MIRROR
+	{ 0, nullptr },									//MESSAGE_ZONE_STATE
+	{ 0, nullptr },									//MESSAGE_ZONE_REMOVE
+	{ 0, nullptr },									//MESSAGE_SUBSCRIBE
+	{ 0, nullptr },									//MESSAGE_RESUME
+	{ 0, nullptr },									//MESSAGE_BASELINE_DELTA
+	{ 0, nullptr },									//MESSAGE_JOIN_QUEUE
+	{ 4, RelayIgnoreMessage },						//MESSAGE_CODEC_OFFER
+	{ 0, nullptr },									//MESSAGE_SNAPSHOT_PACKED
+	{ 2, RelayIgnoreMessage },						//MESSAGE_GAME_EVENTS
+	{ 0, nullptr },									//MESSAGE_POSITION_CORRECTION
+};
+
+//writes a whole snapshot message, the same layout the game server sends
+//there's no clock sync through a relay, so the echo fields are left empty
+static int GetRelaySnapshotSize(int count)
+{
+	return NETWORK_HEADER_SIZE + NETWORK_SNAPSHOT_HEADER_SIZE + count * NETWORK_PACKET_SIZE;
+}
+
+static void WriteRelaySnapshot(uint32 sequence, SteamNetworkingMicroseconds serverTime, const DataPacket* entities, int count,
+	char* outMessage)
+{
+	WriteMessageHeader(MESSAGE_SNAPSHOT, outMessage);
+	char* snapshotHeader = outMessage + NETWORK_HEADER_SIZE;
+	SerializeInt((int)sequence, snapshotHeader);
+	SerializeInt64(serverTime, snapshotHeader + 4);
+	SerializeInt64(0, snapshotHeader + 12);
+	SerializeInt(0, snapshotHeader + 20);
+	SerializeInt(count, snapshotHeader + 24);
+
+	char* record = snapshotHeader + NETWORK_SNAPSHOT_HEADER_SIZE;
+	for (int i = 0; i < count; i++)
+	{
+		SerializeDataPacket(entities[i], record);
+		record += NETWORK_PACKET_SIZE;
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// SpectatorRelay
+//
+/////////////////////////////////////////////////////////////////////////////
+
+void SpectatorRelay::Run(const SteamNetworkingIPAddr& upstreamAddr, uint16 nPort, int delayMs, int interestRadius)
+{
+	s_pRelayInstance = this;
+	m_pInterface = SteamNetworkingSockets();
+	m_UpstreamAddr = upstreamAddr;
+	m_Delay = (SteamNetworkingMicroseconds)delayMs * 1000;
+	m_nInterestRadius = interestRadius;
+
+	SteamNetworkingIPAddr localAddr;
+	localAddr.Clear();
+	localAddr.m_port = nPort;
+	SteamNetworkingConfigValue_t opt;
+	opt.SetPtr(k_ESteamNetworkingConfig_Callback_ConnectionStatusChanged, (void*)SteamNetConnectionStatusChangedCallback);
+	m_hListenSock = m_pInterface->CreateListenSocketIP(localAddr, 1, &opt);
+	if (m_hListenSock == k_HSteamListenSocket_Invalid)
+		FatalError("Relay failed to listen on port %d", nPort);
+	m_hPollGroup = m_pInterface->CreatePollGroup();
+	if (m_hPollGroup == k_HSteamNetPollGroup_Invalid)
+		FatalError("Relay failed to create a poll group");
+
+	char szAddr[SteamNetworkingIPAddr::k_cchMaxString];
+	upstreamAddr.ToString(szAddr, sizeof(szAddr), true);
+	Printf("Relay listening on port %d for %s, delay %d ms, interest radius %d", nPort, szAddr, delayMs, interestRadius);
+
+	ConnectUpstream(SteamNetworkingUtils()->GetLocalTimestamp());
+}
+
+void SpectatorRelay::Update()
+{
+	while (m_hUpstream != k_HSteamNetConnection_Invalid)
+	{
+		ISteamNetworkingMessage* pIncomingMsg = nullptr;
+		int numMsgs = m_pInterface->ReceiveMessagesOnConnection(m_hUpstream, &pIncomingMsg, 1);
+		if (numMsgs <= 0)
+			break;
+
+		if (!DispatchNetworkMessage(upstreamHandlers, pIncomingMsg))
+		{
+			Printf("Relay dropped a malformed message from the server (%d bytes)", pIncomingMsg->m_cbSize);
+		}
+
+		pIncomingMsg->Release();
+	}
+
+	while (true)
+	{
+		ISteamNetworkingMessage* pIncomingMsg = nullptr;
+		int numMsgs = m_pInterface->ReceiveMessagesOnPollGroup(m_hPollGroup, &pIncomingMsg, 1);
+		if (numMsgs == 0)
+			break;
+		if (numMsgs < 0)
+			FatalError("Error checking for messages");
+
+		//spectators only ever send their view, anything else is just ignored
+		DispatchNetworkMessage(spectatorHandlers, pIncomingMsg);
+		pIncomingMsg->Release();
+	}
+
+	m_pInterface->RunCallbacks();
+
+	SteamNetworkingMicroseconds now = SteamNetworkingUtils()->GetLocalTimestamp();
+	ConnectUpstream(now);
+
+	//release everything that has waited out the delay
+	//snapshots are whole worlds, so only the newest one is worth sending on
+	bool bReleased = false;
+	SteamNetworkingMicroseconds serverTime = 0;
+	while (!m_Buffer.empty() && m_Buffer.front().releaseTime <= now)
+	{
+		m_World.swap(m_Buffer.front().entities);
+		serverTime = m_Buffer.front().serverTime;
+		m_Buffer.pop_front();
+		bReleased = true;
+	}
+
+	if (bReleased)
+	{
+		BroadcastSnapshot(serverTime);
+	}
+}
+
+void SpectatorRelay::Close()
+{
+	for (auto& spectator : m_Spectators)
+	{
+		m_pInterface->CloseConnection(spectator.conn, 0, "Relay Shutdown", true);
+	}
+	m_Spectators.clear();
+
+	m_pInterface->CloseConnection(m_hUpstream, 0, "Relay Shutdown", true);
+	m_hUpstream = k_HSteamNetConnection_Invalid;
+
+	m_pInterface->CloseListenSocket(m_hListenSock);
+	m_hListenSock = k_HSteamListenSocket_Invalid;
+
+	m_pInterface->DestroyPollGroup(m_hPollGroup);
+	m_hPollGroup = k_HSteamNetPollGroup_Invalid;
+
+	s_pRelayInstance = nullptr;
+}
+
+void SpectatorRelay::OnUpstreamSnapshot(const ISteamNetworkingMessage* pMsg, const char* payload, int payloadSize)
+{
+	//same newest-wins rule as a game client
+	uint32 sequence = (uint32)DeserializeInt(payload);
+	if (m_nUpstreamSequence != 0 && (int32)(sequence - m_nUpstreamSequence) <= 0)
+	{
+		return;
+	}
+
+	int count = DeserializeInt(payload, 24);
+	if (count < 0 || count > (payloadSize - NETWORK_SNAPSHOT_HEADER_SIZE) / NETWORK_PACKET_SIZE
+		|| payloadSize != NETWORK_SNAPSHOT_HEADER_SIZE + count * NETWORK_PACKET_SIZE)
+	{
+		Printf("Relay received a malformed snapshot");
+		return;
+	}
+	m_nUpstreamSequence = sequence;
+
+	BufferedSnapshot snapshot;
+	snapshot.releaseTime = pMsg->m_usecTimeReceived + m_Delay;
+	snapshot.serverTime = DeserializeInt64(payload + 4);
+	snapshot.entities.resize(count);
+	for (int i = 0; i < count; i++)
+	{
+		snapshot.entities[i] = DeserializeDataPacket(payload + NETWORK_SNAPSHOT_HEADER_SIZE + i * NETWORK_PACKET_SIZE);
+	}
+
+	m_Buffer.push_back(std::move(snapshot));
+}
+
+void SpectatorRelay::OnSpectatorView(const ISteamNetworkingMessage* pMsg, const char* payload)
+{
+	auto itSpectator = std::find_if(m_Spectators.begin(), m_Spectators.end(), [pMsg](const Spectator& spectator) {
+		return spectator.conn == pMsg->m_conn;
+		});
+	if (itSpectator == m_Spectators.end())
+	{
+		return;
+	}
+
+	DataPacket view = DeserializeDataPacket(payload);
+	itSpectator->view = { view.posX, view.posY };
+	itSpectator->bHasView = true;
+}
+
+void SpectatorRelay::SteamNetConnectionStatusChangedCallback(SteamNetConnectionStatusChangedCallback_t* pInfo)
+{
+	s_pRelayInstance->OnSteamNetConnectionStatusChanged(pInfo);
+}
+
+void SpectatorRelay::OnSteamNetConnectionStatusChanged(SteamNetConnectionStatusChangedCallback_t* pInfo)
+{
+	switch (pInfo->m_info.m_eState)
+	{
+	case k_ESteamNetworkingConnectionState_ClosedByPeer:
+	case k_ESteamNetworkingConnectionState_ProblemDetectedLocally:
+	{
+		if (pInfo->m_hConn == m_hUpstream)
+		{
+			//spectators stay connected and just see a frozen world until it's back
+			Printf("Relay lost the game server (%s)", pInfo->m_info.m_szEndDebug);
+			m_hUpstream = k_HSteamNetConnection_Invalid;
+		}
+		else
+		{
+			m_Spectators.erase(std::remove_if(m_Spectators.begin(), m_Spectators.end(), [pInfo](const Spectator& spectator) {
+				return spectator.conn == pInfo->m_hConn;
+				}), m_Spectators.end());
+		}
+
+		m_pInterface->CloseConnection(pInfo->m_hConn, 0, nullptr, false);
+		break;
+	}
+
+	case k_ESteamNetworkingConnectionState_Connecting:
+		//our own connection to the server is reported here too, only accept incoming ones
+		if (pInfo->m_info.m_hListenSocket == k_HSteamListenSocket_Invalid)
+		{
+			break;
+		}
+
+		if (m_pInterface->AcceptConnection(pInfo->m_hConn) != k_EResultOK
+			|| !m_pInterface->SetConnectionPollGroup(pInfo->m_hConn, m_hPollGroup))
+		{
+			m_pInterface->CloseConnection(pInfo->m_hConn, 0, nullptr, false);
+			Printf("Relay can't accept connection.  (It was already closed?)");
+			break;
+		}
+
+		AddSpectator(pInfo->m_hConn);
+		break;
+
+	case k_ESteamNetworkingConnectionState_Connected:
+		if (pInfo->m_hConn == m_hUpstream)
+		{
+			//tell the server we're only here to watch
+			char message[NETWORK_HEADER_SIZE];
+			WriteMessageHeader(MESSAGE_SUBSCRIBE, message);
+			SendNetworkMessage(m_hUpstream, message, sizeof(message), k_nSteamNetworkingSend_Reliable);
+
+			//a new connection may well be a new server, with its own sequence
+			m_nUpstreamSequence = 0;
+			Printf("Relay subscribed to the game server");
+		}
+		break;
+
+	default:
+		// Silences -Wswitch
+		break;
+	}
+}
+
+void SpectatorRelay::ConnectUpstream(SteamNetworkingMicroseconds now)
+{
+	if (m_hUpstream != k_HSteamNetConnection_Invalid
+		|| (m_LastConnectAttempt != 0 && now - m_LastConnectAttempt < RELAY_RECONNECT_INTERVAL))
+	{
+		return;
+	}
+	m_LastConnectAttempt = now;
+
+	SteamNetworkingConfigValue_t opt;
+	opt.SetPtr(k_ESteamNetworkingConfig_Callback_ConnectionStatusChanged, (void*)SteamNetConnectionStatusChangedCallback);
+	m_hUpstream = m_pInterface->ConnectByIPAddress(m_UpstreamAddr, 1, &opt);
+}
+
+//a spectator gets the same welcome a player would, so the normal client works as a spectator
+void SpectatorRelay::AddSpectator(HSteamNetConnection conn)
+{
+	char idMessage[NETWORK_HEADER_SIZE + 9];
+	WriteMessageHeader(MESSAGE_ASSIGN_ID, idMessage);
+	idMessage[NETWORK_HEADER_SIZE] = (char)NETWORK_SPECTATOR_ID;
+	SerializeInt64(0, idMessage + NETWORK_HEADER_SIZE + 1); //no session, there's nothing to reclaim
+	SendNetworkMessage(conn, idMessage, sizeof(idMessage), k_nSteamNetworkingSend_Reliable);
+
+	std::vector<char> baseline = BuildWorldBaseline(m_World);
+	SendNetworkMessage(conn, baseline.data(), (uint32)baseline.size(), k_nSteamNetworkingSend_Reliable);
+
+	m_Spectators.push_back({ conn, { 0, 0 }, false });
+}
+
+//sends the current world to every spectator in one go
+void SpectatorRelay::BroadcastSnapshot(SteamNetworkingMicroseconds serverTime)
+{
+	if (m_Spectators.empty())
+	{
+		return;
+	}
+	m_nSequence++;
+
+	//spectators without a filter all get the same bytes, so only build those once
+	std::vector<char> fullSnapshot;
+	std::vector<DataPacket> visible;
+	std::vector<SteamNetworkingMessage_t*> messages;
+	messages.reserve(m_Spectators.size());
+
+	for (auto& spectator : m_Spectators)
+	{
+		SteamNetworkingMessage_t* snapshotMsg;
+		if (m_nInterestRadius > 0 && spectator.bHasView)
+		{
+			visible.clear();
+			for (const DataPacket& entity : m_World)
+			{
+				if (abs(entity.posX - spectator.view.x) <= m_nInterestRadius && abs(entity.posY - spectator.view.y) <= m_nInterestRadius)
+				{
+					visible.push_back(entity);
+				}
+			}
+
+			snapshotMsg = SteamNetworkingUtils()->AllocateMessage(GetRelaySnapshotSize((int)visible.size()));
+			WriteRelaySnapshot(m_nSequence, serverTime, visible.data(), (int)visible.size(), (char*)snapshotMsg->m_pData);
+		}
+		else
+		{
+			if (fullSnapshot.empty())
+			{
+				fullSnapshot.resize(GetRelaySnapshotSize((int)m_World.size()));
+				WriteRelaySnapshot(m_nSequence, serverTime, m_World.data(), (int)m_World.size(), fullSnapshot.data());
+			}
+
+			snapshotMsg = SteamNetworkingUtils()->AllocateMessage((int)fullSnapshot.size());
+			memcpy(snapshotMsg->m_pData, fullSnapshot.data(), fullSnapshot.size());
+		}
+
+		snapshotMsg->m_conn = spectator.conn;
+		snapshotMsg->m_nFlags = k_nSteamNetworkingSend_Unreliable;
+		snapshotMsg->m_idxLane = NETWORK_LANE_UPDATES;
+		messages.push_back(snapshotMsg);
+	}
+
+	SendNetworkMessages((int)messages.size(), messages.data(), nullptr);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// Relay process
+//
+/////////////////////////////////////////////////////////////////////////////
+
+//set from the signal handler, the relay finishes its tick then shuts down
+static volatile sig_atomic_t s_bQuit = 0;
+
+static void OnQuitSignal(int signal)
+{
+	s_bQuit = 1;
+}
+
+static int PrintRelayUsage()
+{
+	printf("Usage:\n    raylib_game --relay [--upstream SERVER_ADDR] [--port PORT] [--delay MS] [--radius PIXELS]\n");
+	fflush(stdout);
+	return 1;
+}
+
+int RunRelayProcess(int argc, char** argv)
+{
+	bool bRelay = false;
+	const char* upstream = "127.0.0.1:7777";
+	int nPort = RELAY_DEFAULT_PORT;
+	int delayMs = 0;
+	int interestRadius = 0;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "--relay"))
+		{
+			bRelay = true;
+			continue;
+		}
+		if (i + 1 >= argc)
+		{
+			continue;
+		}
+
+		if (!strcmp(argv[i], "--upstream"))
+			upstream = argv[++i];
+		else if (!strcmp(argv[i], "--port"))
+			nPort = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--delay"))
+			delayMs = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--radius"))
+			interestRadius = atoi(argv[++i]);
+	}
+
+	if (!bRelay)
+	{
+		return -1;
+	}
+
+	if (nPort <= 0 || nPort > 65535 || delayMs < 0 || delayMs > RELAY_MAX_DELAY || interestRadius < 0)
+	{
+		return PrintRelayUsage();
+	}
+
+	SteamNetworkingIPAddr upstreamAddr;
+	upstreamAddr.Clear();
+	if (!upstreamAddr.ParseString(upstream))
+	{
+		return PrintRelayUsage();
+	}
+	if (upstreamAddr.m_port == 0)
+	{
+		upstreamAddr.m_port = 7777;
+	}
+
+	signal(SIGINT, OnQuitSignal);
+	signal(SIGTERM, OnQuitSignal);
+
+	InitNetworkLibrary();
+
+	SpectatorRelay relay;
+	relay.Run(upstreamAddr, (uint16)nPort, delayMs, interestRadius);
+	while (!s_bQuit)
+	{
+		UpdateNetworkConditions();
+		relay.Update();
+		std::this_thread::sleep_for(std::chrono::milliseconds(RELAY_TICK_INTERVAL));
+	}
+	relay.Close();
+
+#ifdef STEAMNETWORKINGSOCKETS_OPENSOURCE
+	GameNetworkingSockets_Kill();
+#else
+	SteamDatagramClient_Kill();
+#endif
+	return 0;
+}
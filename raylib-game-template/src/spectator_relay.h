@@ -0,0 +1,77 @@
+// Spectator relay
+// Subscribes to the game server once and fans its snapshots out to any number of spectators,
+// so watching the game costs the server one connection no matter how many are watching.
+// Snapshots can be held back by a fixed delay, and each spectator can be sent only what's
+// near the view position they report:
+//
+//     raylib_game --relay [--upstream 127.0.0.1:7777] [--port 7900] [--delay MS] [--radius PIXELS]
+//
+// then press S on the title screen to spectate through it
+
+#ifndef SPECTATOR_RELAY_H
+#define SPECTATOR_RELAY_H
+
+#include <deque>
+#include <vector>
+
+#include "net_protocol.h"
+
+#define RELAY_DEFAULT_PORT 7900
+#define RELAY_TICK_INTERVAL 16 //milliseconds between relay updates
+#define RELAY_RECONNECT_INTERVAL 1000000 //microseconds between attempts to reach the game server
+#define RELAY_MAX_DELAY 60000 //milliseconds, bounds the snapshot buffer
+
+class SpectatorRelay
+{
+public:
+	void Run(const SteamNetworkingIPAddr& upstreamAddr, uint16 nPort, int delayMs, int interestRadius);
+	void Update();
+	void Close();
+
+	void OnUpstreamSnapshot(const ISteamNetworkingMessage* pMsg, const char* payload, int payloadSize);
+	void OnSpectatorView(const ISteamNetworkingMessage* pMsg, const char* payload);
+
+private:
+	static void SteamNetConnectionStatusChangedCallback(SteamNetConnectionStatusChangedCallback_t* pInfo);
+	void OnSteamNetConnectionStatusChanged(SteamNetConnectionStatusChangedCallback_t* pInfo);
+
+	void ConnectUpstream(SteamNetworkingMicroseconds now);
+	void AddSpectator(HSteamNetConnection conn);
+	void BroadcastSnapshot(SteamNetworkingMicroseconds serverTime);
+
+	//a snapshot from the server, waiting out the delay
+	struct BufferedSnapshot
+	{
+		SteamNetworkingMicroseconds releaseTime;
+		SteamNetworkingMicroseconds serverTime;
+		std::vector<DataPacket> entities;
+	};
+
+	struct Spectator
+	{
+		HSteamNetConnection conn;
+		Vector2Int view; //where they're looking, from their player state
+		bool bHasView;
+	};
+
+	ISteamNetworkingSockets* m_pInterface = nullptr;
+
+	//the game server
+	SteamNetworkingIPAddr m_UpstreamAddr;
+	HSteamNetConnection m_hUpstream = k_HSteamNetConnection_Invalid;
+	SteamNetworkingMicroseconds m_LastConnectAttempt = 0;
+	uint32 m_nUpstreamSequence = 0; //newest snapshot we've taken from it
+
+	//the spectators
+	HSteamListenSocket m_hListenSock = k_HSteamListenSocket_Invalid;
+	HSteamNetPollGroup m_hPollGroup = k_HSteamNetPollGroup_Invalid;
+	std::vector<Spectator> m_Spectators;
+	uint32 m_nSequence = 0; //one sequence for every spectator, they all see the same stream
+
+	SteamNetworkingMicroseconds m_Delay = 0;
+	int m_nInterestRadius = 0; //0 sends everyone everything
+	std::deque<BufferedSnapshot> m_Buffer;
+	std::vector<DataPacket> m_World; //the newest released snapshot, new spectators get it as their baseline
+};
+
+#endif // SPECTATOR_RELAY_H
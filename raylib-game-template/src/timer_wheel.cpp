@@ -0,0 +1,194 @@
+// Hierarchical timer wheel, see timer_wheel.h
+
+#include "timer_wheel.h"
+
+//the extra slot holds the timers being fired, so callbacks can still cancel them
+#define TIMER_WHEEL_FIRING_SLOT (TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS)
+
+void TimerWheel::Init(SteamNetworkingMicroseconds now, int capacity)
+{
+	m_Timers.clear();
+	m_nFreeHead = -1;
+	m_nCount = 0;
+	m_nCurrentTick = 0;
+	m_StartTime = now;
+	for (int& head : m_SlotHeads)
+	{
+		head = -1;
+	}
+
+	m_Timers.reserve(capacity);
+	Grow();
+}
+
+TimerHandle TimerWheel::Schedule(SteamNetworkingMicroseconds when, TimerCallback callback, uint64 data)
+{
+	if (m_nFreeHead < 0)
+	{
+		Grow();
+	}
+
+	int index = m_nFreeHead;
+	Timer& timer = m_Timers[index];
+	m_nFreeHead = timer.next;
+
+	//anything already due fires on the next Advance, never the one running now
+	SteamNetworkingMicroseconds delay = when - m_StartTime;
+	uint64 tick = (delay > 0) ? (uint64)((delay + TIMER_WHEEL_RESOLUTION - 1) / TIMER_WHEEL_RESOLUTION) : 0;
+	timer.expireTick = (tick > m_nCurrentTick) ? tick : m_nCurrentTick + 1;
+	timer.callback = callback;
+	timer.data = data;
+	Link(index);
+	m_nCount++;
+
+	return ((uint64)timer.generation << 32) | (uint64)(index + 1);
+}
+
+bool TimerWheel::Cancel(TimerHandle handle)
+{
+	int index = (int)(handle & 0xFFFFFFFF) - 1;
+	if (index < 0 || index >= (int)m_Timers.size())
+	{
+		return false;
+	}
+
+	Timer& timer = m_Timers[index];
+	if (timer.slot < 0 || timer.generation != (uint32)(handle >> 32))
+	{
+		return false;
+	}
+
+	Unlink(index);
+	Free(index);
+	return true;
+}
+
+void TimerWheel::Advance(SteamNetworkingMicroseconds now)
+{
+	SteamNetworkingMicroseconds elapsed = now - m_StartTime;
+	uint64 targetTick = (elapsed > 0) ? (uint64)(elapsed / TIMER_WHEEL_RESOLUTION) : 0;
+
+	while (m_nCurrentTick < targetTick)
+	{
+		//nothing to wait for, skip straight there
+		if (m_nCount == 0)
+		{
+			m_nCurrentTick = targetTick;
+			return;
+		}
+
+		m_nCurrentTick++;
+
+		//a level wrapping round empties the next slot of the level above into it
+		for (int level = 1; level < TIMER_WHEEL_LEVELS; level++)
+		{
+			if ((m_nCurrentTick & ((1ull << (TIMER_WHEEL_BITS * level)) - 1)) != 0)
+			{
+				break;
+			}
+			Cascade(level);
+		}
+
+		//move the due slot aside and fire from there
+		int slot = (int)(m_nCurrentTick & (TIMER_WHEEL_SLOTS - 1));
+		int head = m_SlotHeads[slot];
+		m_SlotHeads[slot] = -1;
+		m_SlotHeads[TIMER_WHEEL_FIRING_SLOT] = head;
+		for (int index = head; index >= 0; index = m_Timers[index].next)
+		{
+			m_Timers[index].slot = TIMER_WHEEL_FIRING_SLOT;
+		}
+
+		while (m_SlotHeads[TIMER_WHEEL_FIRING_SLOT] >= 0)
+		{
+			int index = m_SlotHeads[TIMER_WHEEL_FIRING_SLOT];
+			TimerCallback callback = m_Timers[index].callback;
+			uint64 data = m_Timers[index].data;
+			Unlink(index);
+			Free(index);
+
+			//m_Timers can grow under us once this is called, so nothing above is held on to
+			callback(data, now);
+		}
+	}
+}
+
+//puts a timer in the slot for when it's due, relative to the current tick
+void TimerWheel::Link(int index)
+{
+	Timer& timer = m_Timers[index];
+	uint64 delta = (timer.expireTick > m_nCurrentTick) ? timer.expireTick - m_nCurrentTick : 0;
+
+	int level = 0;
+	while (level < TIMER_WHEEL_LEVELS - 1 && delta >= (1ull << (TIMER_WHEEL_BITS * (level + 1))))
+	{
+		level++;
+	}
+
+	//too far off for the wheel, it goes round the top level once and gets looked at again
+	uint64 slotTick = timer.expireTick;
+	if (delta >= (1ull << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)))
+	{
+		slotTick = m_nCurrentTick + (1ull << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS));
+	}
+
+	int slot = level * TIMER_WHEEL_SLOTS + (int)((slotTick >> (TIMER_WHEEL_BITS * level)) & (TIMER_WHEEL_SLOTS - 1));
+	timer.slot = slot;
+	timer.prev = -1;
+	timer.next = m_SlotHeads[slot];
+	if (timer.next >= 0)
+	{
+		m_Timers[timer.next].prev = index;
+	}
+	m_SlotHeads[slot] = index;
+}
+
+void TimerWheel::Unlink(int index)
+{
+	Timer& timer = m_Timers[index];
+	if (timer.prev >= 0)
+		m_Timers[timer.prev].next = timer.next;
+	else
+		m_SlotHeads[timer.slot] = timer.next;
+	if (timer.next >= 0)
+		m_Timers[timer.next].prev = timer.prev;
+}
+
+void TimerWheel::Free(int index)
+{
+	Timer& timer = m_Timers[index];
+	timer.slot = -1;
+	timer.generation++;
+	timer.next = m_nFreeHead;
+	m_nFreeHead = index;
+	m_nCount--;
+}
+
+//doubles the pool, the only time scheduling allocates
+void TimerWheel::Grow()
+{
+	int oldSize = (int)m_Timers.size();
+	int newSize = (oldSize > 0) ? oldSize * 2 : (m_Timers.capacity() > 0 ? (int)m_Timers.capacity() : 64);
+	m_Timers.resize(newSize);
+	for (int index = newSize - 1; index >= oldSize; index--)
+	{
+		m_Timers[index].slot = -1;
+		m_Timers[index].generation = 1;
+		m_Timers[index].next = m_nFreeHead;
+		m_nFreeHead = index;
+	}
+}
+
+//every timer in this level's slot for the current tick is due within the level below, so move them down
+void TimerWheel::Cascade(int level)
+{
+	int slot = level * TIMER_WHEEL_SLOTS + (int)((m_nCurrentTick >> (TIMER_WHEEL_BITS * level)) & (TIMER_WHEEL_SLOTS - 1));
+	int index = m_SlotHeads[slot];
+	m_SlotHeads[slot] = -1;
+	while (index >= 0)
+	{
+		int next = m_Timers[index].next;
+		Link(index);
+		index = next;
+	}
+}
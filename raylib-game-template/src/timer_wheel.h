@@ -0,0 +1,76 @@
+// Hierarchical timer wheel
+// Per-connection deadlines (a dropped player's resume grace, join queue updates) are kept here
+// rather than found by scanning every connection every tick. Scheduling, cancelling and firing
+// a timer are all O(1), however many there are.
+//
+// Time is cut into TIMER_WHEEL_RESOLUTION ticks. The first level has a slot per tick for the
+// next TIMER_WHEEL_SLOTS ticks, each level above covers TIMER_WHEEL_SLOTS times as much with the
+// same number of slots, and when the level below wraps round, the next slot up is emptied back
+// down into it. A timer is only ever moved once per level on its way down.
+//
+// Timers live in a pool sized up front, so scheduling one doesn't allocate unless the pool is full.
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <vector>
+
+#include "net_protocol.h"
+
+#define TIMER_WHEEL_RESOLUTION 1000 //microseconds per tick
+#define TIMER_WHEEL_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVELS 4 //64^4 ticks of 1ms is over 4 hours, anything later waits in the top level
+
+//what fires, data is whatever the timer was scheduled with
+typedef void (*TimerCallback)(uint64 data, SteamNetworkingMicroseconds now);
+
+//identifies a timer to cancel it, a handle to a timer that has since fired or been cancelled is harmless
+//0 is never a valid handle
+typedef uint64 TimerHandle;
+
+class TimerWheel
+{
+public:
+	//starts the wheel at now with room for capacity timers before it has to grow
+	void Init(SteamNetworkingMicroseconds now, int capacity);
+
+	//fires callback(data) at the first Advance at or after when
+	TimerHandle Schedule(SteamNetworkingMicroseconds when, TimerCallback callback, uint64 data);
+
+	//returns false if it had already fired or been cancelled
+	bool Cancel(TimerHandle handle);
+
+	//fires every timer due by now, a tick at a time
+	//callbacks can schedule and cancel timers, a timer scheduled from a callback fires no sooner than the next tick
+	void Advance(SteamNetworkingMicroseconds now);
+
+	int GetCount() const { return m_nCount; }
+
+private:
+	struct Timer
+	{
+		uint64 expireTick;
+		TimerCallback callback;
+		uint64 data;
+		int prev; //-1 at the head of a slot
+		int next; //-1 at the end of a slot, or the next free timer
+		int slot; //index into m_SlotHeads, -1 while free
+		uint32 generation; //bumped every time it's freed, so old handles don't match
+	};
+
+	void Link(int index);
+	void Unlink(int index);
+	void Free(int index);
+	void Grow();
+	void Cascade(int level);
+
+	std::vector<Timer> m_Timers;
+	int m_SlotHeads[TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS + 1]; //plus the slot being fired
+	int m_nFreeHead = -1;
+	int m_nCount = 0;
+	uint64 m_nCurrentTick = 0; //every tick up to and including this one has fired
+	SteamNetworkingMicroseconds m_StartTime = 0;
+};
+
+#endif // TIMER_WHEEL_H
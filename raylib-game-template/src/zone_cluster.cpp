@@ -0,0 +1,1119 @@
+// Zone-sharded server cluster, see zone_cluster.h
+
+#define _CRT_SECURE_NO_WARNINGS
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <string>
+#include <thread>
+
+#include "alloc_audit.h"
+#include "metrics.h"
+#include "net_conditions.h"
+#include "zone_cluster.h"
+
+#ifdef _WIN32
+#define NOMINMAX // we want std::min/std::max, not the windows.h macros
+#include <windows.h> // CreateProcess, for the coordinator
+#else
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#endif
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+
+//each entity in a zone state report: [DataPacket][owner epoch:4]
+#define ZONE_STATE_RECORD_SIZE (NETWORK_PACKET_SIZE + 4)
+
+//microseconds without a report before the front forgets an entity
+#define ZONE_ENTITY_TIMEOUT 2000000
+
+//the front listens where game clients already look for a server
+#define ZONE_FRONT_PORT 7777
+
+int GetZoneForPosition(int posX, int numZones)
+{
+	int zone = (int)((int64)posX * numZones / ZONE_WORLD_WIDTH);
+	return std::max(0, std::min(zone, numZones - 1));
+}
+
+//left edge of a zone's strip, zone numZones gives the right edge of the world
+static int GetZoneLeftEdge(int zone, int numZones)
+{
+	return zone * ZONE_WORLD_WIDTH / numZones;
+}
+
+//builds a [DataPacket][epoch] message, the layout shared by routes and handoffs
+static void WriteEntityMessage(MessageType type, int id, const RemoteEntity& state, Vector2Int position, uint32 epoch,
+	char* outMessage)
+{
+	DataPacket packet;
+	packet.id = (char)id;
+	packet.posX = position.x;
+	packet.posY = position.y;
+	packet.velX = state.velocity.x;
+	packet.velY = state.velocity.y;
+
+	WriteMessageHeader(type, outMessage);
+	SerializeDataPacket(packet, outMessage + NETWORK_HEADER_SIZE);
+	SerializeInt((int)epoch, outMessage + NETWORK_HEADER_SIZE + NETWORK_PACKET_SIZE);
+}
+
+//the process-wide instances, for the static callbacks and message handlers
+static ZoneServer* s_pZoneInstance = nullptr;
+static ZoneFront* s_pFrontInstance = nullptr;
+
+static void ZoneHandleHello(const ISteamNetworkingMessage* pMsg, const char* payload, int payloadSize)
+{
+	s_pZoneInstance->OnHello(pMsg, payload);
+}
+
+static void ZoneHandleRoute(const ISteamNetworkingMessage* pMsg, const char* payload, int payloadSize)
+{
+	s_pZoneInstance->OnRoute(pMsg, payload);
+}
+
+static void ZoneHandleHandoff(const ISteamNetworkingMessage* pMsg, const char* payload, int payloadSize)
+{
+	s_pZoneInstance->OnHandoff(pMsg, payload);
+}
+
+static void ZoneHandleMirror(const ISteamNetworkingMessage* pMsg, const char* payload, int payloadSize)
+{
+	s_pZoneInstance->OnMirror(pMsg, payload, payloadSize);
+}
+
+static void ZoneHandleRemove(const ISteamNetworkingMessage* pMsg, const char* payload, int payloadSize)
+{
+	s_pZoneInstance->OnRemove(pMsg, payload);
+}
+
+static void FrontHandleZoneState(const ISteamNetworkingMessage* pMsg, const char* payload, int payloadSize)
+{
+	s_pFrontInstance->OnZoneState(pMsg, payload, payloadSize);
+}
+
+//what a zone does with each message type, in MessageType order
+static const MessageHandlerEntry zoneHandlers[MESSAGE_TYPE_COUNT] =
+{
+	{ 0, nullptr },									//MESSAGE_ASSIGN_ID
+	{ 0, nullptr },									//MESSAGE_BASELINE
+	{ 0, nullptr },									//MESSAGE_PLAYER_STATE
+	{ 0, nullptr },									//MESSAGE_SNAPSHOT
+	{ 0, nullptr },									//MESSAGE_ROLLBACK_INPUT
+	{ 0, nullptr },									//MESSAGE_ROLLBACK_SYNC
+	{ 2, ZoneHandleHello },							//MESSAGE_ZONE_HELLO
+	{ NETWORK_PACKET_SIZE + 4, ZoneHandleRoute },		//MESSAGE_ZONE_ROUTE
+	{ NETWORK_PACKET_SIZE + 4, ZoneHandleHandoff },		//MESSAGE_ZONE_HANDOFF
+	{ 4, ZoneHandleMirror },							//MESSAGE_ZONE_MIRROR
+	{ 0, nullptr },									//MESSAGE_ZONE_STATE
+	{ 1, ZoneHandleRemove },							//MESSAGE_ZONE_REMOVE
+	{ 0, nullptr },									//MESSAGE_SUBSCRIBE
+	{ 0, nullptr },									//MESSAGE_RESUME
+	{ 0, nullptr },									//MESSAGE_BASELINE_DELTA
+	{ 0, nullptr },									//MESSAGE_JOIN_QUEUE
+	{ 0, nullptr },									//MESSAGE_CODEC_OFFER
+	{ 0, nullptr },									//MESSAGE_SNAPSHOT_PACKED
+	{ 0, nullptr },									//MESSAGE_GAME_EVENTS
+	{ 0, nullptr },									//MESSAGE_POSITION_CORRECTION
+};
+
+//what the front does with messages from the zones, in MessageType order
+static const MessageHandlerEntry frontHandlers[MESSAGE_TYPE_COUNT] =
+{
+	{ 0, nullptr },									//MESSAGE_ASSIGN_ID
+	{ 0, nullptr },									//MESSAGE_BASELINE
+	{ 0, nullptr },									//MESSAGE_PLAYER_STATE
+	{ 0, nullptr },									//MESSAGE_SNAPSHOT
+	{ 0, nullptr },									//MESSAGE_ROLLBACK_INPUT
+	{ 0, nullptr },									//MESSAGE_ROLLBACK_SYNC
+	{ 0, nullptr },									//MESSAGE_ZONE_HELLO
+	{ 0, nullptr },									//MESSAGE_ZONE_ROUTE
+	{ 0, nullptr },									//MESSAGE_ZONE_HANDOFF
+	{ 0, nullptr },									//MESSAGE_ZONE_MIRROR
+	{ 4, FrontHandleZoneState },						//MESSAGE_ZONE_STATE
+	{ 0, nullptr },									//MESSAGE_ZONE_REMOVE
+	{ 0, nullptr },									//MESSAGE_SUBSCRIBE
+	{ 0, nullptr },									//MESSAGE_RESUME
+	{ 0, nullptr },									//MESSAGE_BASELINE_DELTA
+	{ 0, nullptr },									//MESSAGE_JOIN_QUEUE
+	{ 0, nullptr },									//MESSAGE_CODEC_OFFER
+	{ 0, nullptr },									//MESSAGE_SNAPSHOT_PACKED
+	{ 0, nullptr },									//MESSAGE_GAME_EVENTS
+	{ 0, nullptr },									//MESSAGE_POSITION_CORRECTION
+};
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// ZoneServer
+//
+/////////////////////////////////////////////////////////////////////////////
+
+void ZoneServer::Run(int zoneIndex, int numZones)
+{
+	s_pZoneInstance = this;
+	m_pInterface = SteamNetworkingSockets();
+	m_nZoneIndex = zoneIndex;
+	m_nNumZones = numZones;
+
+	//only ever reached over loopback, by the front and the zone to our left
+	uint16 nPort = (uint16)(ZONE_BASE_PORT + zoneIndex);
+	SteamNetworkingIPAddr localAddr;
+	localAddr.Clear();
+	localAddr.SetIPv4(0x7f000001, nPort);
+	SteamNetworkingConfigValue_t opt;
+	opt.SetPtr(k_ESteamNetworkingConfig_Callback_ConnectionStatusChanged, (void*)SteamNetConnectionStatusChangedCallback);
+	m_hListenSock = m_pInterface->CreateListenSocketIP(localAddr, 1, &opt);
+	if (m_hListenSock == k_HSteamListenSocket_Invalid)
+		FatalError("Zone %d failed to listen on port %d", zoneIndex, nPort);
+	m_hPollGroup = m_pInterface->CreatePollGroup();
+	if (m_hPollGroup == k_HSteamNetPollGroup_Invalid)
+		FatalError("Zone %d failed to create a poll group", zoneIndex);
+
+	Printf("Zone %d of %d listening on port %d, x %d to %d", zoneIndex, numZones, nPort,
+		GetZoneLeftEdge(zoneIndex, numZones), GetZoneLeftEdge(zoneIndex + 1, numZones));
+}
+
+void ZoneServer::Update()
+{
+	while (true)
+	{
+		ISteamNetworkingMessage* pIncomingMsg = nullptr;
+		int numMsgs = m_pInterface->ReceiveMessagesOnPollGroup(m_hPollGroup, &pIncomingMsg, 1);
+		if (numMsgs == 0)
+			break;
+		if (numMsgs < 0)
+			FatalError("Error checking for messages");
+
+		if (!DispatchNetworkMessage(zoneHandlers, pIncomingMsg))
+		{
+			Printf("Zone %d dropped a malformed message (%d bytes)", m_nZoneIndex, pIncomingMsg->m_cbSize);
+		}
+
+		pIncomingMsg->Release();
+	}
+
+	m_pInterface->RunCallbacks();
+
+	SteamNetworkingMicroseconds now = SteamNetworkingUtils()->GetLocalTimestamp();
+	ConnectToRightNeighbour(now);
+
+	for (auto it = m_Mirrored.begin(); it != m_Mirrored.end();)
+	{
+		it = (now - it->second.state.updateTime > ZONE_MIRROR_TIMEOUT) ? m_Mirrored.erase(it) : std::next(it);
+	}
+	for (auto it = m_HandedOff.begin(); it != m_HandedOff.end();)
+	{
+		it = (now - it->second.time > ZONE_FORWARD_TIMEOUT) ? m_HandedOff.erase(it) : std::next(it);
+	}
+
+	SendHandoffs(now);
+	SendMirrors(now);
+	SendStateToFront(now);
+}
+
+void ZoneServer::Close()
+{
+	m_pInterface->CloseConnection(m_hFront, 0, "Zone Shutdown", true);
+	m_pInterface->CloseConnection(m_hLeftZone, 0, "Zone Shutdown", true);
+	m_pInterface->CloseConnection(m_hRightZone, 0, "Zone Shutdown", true);
+	m_hFront = m_hLeftZone = m_hRightZone = k_HSteamNetConnection_Invalid;
+
+	m_pInterface->CloseListenSocket(m_hListenSock);
+	m_hListenSock = k_HSteamListenSocket_Invalid;
+
+	m_pInterface->DestroyPollGroup(m_hPollGroup);
+	m_hPollGroup = k_HSteamNetPollGroup_Invalid;
+
+	s_pZoneInstance = nullptr;
+}
+
+void ZoneServer::OnHello(const ISteamNetworkingMessage* pMsg, const char* payload)
+{
+	ZonePeerRole role = (ZonePeerRole)payload[0];
+	int zone = payload[1];
+
+	if (role == ZONE_PEER_FRONT)
+	{
+		m_hFront = pMsg->m_conn;
+		Printf("Zone %d is reporting to the front", m_nZoneIndex);
+	}
+	else if (role == ZONE_PEER_ZONE && zone == m_nZoneIndex - 1)
+	{
+		m_hLeftZone = pMsg->m_conn;
+		Printf("Zone %d linked with zone %d", m_nZoneIndex, zone);
+	}
+	else
+	{
+		Printf("Zone %d refused a peer claiming to be zone %d", m_nZoneIndex, zone);
+		m_pInterface->CloseConnection(pMsg->m_conn, 0, "Not a neighbour", false);
+	}
+}
+
+void ZoneServer::OnRoute(const ISteamNetworkingMessage* pMsg, const char* payload)
+{
+	//only the front routes, anything else on the loopback port could be anyone
+	if (m_hFront == k_HSteamNetConnection_Invalid || pMsg->m_conn != m_hFront)
+	{
+		return;
+	}
+
+	DataPacket packet = DeserializeDataPacket(payload);
+	uint32 epoch = (uint32)DeserializeInt(payload, NETWORK_PACKET_SIZE);
+	RemoteEntity state = { { packet.posX, packet.posY }, { packet.velX, packet.velY }, pMsg->m_usecTimeReceived };
+
+	auto itOwned = m_Owned.find(packet.id);
+	if (itOwned != m_Owned.end())
+	{
+		itOwned->second.state = state;
+		return;
+	}
+
+	//the front hasn't caught up with a handoff yet, pass it along to where it went
+	auto itHandedOff = m_HandedOff.find(packet.id);
+	if (itHandedOff != m_HandedOff.end())
+	{
+		SendToZone(itHandedOff->second.zone, (const char*)pMsg->m_pData, pMsg->m_cbSize, k_nSteamNetworkingSend_Unreliable);
+		return;
+	}
+
+	//a neighbour is still mirroring it to us, so it's theirs until they hand it over
+	//claiming it now would have two zones owning it
+	auto itMirrored = m_Mirrored.find(packet.id);
+	if (itMirrored != m_Mirrored.end())
+	{
+		SendToZone(itMirrored->second.zone, (const char*)pMsg->m_pData, pMsg->m_cbSize, k_nSteamNetworkingSend_Unreliable);
+		return;
+	}
+
+	//nobody has it, so it's ours now
+	//one past the front's epoch so our reports win over whoever had it last
+	m_Owned[packet.id] = { state, epoch + 1 };
+	m_Mirrored.erase(packet.id);
+	Printf("Zone %d took ownership of entity %d", m_nZoneIndex, packet.id);
+}
+
+void ZoneServer::OnHandoff(const ISteamNetworkingMessage* pMsg, const char* payload)
+{
+	if (!IsNeighbour(pMsg->m_conn))
+	{
+		return;
+	}
+
+	DataPacket packet = DeserializeDataPacket(payload);
+	uint32 epoch = (uint32)DeserializeInt(payload, NETWORK_PACKET_SIZE);
+
+	m_Owned[packet.id] = { { { packet.posX, packet.posY }, { packet.velX, packet.velY }, pMsg->m_usecTimeReceived }, epoch + 1 };
+	m_Mirrored.erase(packet.id);
+	m_HandedOff.erase(packet.id);
+}
+
+void ZoneServer::OnMirror(const ISteamNetworkingMessage* pMsg, const char* payload, int payloadSize)
+{
+	if (!IsNeighbour(pMsg->m_conn))
+	{
+		return;
+	}
+
+	int count = DeserializeInt(payload);
+	if (count < 0 || count > (payloadSize - 4) / NETWORK_PACKET_SIZE || payloadSize != 4 + count * NETWORK_PACKET_SIZE)
+	{
+		Printf("Zone %d received a malformed mirror", m_nZoneIndex);
+		return;
+	}
+	int zone = (pMsg->m_conn == m_hLeftZone) ? m_nZoneIndex - 1 : m_nZoneIndex + 1;
+
+	for (int i = 0; i < count; i++)
+	{
+		DataPacket packet = DeserializeDataPacket(payload + 4 + i * NETWORK_PACKET_SIZE);
+
+		//a mirror can cross a handoff in flight, what we own is always more up to date
+		if (m_Owned.find(packet.id) == m_Owned.end())
+		{
+			m_Mirrored[packet.id] = { { { packet.posX, packet.posY }, { packet.velX, packet.velY }, pMsg->m_usecTimeReceived }, zone };
+		}
+	}
+}
+
+void ZoneServer::OnRemove(const ISteamNetworkingMessage* pMsg, const char* payload)
+{
+	if (m_hFront == k_HSteamNetConnection_Invalid || pMsg->m_conn != m_hFront)
+	{
+		return;
+	}
+
+	int id = payload[0];
+	m_Owned.erase(id);
+	m_Mirrored.erase(id);
+	m_HandedOff.erase(id);
+}
+
+void ZoneServer::SteamNetConnectionStatusChangedCallback(SteamNetConnectionStatusChangedCallback_t* pInfo)
+{
+	s_pZoneInstance->OnSteamNetConnectionStatusChanged(pInfo);
+}
+
+void ZoneServer::OnSteamNetConnectionStatusChanged(SteamNetConnectionStatusChangedCallback_t* pInfo)
+{
+	switch (pInfo->m_info.m_eState)
+	{
+	case k_ESteamNetworkingConnectionState_ClosedByPeer:
+	case k_ESteamNetworkingConnectionState_ProblemDetectedLocally:
+	{
+		//a neighbour or the front went away, the coordinator will bring it back
+		if (pInfo->m_hConn == m_hRightZone)
+		{
+			Printf("Zone %d lost zone %d (%s)", m_nZoneIndex, m_nZoneIndex + 1, pInfo->m_info.m_szEndDebug);
+			m_hRightZone = k_HSteamNetConnection_Invalid;
+			m_bRightZoneConnected = false;
+		}
+		else if (pInfo->m_hConn == m_hLeftZone)
+		{
+			Printf("Zone %d lost zone %d (%s)", m_nZoneIndex, m_nZoneIndex - 1, pInfo->m_info.m_szEndDebug);
+			m_hLeftZone = k_HSteamNetConnection_Invalid;
+		}
+		else if (pInfo->m_hConn == m_hFront)
+		{
+			Printf("Zone %d lost the front (%s)", m_nZoneIndex, pInfo->m_info.m_szEndDebug);
+			m_hFront = k_HSteamNetConnection_Invalid;
+		}
+
+		m_pInterface->CloseConnection(pInfo->m_hConn, 0, nullptr, false);
+		break;
+	}
+
+	case k_ESteamNetworkingConnectionState_Connecting:
+		//our own connection to the right is reported here too, only accept incoming ones
+		if (pInfo->m_info.m_hListenSocket == k_HSteamListenSocket_Invalid)
+		{
+			break;
+		}
+
+		//they'll say who they are in their hello
+		if (m_pInterface->AcceptConnection(pInfo->m_hConn) != k_EResultOK
+			|| !m_pInterface->SetConnectionPollGroup(pInfo->m_hConn, m_hPollGroup))
+		{
+			m_pInterface->CloseConnection(pInfo->m_hConn, 0, nullptr, false);
+			Printf("Zone %d can't accept connection.  (It was already closed?)", m_nZoneIndex);
+		}
+		break;
+
+	case k_ESteamNetworkingConnectionState_Connected:
+		if (pInfo->m_hConn == m_hRightZone)
+		{
+			char message[NETWORK_HEADER_SIZE + 2];
+			WriteMessageHeader(MESSAGE_ZONE_HELLO, message);
+			message[NETWORK_HEADER_SIZE] = (char)ZONE_PEER_ZONE;
+			message[NETWORK_HEADER_SIZE + 1] = (char)m_nZoneIndex;
+			SendNetworkMessage(m_hRightZone, message, sizeof(message), k_nSteamNetworkingSend_Reliable);
+
+			m_bRightZoneConnected = true;
+			Printf("Zone %d linked with zone %d", m_nZoneIndex, m_nZoneIndex + 1);
+		}
+		break;
+
+	default:
+		// Silences -Wswitch
+		break;
+	}
+}
+
+//we always dial the zone to our right, so each neighbour pair shares one connection
+void ZoneServer::ConnectToRightNeighbour(SteamNetworkingMicroseconds now)
+{
+	if (m_nZoneIndex + 1 >= m_nNumZones || m_hRightZone != k_HSteamNetConnection_Invalid
+		|| (m_LastConnectAttempt != 0 && now - m_LastConnectAttempt < ZONE_RECONNECT_INTERVAL))
+	{
+		return;
+	}
+	m_LastConnectAttempt = now;
+
+	SteamNetworkingIPAddr addr;
+	addr.Clear();
+	addr.SetIPv4(0x7f000001, (uint16)(ZONE_BASE_PORT + m_nZoneIndex + 1));
+	SteamNetworkingConfigValue_t opt;
+	opt.SetPtr(k_ESteamNetworkingConfig_Callback_ConnectionStatusChanged, (void*)SteamNetConnectionStatusChangedCallback);
+	m_hRightZone = m_pInterface->ConnectByIPAddress(addr, 1, &opt);
+	if (m_hRightZone != k_HSteamNetConnection_Invalid)
+	{
+		m_pInterface->SetConnectionPollGroup(m_hRightZone, m_hPollGroup);
+	}
+}
+
+//a usable connection to a neighbouring zone, or k_HSteamNetConnection_Invalid
+HSteamNetConnection ZoneServer::GetConnectionToZone(int zone) const
+{
+	if (zone == m_nZoneIndex - 1)
+	{
+		return m_hLeftZone;
+	}
+	if (zone == m_nZoneIndex + 1 && m_bRightZoneConnected)
+	{
+		return m_hRightZone;
+	}
+	return k_HSteamNetConnection_Invalid;
+}
+
+//handoffs and mirrors only count from the zones either side of us, not just anything that connected
+bool ZoneServer::IsNeighbour(HSteamNetConnection conn) const
+{
+	return conn != k_HSteamNetConnection_Invalid && (conn == m_hLeftZone || conn == m_hRightZone);
+}
+
+void ZoneServer::SendToZone(int zone, const char* message, int size, int sendFlags)
+{
+	HSteamNetConnection conn = GetConnectionToZone(zone);
+	if (conn != k_HSteamNetConnection_Invalid)
+	{
+		SendNetworkMessage(conn, message, size, sendFlags);
+	}
+}
+
+//passes on anything that has left our strip
+//entities only ever move one zone at a time, a fast one just keeps getting passed along
+void ZoneServer::SendHandoffs(SteamNetworkingMicroseconds now)
+{
+	int leftEdge = GetZoneLeftEdge(m_nZoneIndex, m_nNumZones);
+	int rightEdge = GetZoneLeftEdge(m_nZoneIndex + 1, m_nNumZones);
+
+	for (auto it = m_Owned.begin(); it != m_Owned.end();)
+	{
+		Vector2Int position = ExtrapolatePosition(it->second.state, now);
+
+		int targetZone = m_nZoneIndex;
+		if (position.x < leftEdge - ZONE_HANDOFF_MARGIN && m_nZoneIndex > 0)
+		{
+			targetZone = m_nZoneIndex - 1;
+		}
+		else if (position.x >= rightEdge + ZONE_HANDOFF_MARGIN && m_nZoneIndex + 1 < m_nNumZones)
+		{
+			targetZone = m_nZoneIndex + 1;
+		}
+
+		//if the neighbour is down we hang on to it until it's back
+		HSteamNetConnection conn = GetConnectionToZone(targetZone);
+		if (targetZone == m_nZoneIndex || conn == k_HSteamNetConnection_Invalid)
+		{
+			++it;
+			continue;
+		}
+
+		char message[NETWORK_HEADER_SIZE + NETWORK_PACKET_SIZE + 4];
+		WriteEntityMessage(MESSAGE_ZONE_HANDOFF, it->first, it->second.state, position, it->second.epoch, message);
+		SendNetworkMessage(conn, message, sizeof(message), k_nSteamNetworkingSend_Reliable);
+
+		Printf("Zone %d handed entity %d to zone %d", m_nZoneIndex, it->first, targetZone);
+		m_HandedOff[it->first] = { targetZone, now };
+		it = m_Owned.erase(it);
+	}
+}
+
+//shares what's near each border with the zone on the other side,
+//so it knows we still own them and passes on any updates routed to it early rather than claiming them
+void ZoneServer::SendMirrors(SteamNetworkingMicroseconds now)
+{
+	int leftEdge = GetZoneLeftEdge(m_nZoneIndex, m_nNumZones);
+	int rightEdge = GetZoneLeftEdge(m_nZoneIndex + 1, m_nNumZones);
+
+	for (int side = 0; side < 2; side++)
+	{
+		int neighbour = (side == 0) ? m_nZoneIndex - 1 : m_nZoneIndex + 1;
+		HSteamNetConnection conn = GetConnectionToZone(neighbour);
+		if (conn == k_HSteamNetConnection_Invalid)
+		{
+			continue;
+		}
+
+		std::vector<char> message(NETWORK_HEADER_SIZE + 4);
+		WriteMessageHeader(MESSAGE_ZONE_MIRROR, message.data());
+		int count = 0;
+		for (auto& owned : m_Owned)
+		{
+			Vector2Int position = ExtrapolatePosition(owned.second.state, now);
+			bool bNearBorder = (side == 0) ? position.x < leftEdge + ZONE_BORDER_WIDTH : position.x >= rightEdge - ZONE_BORDER_WIDTH;
+			if (!bNearBorder)
+			{
+				continue;
+			}
+
+			DataPacket packet = { (char)owned.first, position.x, position.y, owned.second.state.velocity.x, owned.second.state.velocity.y };
+			message.resize(message.size() + NETWORK_PACKET_SIZE);
+			SerializeDataPacket(packet, message.data() + message.size() - NETWORK_PACKET_SIZE);
+			count++;
+		}
+
+		if (count > 0)
+		{
+			SerializeInt(count, message.data() + NETWORK_HEADER_SIZE);
+			SendNetworkMessage(conn, message.data(), (uint32)message.size(), k_nSteamNetworkingSend_Unreliable);
+		}
+	}
+}
+
+//tells the front where everything we own is, it builds the clients' snapshots from this
+void ZoneServer::SendStateToFront(SteamNetworkingMicroseconds now)
+{
+	if (m_hFront == k_HSteamNetConnection_Invalid || m_Owned.empty())
+	{
+		return;
+	}
+
+	std::vector<char> message(NETWORK_HEADER_SIZE + 4 + m_Owned.size() * ZONE_STATE_RECORD_SIZE);
+	WriteMessageHeader(MESSAGE_ZONE_STATE, message.data());
+	SerializeInt((int)m_Owned.size(), message.data() + NETWORK_HEADER_SIZE);
+
+	char* record = message.data() + NETWORK_HEADER_SIZE + 4;
+	for (auto& owned : m_Owned)
+	{
+		Vector2Int position = ExtrapolatePosition(owned.second.state, now);
+		DataPacket packet = { (char)owned.first, position.x, position.y, owned.second.state.velocity.x, owned.second.state.velocity.y };
+		SerializeDataPacket(packet, record);
+		SerializeInt((int)owned.second.epoch, record + NETWORK_PACKET_SIZE);
+		record += ZONE_STATE_RECORD_SIZE;
+	}
+
+	SendNetworkMessage(m_hFront, message.data(), (uint32)message.size(), k_nSteamNetworkingSend_Unreliable);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// ZoneFront
+//
+/////////////////////////////////////////////////////////////////////////////
+
+void ZoneFront::Start(int numZones)
+{
+	s_pFrontInstance = this;
+	m_pInterface = SteamNetworkingSockets();
+	m_nNumZones = numZones;
+
+	//the zones get their own poll group, so the server's loop only ever sees clients
+	m_hPollGroup = m_pInterface->CreatePollGroup();
+	if (m_hPollGroup == k_HSteamNetPollGroup_Invalid)
+		FatalError("Front failed to create a poll group");
+
+	for (int zone = 0; zone < ZONE_MAX_ZONES; zone++)
+	{
+		m_hZones[zone] = k_HSteamNetConnection_Invalid;
+		m_bZoneConnected[zone] = false;
+	}
+
+	Printf("Front routing to %d zones", numZones);
+	ConnectToZones(SteamNetworkingUtils()->GetLocalTimestamp());
+}
+
+void ZoneFront::Update()
+{
+	while (true)
+	{
+		ISteamNetworkingMessage* pIncomingMsg = nullptr;
+		PauseAllocationAudit();
+		int numMsgs = m_pInterface->ReceiveMessagesOnPollGroup(m_hPollGroup, &pIncomingMsg, 1);
+		ResumeAllocationAudit();
+		if (numMsgs == 0)
+			break;
+		if (numMsgs < 0)
+			FatalError("Error checking for messages");
+
+		if (!DispatchNetworkMessage(frontHandlers, pIncomingMsg))
+		{
+			Printf("Front dropped a malformed message (%d bytes)", pIncomingMsg->m_cbSize);
+		}
+
+		pIncomingMsg->Release();
+	}
+
+	SteamNetworkingMicroseconds now = SteamNetworkingUtils()->GetLocalTimestamp();
+	ConnectToZones(now);
+
+	//nobody is reporting it any more, its zone went down or its player left
+	for (auto it = m_World.begin(); it != m_World.end();)
+	{
+		if (now - it->second.updateTime > ZONE_ENTITY_TIMEOUT)
+		{
+			m_Owners.erase(it->first);
+			it = m_World.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+}
+
+void ZoneFront::Close()
+{
+	for (int zone = 0; zone < m_nNumZones; zone++)
+	{
+		m_pInterface->CloseConnection(m_hZones[zone], 0, "Front Shutdown", true);
+		m_hZones[zone] = k_HSteamNetConnection_Invalid;
+		m_bZoneConnected[zone] = false;
+	}
+
+	m_pInterface->DestroyPollGroup(m_hPollGroup);
+	m_hPollGroup = k_HSteamNetPollGroup_Invalid;
+
+	s_pFrontInstance = nullptr;
+}
+
+void ZoneFront::RoutePlayerState(const DataPacket& packet)
+{
+	//whoever last reported it, or going by where it is if it's new
+	int zone;
+	uint32 epoch = 0;
+	auto itOwner = m_Owners.find(packet.id);
+	if (itOwner != m_Owners.end())
+	{
+		zone = itOwner->second.zone;
+		epoch = itOwner->second.epoch;
+	}
+	else
+	{
+		zone = GetZoneForPosition(packet.posX, m_nNumZones);
+	}
+
+	if (!m_bZoneConnected[zone])
+	{
+		return;
+	}
+
+	RemoteEntity state = { { packet.posX, packet.posY }, { packet.velX, packet.velY }, 0 };
+	char message[NETWORK_HEADER_SIZE + NETWORK_PACKET_SIZE + 4];
+	WriteEntityMessage(MESSAGE_ZONE_ROUTE, packet.id, state, state.position, epoch, message);
+	SendNetworkMessage(m_hZones[zone], message, sizeof(message), k_nSteamNetworkingSend_Unreliable);
+}
+
+void ZoneFront::RemoveEntity(int id)
+{
+	char message[NETWORK_HEADER_SIZE + 1];
+	WriteMessageHeader(MESSAGE_ZONE_REMOVE, message);
+	message[NETWORK_HEADER_SIZE] = (char)id;
+
+	for (int zone = 0; zone < m_nNumZones; zone++)
+	{
+		if (m_bZoneConnected[zone])
+		{
+			SendNetworkMessage(m_hZones[zone], message, sizeof(message), k_nSteamNetworkingSend_Reliable);
+		}
+	}
+
+	m_Owners.erase(id);
+	m_World.erase(id);
+}
+
+void ZoneFront::OnZoneState(const ISteamNetworkingMessage* pMsg, const char* payload, int payloadSize)
+{
+	int zone = FindZone(pMsg->m_conn);
+	int count = DeserializeInt(payload);
+	if (zone < 0 || count < 0 || count > (payloadSize - 4) / ZONE_STATE_RECORD_SIZE
+		|| payloadSize != 4 + count * ZONE_STATE_RECORD_SIZE)
+	{
+		Printf("Front received a malformed zone state");
+		return;
+	}
+
+	for (int i = 0; i < count; i++)
+	{
+		const char* record = payload + 4 + i * ZONE_STATE_RECORD_SIZE;
+		DataPacket packet = DeserializeDataPacket(record);
+		uint32 epoch = (uint32)DeserializeInt(record, NETWORK_PACKET_SIZE);
+
+		//around a handoff both zones can report it, the higher epoch is the current owner
+		auto itOwner = m_Owners.find(packet.id);
+		if (itOwner != m_Owners.end() && (int32)(epoch - itOwner->second.epoch) < 0)
+		{
+			continue;
+		}
+
+		m_Owners[packet.id] = { zone, epoch };
+		m_World[packet.id] = { { packet.posX, packet.posY }, { packet.velX, packet.velY }, pMsg->m_usecTimeReceived };
+	}
+}
+
+void ZoneFront::SteamNetConnectionStatusChangedCallback(SteamNetConnectionStatusChangedCallback_t* pInfo)
+{
+	s_pFrontInstance->OnSteamNetConnectionStatusChanged(pInfo);
+}
+
+void ZoneFront::OnSteamNetConnectionStatusChanged(SteamNetConnectionStatusChangedCallback_t* pInfo)
+{
+	int zone = FindZone(pInfo->m_hConn);
+	if (zone < 0)
+	{
+		return;
+	}
+
+	switch (pInfo->m_info.m_eState)
+	{
+	case k_ESteamNetworkingConnectionState_ClosedByPeer:
+	case k_ESteamNetworkingConnectionState_ProblemDetectedLocally:
+	{
+		if (m_bZoneConnected[zone])
+		{
+			Printf("Front lost zone %d (%s)", zone, pInfo->m_info.m_szEndDebug);
+		}
+		m_pInterface->CloseConnection(pInfo->m_hConn, 0, nullptr, false);
+		m_hZones[zone] = k_HSteamNetConnection_Invalid;
+		m_bZoneConnected[zone] = false;
+
+		//what it owned is gone with it, route them by position until someone picks them up
+		for (auto it = m_Owners.begin(); it != m_Owners.end();)
+		{
+			it = (it->second.zone == zone) ? m_Owners.erase(it) : std::next(it);
+		}
+		break;
+	}
+
+	case k_ESteamNetworkingConnectionState_Connected:
+	{
+		char message[NETWORK_HEADER_SIZE + 2];
+		WriteMessageHeader(MESSAGE_ZONE_HELLO, message);
+		message[NETWORK_HEADER_SIZE] = (char)ZONE_PEER_FRONT;
+		message[NETWORK_HEADER_SIZE + 1] = (char)zone;
+		SendNetworkMessage(pInfo->m_hConn, message, sizeof(message), k_nSteamNetworkingSend_Reliable);
+
+		m_bZoneConnected[zone] = true;
+		Printf("Front connected to zone %d", zone);
+		break;
+	}
+
+	default:
+		// Silences -Wswitch
+		break;
+	}
+}
+
+void ZoneFront::ConnectToZones(SteamNetworkingMicroseconds now)
+{
+	if (m_LastConnectAttempt != 0 && now - m_LastConnectAttempt < ZONE_RECONNECT_INTERVAL)
+	{
+		return;
+	}
+	m_LastConnectAttempt = now;
+
+	for (int zone = 0; zone < m_nNumZones; zone++)
+	{
+		if (m_hZones[zone] != k_HSteamNetConnection_Invalid)
+		{
+			continue;
+		}
+
+		SteamNetworkingIPAddr addr;
+		addr.Clear();
+		addr.SetIPv4(0x7f000001, (uint16)(ZONE_BASE_PORT + zone));
+		SteamNetworkingConfigValue_t opt;
+		opt.SetPtr(k_ESteamNetworkingConfig_Callback_ConnectionStatusChanged, (void*)SteamNetConnectionStatusChangedCallback);
+		m_hZones[zone] = m_pInterface->ConnectByIPAddress(addr, 1, &opt);
+		if (m_hZones[zone] != k_HSteamNetConnection_Invalid)
+		{
+			m_pInterface->SetConnectionPollGroup(m_hZones[zone], m_hPollGroup);
+		}
+	}
+}
+
+int ZoneFront::FindZone(HSteamNetConnection conn) const
+{
+	for (int zone = 0; zone < m_nNumZones; zone++)
+	{
+		if (m_hZones[zone] == conn)
+		{
+			return zone;
+		}
+	}
+	return -1;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// Cluster processes
+//
+/////////////////////////////////////////////////////////////////////////////
+
+//set from the signal handler, the headless loops finish their tick then shut down
+static volatile sig_atomic_t s_bQuit = 0;
+
+static void OnQuitSignal(int signal)
+{
+	s_bQuit = 1;
+}
+
+//runs one zone until it's told to stop
+static int RunZoneProcess(int zoneIndex, int numZones)
+{
+	InitNetworkLibrary();
+
+	ZoneServer zone;
+	zone.Run(zoneIndex, numZones);
+	while (!s_bQuit)
+	{
+		UpdateNetworkConditions();
+		zone.Update();
+		std::this_thread::sleep_for(std::chrono::milliseconds(ZONE_TICK_INTERVAL));
+	}
+	zone.Close();
+
+#ifdef STEAMNETWORKINGSOCKETS_OPENSOURCE
+	GameNetworkingSockets_Kill();
+#else
+	SteamDatagramClient_Kill();
+#endif
+	return 0;
+}
+
+//runs the game's own server headless, with its world coming from the zones
+static int RunFrontProcess(int numZones)
+{
+	char argument[64];
+	sprintf(argument, "server --port %d --zones %d", ZONE_FRONT_PORT, numZones);
+	startSession(argument);
+
+	while (!s_bQuit)
+	{
+		UpdateNetwork();
+		std::this_thread::sleep_for(std::chrono::milliseconds(ZONE_TICK_INTERVAL));
+	}
+
+	CloseNetwork();
+	return 0;
+}
+
+//a process the coordinator looks after
+struct ClusterProcess
+{
+	std::vector<std::string> args;
+	bool bStarted = false; //started at least once, so any further start is a restart
+#ifdef _WIN32
+	HANDLE hProcess = nullptr;
+#else
+	pid_t pid = -1;
+#endif
+};
+
+static bool SpawnProcess(ClusterProcess& process, const char* exePath)
+{
+#ifdef _WIN32
+	std::string commandLine = std::string("\"") + exePath + "\"";
+	for (auto& arg : process.args)
+	{
+		commandLine += " " + arg;
+	}
+
+	STARTUPINFOA startupInfo = {};
+	startupInfo.cb = sizeof(startupInfo);
+	PROCESS_INFORMATION processInfo = {};
+	if (!CreateProcessA(exePath, &commandLine[0], nullptr, nullptr, FALSE, 0, nullptr, nullptr, &startupInfo, &processInfo))
+	{
+		return false;
+	}
+	CloseHandle(processInfo.hThread);
+	process.hProcess = processInfo.hProcess;
+	return true;
+#else
+	std::vector<char*> argv;
+	argv.push_back((char*)exePath);
+	for (auto& arg : process.args)
+	{
+		argv.push_back(&arg[0]);
+	}
+	argv.push_back(nullptr);
+
+	pid_t pid = fork();
+	if (pid < 0)
+	{
+		return false;
+	}
+	if (pid == 0)
+	{
+#ifdef __linux__
+		//don't outlive the coordinator
+		prctl(PR_SET_PDEATHSIG, SIGTERM);
+#endif
+		execv(exePath, argv.data());
+		_exit(127);
+	}
+	process.pid = pid;
+	return true;
+#endif
+}
+
+static bool IsProcessRunning(ClusterProcess& process)
+{
+#ifdef _WIN32
+	return process.hProcess != nullptr && WaitForSingleObject(process.hProcess, 0) == WAIT_TIMEOUT;
+#else
+	return process.pid > 0 && waitpid(process.pid, nullptr, WNOHANG) == 0;
+#endif
+}
+
+static void StopProcess(ClusterProcess& process)
+{
+#ifdef _WIN32
+	if (process.hProcess != nullptr)
+	{
+		TerminateProcess(process.hProcess, 0);
+		WaitForSingleObject(process.hProcess, INFINITE);
+		CloseHandle(process.hProcess);
+		process.hProcess = nullptr;
+	}
+#else
+	if (process.pid > 0)
+	{
+		kill(process.pid, SIGTERM);
+		waitpid(process.pid, nullptr, 0);
+		process.pid = -1;
+	}
+#endif
+}
+
+//starts every zone and the front as child processes and restarts any that die
+static int RunCoordinator(const char* exePath, int numZones)
+{
+	std::vector<ClusterProcess> processes(numZones + 1);
+	for (int zone = 0; zone < numZones; zone++)
+	{
+		processes[zone].args = { "--zone", std::to_string(zone), "--zones", std::to_string(numZones) };
+	}
+	processes[numZones].args = { "--front", std::to_string(numZones) };
+
+	//everyone runs under the same simulated conditions as us
+	for (auto& process : processes)
+	{
+		const std::vector<std::string>& simArguments = GetNetworkConditionArguments();
+		process.args.insert(process.args.end(), simArguments.begin(), simArguments.end());
+	}
+
+	//and exports metrics alongside ours, each to its own file so they don't overwrite each other
+	const std::string& metricsTarget = GetMetricsTarget();
+	for (int i = 0; i <= numZones && !metricsTarget.empty(); i++)
+	{
+		std::string target = metricsTarget;
+		if (target.compare(0, 5, "unix:") != 0)
+		{
+			target += (i < numZones) ? ".zone" + std::to_string(i) : std::string(".front");
+		}
+		processes[i].args.insert(processes[i].args.end(), { "--metrics", target, "--metrics-interval", std::to_string(GetMetricsInterval()) });
+	}
+
+	printf("Cluster of %d zones, clients connect to port %d\n", numZones, ZONE_FRONT_PORT);
+	fflush(stdout);
+
+	while (!s_bQuit)
+	{
+		for (auto& process : processes)
+		{
+			if (IsProcessRunning(process))
+			{
+				continue;
+			}
+
+#ifdef _WIN32
+			if (process.hProcess != nullptr)
+			{
+				CloseHandle(process.hProcess);
+				process.hProcess = nullptr;
+			}
+#endif
+			if (!SpawnProcess(process, exePath))
+			{
+				printf("Failed to start %s %s\n", process.args[0].c_str(), process.args[1].c_str());
+			}
+			else if (process.bStarted)
+			{
+				printf("Restarted %s %s\n", process.args[0].c_str(), process.args[1].c_str());
+			}
+			process.bStarted = true;
+			fflush(stdout);
+		}
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(ZONE_RESTART_DELAY));
+	}
+
+	for (auto& process : processes)
+	{
+		StopProcess(process);
+	}
+	return 0;
+}
+
+//path to our own executable, so the coordinator can start copies of it
+static std::string GetExecutablePath(const char* argv0)
+{
+#ifdef _WIN32
+	char path[MAX_PATH];
+	DWORD length = GetModuleFileNameA(nullptr, path, MAX_PATH);
+	if (length > 0 && length < MAX_PATH)
+	{
+		return path;
+	}
+#elif defined(__linux__)
+	char path[4096];
+	ssize_t length = readlink("/proc/self/exe", path, sizeof(path) - 1);
+	if (length > 0)
+	{
+		path[length] = '\0';
+		return path;
+	}
+#endif
+	return argv0;
+}
+
+int RunClusterProcess(int argc, char** argv)
+{
+	int zoneIndex = -1;
+	int numZones = 0;
+	bool bCoordinator = false;
+	bool bFront = false;
+
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		if (!strcmp(argv[i], "--cluster"))
+		{
+			bCoordinator = true;
+			numZones = atoi(argv[i + 1]);
+		}
+		else if (!strcmp(argv[i], "--front"))
+		{
+			bFront = true;
+			numZones = atoi(argv[i + 1]);
+		}
+		else if (!strcmp(argv[i], "--zone"))
+		{
+			zoneIndex = atoi(argv[i + 1]);
+		}
+		else if (!strcmp(argv[i], "--zones"))
+		{
+			numZones = atoi(argv[i + 1]);
+		}
+	}
+
+	if (!bCoordinator && !bFront && zoneIndex < 0)
+	{
+		return -1;
+	}
+
+	if (numZones < 1 || numZones > ZONE_MAX_ZONES || zoneIndex >= numZones)
+	{
+		printf("Usage:\n    raylib_game --cluster ZONES\n    raylib_game --zone INDEX --zones ZONES\n    raylib_game --front ZONES\n"
+			"ZONES is 1 to %d\n", ZONE_MAX_ZONES);
+		return 1;
+	}
+
+	signal(SIGINT, OnQuitSignal);
+	signal(SIGTERM, OnQuitSignal);
+
+	if (bCoordinator)
+	{
+		return RunCoordinator(GetExecutablePath(argv[0]).c_str(), numZones);
+	}
+	if (bFront)
+	{
+		return RunFrontProcess(numZones);
+	}
+	return RunZoneProcess(zoneIndex, numZones);
+}
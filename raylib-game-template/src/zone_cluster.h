@@ -0,0 +1,170 @@
+// Zone-sharded server cluster
+// The world is split into vertical strips, each simulated by its own zone server process.
+// Game clients connect to a front process that routes their updates to whichever zone owns
+// them, entities crossing a border are handed off to the neighbouring zone and entities near
+// a border are mirrored to the zone on the other side. A coordinator process starts the zones
+// and the front and restarts any that die, so the whole cluster runs on one machine:
+//
+//     raylib_game --cluster 3
+//
+// then start the game as a client as normal, it connects to the front on port 7777
+
+#ifndef ZONE_CLUSTER_H
+#define ZONE_CLUSTER_H
+
+#include <map>
+#include <vector>
+
+#include "net_protocol.h"
+
+#define ZONE_MAX_ZONES 8
+#define ZONE_WORLD_WIDTH 800 //the strips are cut across the screen width
+#define ZONE_BASE_PORT 7800 //zone i listens on ZONE_BASE_PORT + i, over loopback
+
+//entities this close to a border are mirrored to the neighbour
+#define ZONE_BORDER_WIDTH 64
+//how far past a border an entity has to go before it's handed off, so one
+//sitting on the line doesn't bounce between zones
+#define ZONE_HANDOFF_MARGIN 8
+
+#define ZONE_TICK_INTERVAL 16 //milliseconds between headless process updates
+#define ZONE_RECONNECT_INTERVAL 1000000 //microseconds between attempts to reach a missing zone
+#define ZONE_MIRROR_TIMEOUT 1000000 //microseconds before a mirrored entity is dropped
+#define ZONE_FORWARD_TIMEOUT 2000000 //microseconds a zone keeps forwarding updates for an entity it handed off
+#define ZONE_RESTART_DELAY 500 //milliseconds between the coordinator's checks on its processes
+
+//who is on the other end of a connection to a zone
+enum ZonePeerRole : unsigned char
+{
+	ZONE_PEER_FRONT,
+	ZONE_PEER_ZONE
+};
+
+//which zone a point on the x axis falls in
+int GetZoneForPosition(int posX, int numZones);
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// ZoneServer
+//
+/////////////////////////////////////////////////////////////////////////////
+
+//one zone of the cluster, run headless in its own process
+//it owns the entities inside its strip and passes them on when they leave
+class ZoneServer
+{
+public:
+	void Run(int zoneIndex, int numZones);
+	void Update();
+	void Close();
+
+	void OnHello(const ISteamNetworkingMessage* pMsg, const char* payload);
+	void OnRoute(const ISteamNetworkingMessage* pMsg, const char* payload);
+	void OnHandoff(const ISteamNetworkingMessage* pMsg, const char* payload);
+	void OnMirror(const ISteamNetworkingMessage* pMsg, const char* payload, int payloadSize);
+	void OnRemove(const ISteamNetworkingMessage* pMsg, const char* payload);
+
+private:
+	static void SteamNetConnectionStatusChangedCallback(SteamNetConnectionStatusChangedCallback_t* pInfo);
+	void OnSteamNetConnectionStatusChanged(SteamNetConnectionStatusChangedCallback_t* pInfo);
+
+	void ConnectToRightNeighbour(SteamNetworkingMicroseconds now);
+	HSteamNetConnection GetConnectionToZone(int zone) const;
+	bool IsNeighbour(HSteamNetConnection conn) const;
+	void SendToZone(int zone, const char* message, int size, int sendFlags);
+	void SendHandoffs(SteamNetworkingMicroseconds now);
+	void SendMirrors(SteamNetworkingMicroseconds now);
+	void SendStateToFront(SteamNetworkingMicroseconds now);
+
+	//an entity this zone is responsible for
+	//the epoch goes up on every handoff, so the front can tell which report is newest
+	struct OwnedEntity
+	{
+		RemoteEntity state;
+		uint32 epoch;
+	};
+
+	//a neighbour's entity near our border, it's still theirs until they hand it to us
+	struct MirroredEntity
+	{
+		RemoteEntity state;
+		int zone;
+	};
+
+	//somewhere we recently sent an entity, late updates for it are passed on
+	struct HandedOffEntity
+	{
+		int zone;
+		SteamNetworkingMicroseconds time;
+	};
+
+	ISteamNetworkingSockets* m_pInterface = nullptr;
+	HSteamListenSocket m_hListenSock = k_HSteamListenSocket_Invalid;
+	HSteamNetPollGroup m_hPollGroup = k_HSteamNetPollGroup_Invalid;
+	int m_nZoneIndex = 0;
+	int m_nNumZones = 0;
+
+	HSteamNetConnection m_hFront = k_HSteamNetConnection_Invalid;
+	HSteamNetConnection m_hLeftZone = k_HSteamNetConnection_Invalid; //they connect to us
+	HSteamNetConnection m_hRightZone = k_HSteamNetConnection_Invalid; //we connect to them
+	bool m_bRightZoneConnected = false;
+	SteamNetworkingMicroseconds m_LastConnectAttempt = 0;
+
+	std::map<int, OwnedEntity> m_Owned;
+	std::map<int, MirroredEntity> m_Mirrored; //the neighbours' entities near our borders
+	std::map<int, HandedOffEntity> m_HandedOff;
+};
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// ZoneFront
+//
+/////////////////////////////////////////////////////////////////////////////
+
+//lives in the front process's NetworkServer
+//routes each client's updates to the owning zone and gathers the zones'
+//reports back into the world the snapshots are built from
+class ZoneFront
+{
+public:
+	explicit ZoneFront(EntityMap& world) : m_World(world) {}
+
+	void Start(int numZones);
+	void Update();
+	void Close();
+
+	//a client's update, sent on to whoever owns them
+	void RoutePlayerState(const DataPacket& packet);
+
+	//a client left, forget them everywhere
+	void RemoveEntity(int id);
+
+	void OnZoneState(const ISteamNetworkingMessage* pMsg, const char* payload, int payloadSize);
+
+private:
+	static void SteamNetConnectionStatusChangedCallback(SteamNetConnectionStatusChangedCallback_t* pInfo);
+	void OnSteamNetConnectionStatusChanged(SteamNetConnectionStatusChangedCallback_t* pInfo);
+
+	void ConnectToZones(SteamNetworkingMicroseconds now);
+	int FindZone(HSteamNetConnection conn) const;
+
+	//which zone we last heard owns an entity
+	struct EntityOwner
+	{
+		int zone;
+		uint32 epoch;
+	};
+
+	ISteamNetworkingSockets* m_pInterface = nullptr;
+	HSteamNetPollGroup m_hPollGroup = k_HSteamNetPollGroup_Invalid;
+	int m_nNumZones = 0;
+
+	HSteamNetConnection m_hZones[ZONE_MAX_ZONES];
+	bool m_bZoneConnected[ZONE_MAX_ZONES];
+	SteamNetworkingMicroseconds m_LastConnectAttempt = 0;
+
+	EntityMap& m_World;
+	std::map<int, EntityOwner> m_Owners;
+};
+
+#endif // ZONE_CLUSTER_H
@@ -168,8 +168,8 @@ fn compileRaylib(b: *std.Build, target: std.Build.ResolvedTarget, optimize: std.
         raylib.addIncludePath(b.path("src/external/glfw/include"));
     }
 
-    var c_source_files = try std.ArrayList([]const u8).initCapacity(b.allocator, 2);
-    c_source_files.appendSliceAssumeCapacity(&.{ "src/rcore.c", "src/utils.c" });
+    var c_source_files = try std.ArrayList([]const u8).initCapacity(b.allocator, 3);
+    c_source_files.appendSliceAssumeCapacity(&.{ "src/rcore.c", "src/utils.c", "src/rjobs.c" });
 
     if (options.rshapes) {
         try c_source_files.append("src/rshapes.c");
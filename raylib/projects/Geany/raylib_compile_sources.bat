@@ -26,11 +26,12 @@ gcc -O2 -c rtext.c -std=c99 -Wall -DPLATFORM_DESKTOP
 gcc -O2 -c rmodels.c -std=c99 -Wall -DPLATFORM_DESKTOP
 gcc -O2 -c raudio.c -std=c99 -Wall -DPLATFORM_DESKTOP
 gcc -O2 -c utils.c -std=c99 -Wall -DPLATFORM_DESKTOP
+gcc -O2 -c rjobs.c -std=c99 -Wall -DPLATFORM_DESKTOP
 
 :: .
 :: . > Generate raylib library
 :: ------------------------------
-ar rcs libraylib.a rcore.o rglfw.o rshapes.o rtextures.o rtext.o rmodels.o raudio.o utils.o
+ar rcs libraylib.a rcore.o rglfw.o rshapes.o rtextures.o rtext.o rmodels.o raudio.o utils.o rjobs.o
 :: .
 :: > Installing raylib library
 :: -----------------------------
@@ -335,7 +335,7 @@ sinfl_build_subtbl(struct sinfl_gen *gen, unsigned *tbl, int tbl_bits,
     }
   }
 }
-static void
+static int
 sinfl_build(unsigned *tbl, unsigned char *lens, int tbl_bits, int maxlen,
             int symcnt) {
   int i, used = 0;
@@ -357,14 +357,18 @@ sinfl_build(unsigned *tbl, unsigned char *lens, int tbl_bits, int maxlen,
     gen.sorted[off[lens[i]]++] = (short)i;
   gen.sorted += off[0];
 
+  if (used > (1 << maxlen)) {
+    return 0;   /* over-subscribed, would build past the table */
+  }
   if (used < (1 << maxlen)){
     for (i = 0; i < 1 << tbl_bits; ++i)
       tbl[i] = (0 << 16u) | 1;
-    return;
+    return 1;
   }
   if (!sinfl_build_tbl(&gen, tbl, tbl_bits, cnt)){
     sinfl_build_subtbl(&gen, tbl, tbl_bits, cnt);
   }
+  return 1;
 }
 static int
 sinfl_decode(struct sinfl *s, const unsigned *tbl, int bit_len) {
@@ -428,6 +432,8 @@ sinfl_decompress(unsigned char *out, int cap, const unsigned char *in, int size)
         return (int)(out-o);
       if (len > (e - s.bitptr) || !len)
         return (int)(out-o);
+      if (len > (oe - out))
+        return (int)(out-o);    /* would run past cap */
 
       memcpy(out, s.bitptr, (size_t)len);
       s.bitptr += len, out += len;
@@ -460,21 +466,27 @@ sinfl_decompress(unsigned char *out, int cap, const unsigned char *in, int size)
       int nlen = 4 + sinfl__get(&s,4);
       for (n = 0; n < nlen; n++)
         nlens[order[n]] = (unsigned char)sinfl_get(&s,3);
-      sinfl_build(hlens, nlens, 7, 7, 19);
+      if (!sinfl_build(hlens, nlens, 7, 7, 19))
+        return (int)(out-o);
 
       /* decode code lengths */
       for (n = 0; n < nlit + ndist;) {
-        int sym = 0;
+        int sym = 0, rep = 0;
         sinfl_refill(&s);
         sym = sinfl_decode(&s, hlens, 7);
-        switch (sym) {default: lens[n++] = (unsigned char)sym; break;
-        case 16: for (i=3+sinfl_get(&s,2);i;i--,n++) lens[n]=lens[n-1]; break;
-        case 17: for (i=3+sinfl_get(&s,3);i;i--,n++) lens[n]=0; break;
-        case 18: for (i=11+sinfl_get(&s,7);i;i--,n++) lens[n]=0; break;}
+        switch (sym) {default: lens[n++] = (unsigned char)sym; continue;
+        case 16: rep = 3+sinfl_get(&s,2); break;
+        case 17: rep = 3+sinfl_get(&s,3); break;
+        case 18: rep = 11+sinfl_get(&s,7); break;}
+        /* repeats must stay inside the lengths, and 16 needs one before it */
+        if (rep > nlit + ndist - n || (sym == 16 && !n))
+          return (int)(out-o);
+        for (i = rep; i; i--, n++) lens[n] = (sym == 16) ? lens[n-1] : 0;
       }
       /* build lit/dist tables */
-      sinfl_build(s.lits, lens, 10, 15, nlit);
-      sinfl_build(s.dsts, lens + nlit, 8, 15, ndist);
+      if (!sinfl_build(s.lits, lens, 10, 15, nlit) ||
+          !sinfl_build(s.dsts, lens + nlit, 8, 15, ndist))
+        return (int)(out-o);
       state = blk;}
     } break;
     case blk: {
@@ -491,6 +503,9 @@ sinfl_decompress(unsigned char *out, int cap, const unsigned char *in, int size)
           *out++ = (unsigned char)sym;
           sym = sinfl_decode(&s, s.lits, 10);
           if (sym < 256) {
+            if (sinfl_unlikely(out >= oe)) {
+              return (int)(out-o);
+            }
             *out++ = (unsigned char)sym;
             continue;
           }
@@ -514,6 +529,9 @@ sinfl_decompress(unsigned char *out, int cap, const unsigned char *in, int size)
         if (sinfl_unlikely(offs > (int)(out-o))) {
           return (int)(out-o);
         }
+        if (sinfl_unlikely(len > (int)(oe-out))) {
+          return (int)(out-o);    /* would run past cap */
+        }
         out = out + len;
 
 #ifndef SINFL_NO_SIMD
@@ -384,6 +384,7 @@ typedef struct AudioData {
         bool isReady;               // Check if audio device is ready
         size_t pcmBufferSize;       // Pre-allocated buffer size
         void *pcmBuffer;            // Pre-allocated buffer to read audio data from file/memory
+        unsigned int underrunCount; // Times a stream ran out of data and was padded with silence
     } System;
     struct {
         AudioBuffer *first;         // Pointer to first AudioBuffer in the list
@@ -2180,6 +2181,16 @@ bool IsAudioStreamProcessed(AudioStream stream)
     return result;
 }
 
+// Get the number of times an audio stream ran out of data since the device was initialized
+unsigned int GetAudioStreamUnderrunCount(void)
+{
+    unsigned int result = 0;
+    ma_mutex_lock(&AUDIO.System.lock);
+    result = AUDIO.System.underrunCount;
+    ma_mutex_unlock(&AUDIO.System.lock);
+    return result;
+}
+
 // Play audio stream
 void PlayAudioStream(AudioStream stream)
 {
@@ -2450,7 +2461,11 @@ static ma_uint32 ReadAudioBufferFramesInInternalFormat(AudioBuffer *audioBuffer,
         // For static buffers we can fill the remaining frames with silence for safety, but we don't want
         // to report those frames as "read". The reason for this is that the caller uses the return value
         // to know whether a non-looping sound has finished playback
-        if (audioBuffer->usage != AUDIO_BUFFER_USAGE_STATIC) framesRead += totalFramesRemaining;
+        if (audioBuffer->usage != AUDIO_BUFFER_USAGE_STATIC)
+        {
+            framesRead += totalFramesRemaining;
+            AUDIO.System.underrunCount++;
+        }
     }
 
     return framesRead;
@@ -110,6 +110,7 @@
 #endif
 
 #include "utils.h"                  // Required for: TRACELOG() macros
+#include "rjobs.h"                  // Required for: PollMainThreadJobs()
 
 #include <stdlib.h>                 // Required for: srand(), rand(), atexit()
 #include <stdio.h>                  // Required for: sprintf() [Used in OpenURL()]
@@ -911,6 +912,8 @@ void BeginDrawing(void)
 // End canvas drawing and swap buffers (double buffering)
 void EndDrawing(void)
 {
+    PollMainThreadJobs();           // Run GL work other threads have queued for the main thread
+
     rlDrawRenderBatchActive();      // Update and draw internal render batch
 
 #if defined(SUPPORT_GIF_RECORDING)
@@ -0,0 +1,664 @@
+/**********************************************************************************************
+*
+*   raylib.jobs - Work-stealing job system shared by raylib modules and user code
+*
+*   CONFIGURATION:
+*       #define JOBS_MAX_WORKERS
+*           Worker threads the pool can start, not counting the main thread
+*
+*       #define JOBS_DEQUE_CAPACITY
+*           Jobs each thread's deque holds (power of two), a push to a full deque runs the job inline
+*
+*   DEPENDENCIES:
+*       Win32 threads on Windows, pthreads everywhere else
+*
+*
+*   LICENSE: zlib/libpng
+*
+*   Copyright (c) 2014-2025 Ramon Santamaria (@raysan5)
+*
+*   This software is provided "as-is", without any express or implied warranty. In no event
+*   will the authors be held liable for any damages arising from the use of this software.
+*
+*   Permission is granted to anyone to use this software for any purpose, including commercial
+*   applications, and to alter it and redistribute it freely, subject to the following restrictions:
+*
+*     1. The origin of this software must not be misrepresented; you must not claim that you
+*     wrote the original software. If you use this software in a product, an acknowledgment
+*     in the product documentation would be appreciated but is not required.
+*
+*     2. Altered source versions must be plainly marked as such, and must not be misrepresented
+*     as being the original software.
+*
+*     3. This notice may not be removed or altered from any source distribution.
+*
+**********************************************************************************************/
+
+#include "rjobs.h"
+
+#include <stdlib.h>                 // Required for: calloc(), free()
+#include <stdint.h>                 // Required for: intptr_t
+
+// NOTE: raylib.h is not included, its names clash with windows.h
+#if defined(_WIN32)
+    #define WIN32_LEAN_AND_MEAN
+    #define NOGDI
+    #define NOUSER
+    #include <windows.h>            // Required for: CreateThread(), CRITICAL_SECTION, CONDITION_VARIABLE, Interlocked*()
+#else
+    #include <pthread.h>            // Required for: pthread_create(), pthread_mutex_t, pthread_cond_t
+    #include <sched.h>              // Required for: sched_yield()
+    #include <unistd.h>             // Required for: sysconf()
+#endif
+
+//----------------------------------------------------------------------------------
+// Defines and Macros
+//----------------------------------------------------------------------------------
+#ifndef RL_CALLOC
+    #define RL_CALLOC(n,sz)         calloc(n,sz)
+#endif
+#ifndef RL_FREE
+    #define RL_FREE(p)              free(p)
+#endif
+
+#ifndef JOBS_MAX_WORKERS
+    #define JOBS_MAX_WORKERS            63      // Worker threads, not counting the main thread
+#endif
+#ifndef JOBS_DEQUE_CAPACITY
+    #define JOBS_DEQUE_CAPACITY       1024      // Jobs per thread deque, must be a power of two
+#endif
+#define JOBS_INJECT_CAPACITY           256      // Jobs pushed from threads outside the pool, waiting to be picked up
+#define JOBS_MAIN_THREAD_CAPACITY      256      // Jobs waiting for the main thread
+#define JOBS_SPIN_COUNT                 64      // Failed attempts to find a job before a worker sleeps
+#define JOBS_CACHE_LINE                 64
+
+#if defined(_MSC_VER)
+    #define JOBS_THREAD_LOCAL __declspec(thread)
+#else
+    #define JOBS_THREAD_LOCAL __thread
+#endif
+
+//----------------------------------------------------------------------------------
+// Types and Structures Definition
+//----------------------------------------------------------------------------------
+typedef struct Job {
+    JobFunction func;
+    void *data;
+    JobCounter *counter;
+} Job;
+
+// Chase-Lev deque, the owner pushes and pops at bottom, everyone else steals from top
+// Jobs are kept by value in a fixed ring, so nothing is allocated once the pool is running
+typedef struct JobDeque {
+    volatile long long top;
+    char padding[JOBS_CACHE_LINE - sizeof(long long)];      // Keep stealers off the owner's cache line
+    volatile long long bottom;
+    Job jobs[JOBS_DEQUE_CAPACITY];
+} JobDeque;
+
+// Parallel for range, split in halves until it's one grain
+typedef struct JobRange {
+    int begin;
+    int end;
+    int grainSize;
+    JobRangeFunction func;
+    void *data;
+} JobRange;
+
+#if defined(_WIN32)
+    typedef HANDLE JobThread;
+    typedef CRITICAL_SECTION JobMutex;
+    typedef CONDITION_VARIABLE JobCondition;
+#else
+    typedef pthread_t JobThread;
+    typedef pthread_mutex_t JobMutex;
+    typedef pthread_cond_t JobCondition;
+#endif
+
+typedef struct JobSystem {
+    bool ready;
+    int workerCount;                // Workers that started
+    int dequeCount;                 // Index 0 is the main thread's, the rest one per worker asked for
+    JobDeque *deques;
+    JobThread *threads;
+
+    JobMutex mutex;                 // Guards the queues below and sleeping
+    JobCondition wake;
+    Job injected[JOBS_INJECT_CAPACITY];     // Jobs from threads outside the pool
+    int injectedHead;
+    volatile long long injectedCount;   // Also read unlocked, to skip the lock when it's empty
+    Job mainJobs[JOBS_MAIN_THREAD_CAPACITY];    // Jobs for the main thread
+    int mainHead;
+    int mainCount;
+
+    volatile long long queued;      // Jobs in deques or injected and not yet taken, workers sleep when it's 0
+    volatile long long mainQueued;  // Jobs waiting for the main thread, lets polling skip the lock
+    volatile long long sleepers;    // Workers asleep or about to be
+    volatile long long stopping;
+} JobSystem;
+
+//----------------------------------------------------------------------------------
+// Global Variables Definition
+//----------------------------------------------------------------------------------
+static JobSystem jobs = { 0 };
+static JOBS_THREAD_LOCAL int jobsThreadIndex = -1;              // Own deque, -1 outside the pool
+static JOBS_THREAD_LOCAL unsigned int jobsStealSeed = 0;        // Where to start looking for a victim
+
+//----------------------------------------------------------------------------------
+// Module Internal Functions Declaration
+//----------------------------------------------------------------------------------
+static long long AtomicLoad(volatile long long *value);
+static void AtomicStore(volatile long long *value, long long newValue);
+static long long AtomicAdd(volatile long long *value, long long amount);     // Returns the new value
+static bool AtomicCompareExchange(volatile long long *value, long long expected, long long newValue);
+
+static void InitMutex(JobMutex *mutex);
+static void CloseMutex(JobMutex *mutex);
+static void LockMutex(JobMutex *mutex);
+static void UnlockMutex(JobMutex *mutex);
+static void InitCondition(JobCondition *condition);
+static void CloseCondition(JobCondition *condition);
+static void WaitCondition(JobCondition *condition, JobMutex *mutex);
+static void WakeAllCondition(JobCondition *condition);
+static void YieldThread(void);
+static int GetProcessorCount(void);
+static bool StartWorkerThread(JobThread *thread, int index);
+static void JoinWorkerThread(JobThread thread);
+
+static bool PushJob(JobDeque *deque, Job job);      // Owner only
+static bool PopJob(JobDeque *deque, Job *job);      // Owner only
+static bool StealJob(JobDeque *deque, Job *job);    // Any thread
+
+static void ExecuteJob(Job job);
+static bool TryRunJob(void);                        // Run one job from anywhere this thread can take one
+static void WakeWorkers(void);
+static void WorkerLoop(int index);
+static void RunRangeJob(void *data);
+
+//----------------------------------------------------------------------------------
+// Module Functions Definition
+//----------------------------------------------------------------------------------
+// Start the pool, the calling thread becomes the main thread
+void InitJobSystem(int workerCount)
+{
+    if (jobs.ready) return;
+
+#if defined(PLATFORM_WEB)
+    workerCount = 0;        // No threads, every job runs inline
+#endif
+    if (workerCount < 0) workerCount = GetProcessorCount() - 1;
+    if (workerCount > JOBS_MAX_WORKERS) workerCount = JOBS_MAX_WORKERS;
+    if (workerCount < 0) workerCount = 0;
+
+    jobs.deques = (JobDeque *)RL_CALLOC(workerCount + 1, sizeof(JobDeque));
+    jobs.threads = (JobThread *)RL_CALLOC(workerCount + 1, sizeof(JobThread));
+    if ((jobs.deques == NULL) || (jobs.threads == NULL))
+    {
+        RL_FREE(jobs.deques);
+        RL_FREE(jobs.threads);
+        jobs.deques = NULL;
+        jobs.threads = NULL;
+        return;
+    }
+
+    InitMutex(&jobs.mutex);
+    InitCondition(&jobs.wake);
+    jobs.injectedHead = 0;
+    AtomicStore(&jobs.injectedCount, 0);
+    jobs.mainHead = jobs.mainCount = 0;
+    AtomicStore(&jobs.queued, 0);
+    AtomicStore(&jobs.mainQueued, 0);
+    AtomicStore(&jobs.sleepers, 0);
+    AtomicStore(&jobs.stopping, 0);
+
+    jobs.dequeCount = workerCount + 1;
+    jobsThreadIndex = 0;
+
+    // A worker that fails to start leaves the rest to the ones that did, its deque just stays empty
+    int started = 0;
+    while ((started < workerCount) && StartWorkerThread(&jobs.threads[started + 1], started + 1)) started++;
+    jobs.workerCount = started;
+    jobs.ready = true;
+}
+
+// Finish everything queued, then stop the pool
+void CloseJobSystem(void)
+{
+    if (!jobs.ready || !IsMainThread()) return;
+
+    while (TryRunJob() || (AtomicLoad(&jobs.mainQueued) > 0)) PollMainThreadJobs();
+
+    LockMutex(&jobs.mutex);
+    AtomicStore(&jobs.stopping, 1);
+    WakeAllCondition(&jobs.wake);
+    UnlockMutex(&jobs.mutex);
+
+    for (int i = 1; i <= jobs.workerCount; i++) JoinWorkerThread(jobs.threads[i]);
+
+    CloseCondition(&jobs.wake);
+    CloseMutex(&jobs.mutex);
+    RL_FREE(jobs.deques);
+    RL_FREE(jobs.threads);
+    jobs.deques = NULL;
+    jobs.threads = NULL;
+    jobs.workerCount = 0;
+    jobs.ready = false;
+    jobsThreadIndex = -1;
+}
+
+int GetJobWorkerCount(void)
+{
+    return jobs.ready? jobs.workerCount : 0;
+}
+
+// Queue a job, it goes on this thread's own deque when it has one
+void RunJob(JobFunction func, void *data, JobCounter *counter)
+{
+    Job job = { func, data, counter };
+
+    if (!jobs.ready || (jobs.workerCount == 0))
+    {
+        func(data);
+        return;
+    }
+
+    if (counter != NULL) AtomicAdd(&counter->pending, 1);
+
+    bool queued = false;
+    if (jobsThreadIndex >= 0) queued = PushJob(&jobs.deques[jobsThreadIndex], job);
+    else
+    {
+        LockMutex(&jobs.mutex);
+        long long injectedCount = AtomicLoad(&jobs.injectedCount);
+        if (injectedCount < JOBS_INJECT_CAPACITY)
+        {
+            jobs.injected[(jobs.injectedHead + injectedCount)%JOBS_INJECT_CAPACITY] = job;
+            AtomicAdd(&jobs.injectedCount, 1);
+            queued = true;
+        }
+        UnlockMutex(&jobs.mutex);
+    }
+
+    // Nowhere to put it, so it's done now
+    if (!queued)
+    {
+        ExecuteJob(job);
+        return;
+    }
+
+    AtomicAdd(&jobs.queued, 1);
+    WakeWorkers();
+}
+
+// Help with whatever is queued until the counter's jobs are all done
+void WaitJobCounter(JobCounter *counter)
+{
+    while (AtomicLoad(&counter->pending) > 0)
+    {
+        if (jobsThreadIndex == 0) PollMainThreadJobs();
+        if (!TryRunJob()) YieldThread();
+    }
+}
+
+// Split [0, count) in halves, running the lower half and leaving the upper one to be stolen,
+// until each piece is one grain
+// NOTE: Thieves take the oldest, so the biggest, halves first
+void ParallelFor(int count, int grainSize, JobRangeFunction func, void *data)
+{
+    if (count <= 0) return;
+
+    if (grainSize <= 0)
+    {
+        // About four pieces per thread, so one slow piece doesn't hold everyone up
+        grainSize = count/((GetJobWorkerCount() + 1)*4);
+        if (grainSize < 1) grainSize = 1;
+    }
+
+    if (!jobs.ready || (jobs.workerCount == 0) || (count <= grainSize))
+    {
+        func(0, count, data);
+        return;
+    }
+
+    JobRange range = { 0, count, grainSize, func, data };
+    RunRangeJob(&range);
+}
+
+// Queue a job for the main thread
+// NOTE: Only the main thread can do OpenGL work, this is how anything else gets it done
+void RunMainThreadJob(JobFunction func, void *data, JobCounter *counter)
+{
+    if (!jobs.ready || IsMainThread())
+    {
+        func(data);
+        return;
+    }
+
+    Job job = { func, data, counter };
+    if (counter != NULL) AtomicAdd(&counter->pending, 1);
+
+    // A full queue waits for the main thread to make room, it can't be run anywhere else
+    LockMutex(&jobs.mutex);
+    while (jobs.mainCount == JOBS_MAIN_THREAD_CAPACITY)
+    {
+        UnlockMutex(&jobs.mutex);
+        YieldThread();
+        LockMutex(&jobs.mutex);
+    }
+    jobs.mainJobs[(jobs.mainHead + jobs.mainCount)%JOBS_MAIN_THREAD_CAPACITY] = job;
+    jobs.mainCount++;
+    UnlockMutex(&jobs.mutex);
+
+    AtomicAdd(&jobs.mainQueued, 1);
+}
+
+// Run everything queued for the main thread, including anything those jobs queue
+void PollMainThreadJobs(void)
+{
+    if (!IsMainThread()) return;
+
+    while (AtomicLoad(&jobs.mainQueued) > 0)
+    {
+        Job job = { 0 };
+        bool found = false;
+
+        LockMutex(&jobs.mutex);
+        if (jobs.mainCount > 0)
+        {
+            job = jobs.mainJobs[jobs.mainHead];
+            jobs.mainHead = (jobs.mainHead + 1)%JOBS_MAIN_THREAD_CAPACITY;
+            jobs.mainCount--;
+            found = true;
+        }
+        UnlockMutex(&jobs.mutex);
+
+        // Counted after it's queued, so it can briefly look like there's one more than there is
+        if (!found) break;
+
+        AtomicAdd(&jobs.mainQueued, -1);
+        ExecuteJob(job);
+    }
+}
+
+bool IsMainThread(void)
+{
+    return jobs.ready && (jobsThreadIndex == 0);
+}
+
+//----------------------------------------------------------------------------------
+// Module Internal Functions Definition
+//----------------------------------------------------------------------------------
+// NOTE: Every atomic is sequentially consistent, the deque and the sleep check both rely on it
+#if defined(_WIN32)
+static long long AtomicLoad(volatile long long *value)
+{
+    long long result = *value;
+    MemoryBarrier();
+    return result;
+}
+
+static void AtomicStore(volatile long long *value, long long newValue)
+{
+    InterlockedExchange64(value, newValue);
+}
+
+static long long AtomicAdd(volatile long long *value, long long amount)
+{
+    return InterlockedExchangeAdd64(value, amount) + amount;
+}
+
+static bool AtomicCompareExchange(volatile long long *value, long long expected, long long newValue)
+{
+    return (InterlockedCompareExchange64(value, newValue, expected) == expected);
+}
+
+static void InitMutex(JobMutex *mutex) { InitializeCriticalSection(mutex); }
+static void CloseMutex(JobMutex *mutex) { DeleteCriticalSection(mutex); }
+static void LockMutex(JobMutex *mutex) { EnterCriticalSection(mutex); }
+static void UnlockMutex(JobMutex *mutex) { LeaveCriticalSection(mutex); }
+static void InitCondition(JobCondition *condition) { InitializeConditionVariable(condition); }
+static void CloseCondition(JobCondition *condition) { (void)condition; }
+static void WaitCondition(JobCondition *condition, JobMutex *mutex) { SleepConditionVariableCS(condition, mutex, INFINITE); }
+static void WakeAllCondition(JobCondition *condition) { WakeAllConditionVariable(condition); }
+static void YieldThread(void) { SwitchToThread(); }
+
+static int GetProcessorCount(void)
+{
+    SYSTEM_INFO info = { 0 };
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+}
+
+static DWORD WINAPI WorkerThreadProc(LPVOID param)
+{
+    WorkerLoop((int)(intptr_t)param);
+    return 0;
+}
+
+static bool StartWorkerThread(JobThread *thread, int index)
+{
+    *thread = CreateThread(NULL, 0, WorkerThreadProc, (LPVOID)(intptr_t)index, 0, NULL);
+    return (*thread != NULL);
+}
+
+static void JoinWorkerThread(JobThread thread)
+{
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+}
+#else
+static long long AtomicLoad(volatile long long *value)
+{
+    return __atomic_load_n(value, __ATOMIC_SEQ_CST);
+}
+
+static void AtomicStore(volatile long long *value, long long newValue)
+{
+    __atomic_store_n(value, newValue, __ATOMIC_SEQ_CST);
+}
+
+static long long AtomicAdd(volatile long long *value, long long amount)
+{
+    return __atomic_add_fetch(value, amount, __ATOMIC_SEQ_CST);
+}
+
+static bool AtomicCompareExchange(volatile long long *value, long long expected, long long newValue)
+{
+    return __atomic_compare_exchange_n(value, &expected, newValue, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+static void InitMutex(JobMutex *mutex) { pthread_mutex_init(mutex, NULL); }
+static void CloseMutex(JobMutex *mutex) { pthread_mutex_destroy(mutex); }
+static void LockMutex(JobMutex *mutex) { pthread_mutex_lock(mutex); }
+static void UnlockMutex(JobMutex *mutex) { pthread_mutex_unlock(mutex); }
+static void InitCondition(JobCondition *condition) { pthread_cond_init(condition, NULL); }
+static void CloseCondition(JobCondition *condition) { pthread_cond_destroy(condition); }
+static void WaitCondition(JobCondition *condition, JobMutex *mutex) { pthread_cond_wait(condition, mutex); }
+static void WakeAllCondition(JobCondition *condition) { pthread_cond_broadcast(condition); }
+static void YieldThread(void) { sched_yield(); }
+
+static int GetProcessorCount(void)
+{
+    return (int)sysconf(_SC_NPROCESSORS_ONLN);
+}
+
+static void *WorkerThreadProc(void *param)
+{
+    WorkerLoop((int)(intptr_t)param);
+    return NULL;
+}
+
+static bool StartWorkerThread(JobThread *thread, int index)
+{
+    return (pthread_create(thread, NULL, WorkerThreadProc, (void *)(intptr_t)index) == 0);
+}
+
+static void JoinWorkerThread(JobThread thread)
+{
+    pthread_join(thread, NULL);
+}
+#endif
+
+static bool PushJob(JobDeque *deque, Job job)
+{
+    long long bottom = AtomicLoad(&deque->bottom);
+    long long top = AtomicLoad(&deque->top);
+    if ((bottom - top) >= JOBS_DEQUE_CAPACITY) return false;
+
+    deque->jobs[bottom & (JOBS_DEQUE_CAPACITY - 1)] = job;
+    AtomicStore(&deque->bottom, bottom + 1);
+    return true;
+}
+
+static bool PopJob(JobDeque *deque, Job *job)
+{
+    // Claim the bottom job before looking at top, so a thief can't take it at the same time unseen
+    long long bottom = AtomicLoad(&deque->bottom) - 1;
+    AtomicStore(&deque->bottom, bottom);
+    long long top = AtomicLoad(&deque->top);
+
+    if (top > bottom)
+    {
+        // Empty
+        AtomicStore(&deque->bottom, bottom + 1);
+        return false;
+    }
+
+    *job = deque->jobs[bottom & (JOBS_DEQUE_CAPACITY - 1)];
+    if (top == bottom)
+    {
+        // Last one, race the thieves for it
+        bool won = AtomicCompareExchange(&deque->top, top, top + 1);
+        AtomicStore(&deque->bottom, bottom + 1);
+        return won;
+    }
+
+    return true;
+}
+
+static bool StealJob(JobDeque *deque, Job *job)
+{
+    long long top = AtomicLoad(&deque->top);
+    long long bottom = AtomicLoad(&deque->bottom);
+    if (top >= bottom) return false;
+
+    // The copy only counts if nobody else took it first, the owner can't have reused its slot
+    // without top moving past it
+    *job = deque->jobs[top & (JOBS_DEQUE_CAPACITY - 1)];
+    return AtomicCompareExchange(&deque->top, top, top + 1);
+}
+
+static void ExecuteJob(Job job)
+{
+    job.func(job.data);
+    if (job.counter != NULL) AtomicAdd(&job.counter->pending, -1);
+}
+
+// Own deque first, newest first, then jobs from outside the pool, then steal the oldest from someone else
+static bool TryRunJob(void)
+{
+    Job job = { 0 };
+    bool found = false;
+
+    if (jobsThreadIndex >= 0) found = PopJob(&jobs.deques[jobsThreadIndex], &job);
+
+    if (!found && (AtomicLoad(&jobs.injectedCount) > 0))
+    {
+        LockMutex(&jobs.mutex);
+        if (AtomicLoad(&jobs.injectedCount) > 0)
+        {
+            job = jobs.injected[jobs.injectedHead];
+            jobs.injectedHead = (jobs.injectedHead + 1)%JOBS_INJECT_CAPACITY;
+            AtomicAdd(&jobs.injectedCount, -1);
+            found = true;
+        }
+        UnlockMutex(&jobs.mutex);
+    }
+
+    if (!found)
+    {
+        int dequeCount = jobs.dequeCount;
+        jobsStealSeed = jobsStealSeed*1103515245u + 12345u;
+        int start = (int)((jobsStealSeed >> 16)%(unsigned int)dequeCount);
+
+        for (int i = 0; (i < dequeCount) && !found; i++)
+        {
+            int victim = (start + i)%dequeCount;
+            if (victim != jobsThreadIndex) found = StealJob(&jobs.deques[victim], &job);
+        }
+    }
+
+    if (!found) return false;
+
+    AtomicAdd(&jobs.queued, -1);
+    ExecuteJob(job);
+    return true;
+}
+
+// NOTE: A worker going to sleep counts itself before checking for jobs and a job is counted
+// before checking for sleepers, so one of them always sees the other
+static void WakeWorkers(void)
+{
+    if (AtomicLoad(&jobs.sleepers) > 0)
+    {
+        LockMutex(&jobs.mutex);
+        WakeAllCondition(&jobs.wake);
+        UnlockMutex(&jobs.mutex);
+    }
+}
+
+static void WorkerLoop(int index)
+{
+    jobsThreadIndex = index;
+    jobsStealSeed = (unsigned int)index*2654435761u;
+
+    // Stopping still runs everything left, jobs queued by the ones running included
+    int idle = 0;
+    while (true)
+    {
+        if (TryRunJob())
+        {
+            idle = 0;
+            continue;
+        }
+
+        if (AtomicLoad(&jobs.stopping) != 0) break;
+
+        // Jobs tend to come in bursts, so look again a few times before sleeping
+        if (++idle < JOBS_SPIN_COUNT)
+        {
+            YieldThread();
+            continue;
+        }
+        idle = 0;
+
+        LockMutex(&jobs.mutex);
+        AtomicAdd(&jobs.sleepers, 1);
+        while ((AtomicLoad(&jobs.stopping) == 0) && (AtomicLoad(&jobs.queued) <= 0)) WaitCondition(&jobs.wake, &jobs.mutex);
+        AtomicAdd(&jobs.sleepers, -1);
+        UnlockMutex(&jobs.mutex);
+    }
+}
+
+static void RunRangeJob(void *data)
+{
+    JobRange *range = (JobRange *)data;
+
+    if ((range->end - range->begin) <= range->grainSize)
+    {
+        range->func(range->begin, range->end, range->data);
+        return;
+    }
+
+    // Both halves live on this stack, so wait for the upper one before returning
+    int middle = range->begin + (range->end - range->begin)/2;
+    JobRange lower = *range;
+    JobRange upper = *range;
+    lower.end = middle;
+    upper.begin = middle;
+
+    JobCounter counter = { 0 };
+    RunJob(RunRangeJob, &upper, &counter);
+    RunRangeJob(&lower);
+    WaitJobCounter(&counter);
+}
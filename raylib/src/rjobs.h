@@ -0,0 +1,86 @@
+/**********************************************************************************************
+*
+*   raylib.jobs - Work-stealing job system shared by raylib modules and user code
+*
+*   One pool of worker threads for the whole process, so raylib modules and the game built on
+*   top of them hand work to the same threads instead of each keeping threads of their own
+*
+*   Every worker, and the main thread, owns a Chase-Lev deque: it pushes and pops jobs at the
+*   bottom with no locking, and idle workers steal from the top of everyone else's. Jobs pushed
+*   from threads outside the pool go through a small locked queue instead. A worker with nothing
+*   to run or steal spins briefly and then sleeps until something is queued
+*
+*   Jobs are grouped by a JobCounter: RunJob() adds one to it and finishing the job takes one
+*   off, WaitJobCounter() returns once it reaches zero and runs other jobs while it waits, so
+*   waiting never blocks a worker. A job can spawn children against its own counter to wait for
+*   them, or against its parent's counter so the parent isn't finished until they are
+*
+*   OpenGL work can only be done on the main thread: RunMainThreadJob() queues a job for it and
+*   EndDrawing() runs whatever is queued, as do PollMainThreadJobs() and waiting on the main thread
+*
+*   NOTE: Without InitJobSystem(), with no workers or on PLATFORM_WEB, every job runs inline
+*
+*
+*   LICENSE: zlib/libpng
+*
+*   Copyright (c) 2014-2025 Ramon Santamaria (@raysan5)
+*
+*   This software is provided "as-is", without any express or implied warranty. In no event
+*   will the authors be held liable for any damages arising from the use of this software.
+*
+*   Permission is granted to anyone to use this software for any purpose, including commercial
+*   applications, and to alter it and redistribute it freely, subject to the following restrictions:
+*
+*     1. The origin of this software must not be misrepresented; you must not claim that you
+*     wrote the original software. If you use this software in a product, an acknowledgment
+*     in the product documentation would be appreciated but is not required.
+*
+*     2. Altered source versions must be plainly marked as such, and must not be misrepresented
+*     as being the original software.
+*
+*     3. This notice may not be removed or altered from any source distribution.
+*
+**********************************************************************************************/
+
+#ifndef RJOBS_H
+#define RJOBS_H
+
+#if !defined(__cplusplus)
+    #include <stdbool.h>                // Required for: bool
+#endif
+
+//----------------------------------------------------------------------------------
+// Types and Structures Definition
+//----------------------------------------------------------------------------------
+typedef void (*JobFunction)(void *data);                            // Job to run
+typedef void (*JobRangeFunction)(int begin, int end, void *data);   // Job to run over indices [begin, end)
+
+// Jobs still to finish, zero-initialize before first use
+typedef struct JobCounter {
+    volatile long long pending;
+} JobCounter;
+
+//----------------------------------------------------------------------------------
+// Module Functions Declaration
+//----------------------------------------------------------------------------------
+#if defined(__cplusplus)
+extern "C" {            // Prevents name mangling of functions
+#endif
+
+void InitJobSystem(int workerCount);        // Start the pool from the main thread, -1 for one worker per core but one
+void CloseJobSystem(void);                  // Finish queued jobs and stop the pool
+int GetJobWorkerCount(void);                // Worker threads running, 0 when jobs run inline
+
+void RunJob(JobFunction func, void *data, JobCounter *counter);             // Queue a job, counter can be NULL
+void WaitJobCounter(JobCounter *counter);                                   // Run other jobs until counter reaches zero
+void ParallelFor(int count, int grainSize, JobRangeFunction func, void *data); // Run func over [0, count) in ranges of about grainSize (0 to pick one), returns when done
+
+void RunMainThreadJob(JobFunction func, void *data, JobCounter *counter);   // Queue a job for the main thread, runs now if called from it
+void PollMainThreadJobs(void);              // Run jobs queued for the main thread, does nothing on any other
+bool IsMainThread(void);                    // Check if this is the thread that called InitJobSystem()
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif // RJOBS_H
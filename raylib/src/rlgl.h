@@ -712,6 +712,7 @@ RLAPI void rlglClose(void);                             // De-initialize rlgl (b
 RLAPI void rlLoadExtensions(void *loader);              // Load OpenGL extensions (loader function required)
 RLAPI void *rlGetProcAddress(const char *procName);     // Get OpenGL procedure address
 RLAPI int rlGetVersion(void);                           // Get current OpenGL version
+RLAPI unsigned int rlGetDrawCallCount(void);            // Get total draw calls issued since init
 RLAPI void rlSetFramebufferWidth(int width);            // Set current framebuffer width
 RLAPI int rlGetFramebufferWidth(void);                  // Get default framebuffer width
 RLAPI void rlSetFramebufferHeight(int height);          // Set current framebuffer height
@@ -1095,6 +1096,7 @@ typedef struct rlglData {
         int framebufferWidth;               // Current framebuffer width
         int framebufferHeight;              // Current framebuffer height
 
+        unsigned int drawCallCount;         // Draw calls issued since init
     } State;            // Renderer state
     struct {
         bool vao;                           // VAO support (OpenGL ES2 could not support VAO extension) (GL_ARB_vertex_array_object)
@@ -2664,6 +2666,13 @@ int rlGetVersion(void)
     return glVersion;
 }
 
+// Get total draw calls issued since init
+// NOTE: Only counted on OpenGL 3.3+ and ES2, the batched backends
+unsigned int rlGetDrawCallCount(void)
+{
+    return RLGL.State.drawCallCount;
+}
+
 // Set current framebuffer width
 void rlSetFramebufferWidth(int width)
 {
@@ -3070,6 +3079,8 @@ void rlDrawRenderBatch(rlRenderBatch *batch)
                 // Bind current draw call texture, activated as GL_TEXTURE0 and bound to sampler2D texture0 by default
                 glBindTexture(GL_TEXTURE_2D, batch->draws[i].textureId);
 
+                RLGL.State.drawCallCount++;
+
                 if ((batch->draws[i].mode == RL_LINES) || (batch->draws[i].mode == RL_TRIANGLES)) glDrawArrays(batch->draws[i].mode, vertexOffset, batch->draws[i].vertexCount);
                 else
                 {